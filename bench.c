@@ -0,0 +1,383 @@
+/*
+ * Headless microbenchmark for the delta layouts
+ *
+ * The layout code is linked against stubbed libwayland marshalling, so every
+ * demand goes through the real geometry and the real emitter (including the
+ * generated river_layout_v3_push_view_dimensions/river_layout_v3_commit
+ * wrappers), without a compositor. Results are printed as CSV, one line per
+ * configuration, so that runs on different revisions can be compared.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "emit.h"
+#include "geometry.h"
+#include "layout.h"
+#include "plugin.h"
+#include "pool.h"
+#include "program.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+
+/* Number of requests marshalled by the stub below */
+static uint64_t marshal_count = 0;
+
+/* Number of allocations made, counted by the --wrap'ed allocator below */
+static uint64_t allocation_count = 0;
+
+/* Stand-ins for libwayland, the generated protocol wrappers call these */
+struct wl_proxy *wl_proxy_marshal_flags(struct wl_proxy *proxy,
+                                        uint32_t opcode,
+                                        const struct wl_interface *interface,
+                                        uint32_t version, uint32_t flags,
+                                        ...) {
+  marshal_count++;
+  return NULL;
+}
+
+uint32_t wl_proxy_get_version(struct wl_proxy *proxy) { return 1; }
+
+// Batched emission is never turned on here, so these are never called
+uint32_t wl_proxy_get_id(struct wl_proxy *proxy) { return 0; }
+
+int wl_display_flush(struct wl_display *display) { return -1; }
+
+int wl_display_get_fd(struct wl_display *display) { return -1; }
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  allocation_count++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  allocation_count++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  allocation_count++;
+  return __real_realloc(ptr, size);
+}
+
+static const uint32_t view_counts[] = {1,   2,    3,    5,    10,   30,
+                                       100, 300, 1000, 3000, 10000};
+
+/* Usable areas: 1080p, 1440p, 4K, 8K and multi-monitor spans */
+static const uint32_t resolutions[][2] = {
+    {1920, 1080}, {2560, 1440}, {3840, 2160},
+    {7680, 4320}, {5760, 1080}, {11520, 2160},
+};
+
+/* View padding and outer padding */
+static const uint32_t paddings[][2] = {{0, 0}, {5, 5}, {20, 10}};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_uint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void bench_print_help(void) {
+  puts("Benchmark the delta layouts without a compositor\n"
+       "\n"
+       "Usage: delta-bench [options]\n"
+       "\t-h,--help: Print this help message and exit\n"
+       "\t-iterations <count>: Maximum number of demands timed per "
+       "configuration\n"
+       "\t-plugin <file>: Load additional layouts from a shared object first\n"
+       "\t-program <file>: Load a layout program first\n"
+       "\t-style <layout>: Only benchmark the given layout style\n"
+       "\t-kernels <auto|scalar|sse2|avx2|all>: Geometry kernels to use, all\n"
+       "\t\truns every one the CPU supports\n"
+       "\t-batches <workers>: Instead, time batches of layouts of several "
+       "outputs,\n\t\tcomputed in turn and on a pool of <workers> threads\n"
+       "\n"
+       "Output is CSV, one line per configuration, with the mean, median and\n"
+       "99th percentile time per demand in nanoseconds, the mean time spent\n"
+       "computing the layout alone and the number of allocations made while\n"
+       "timing.");
+}
+
+/* Outputs and views per output of the batches timed with -batches */
+static const uint32_t batch_outputs[] = {2, 4, 8, 16};
+static const uint32_t batch_views[] = {1, 4, 16, 64, 256, 1024, 4096};
+
+/* A batch being timed, the layout of every output computed into its buffer */
+static struct LayoutParams batch_params;
+static uint32_t batch_view_count;
+static struct ViewBuffer batch_buffers[16];
+
+static void bench_run_batch_job(void *data, uint32_t index) {
+  // The outputs differ in size, as they usually do
+  delta_layout_compute(&batch_params, batch_view_count, 1920 + index * 64,
+                       1080, &batch_buffers[index]);
+}
+
+static void bench_finish_batch_job(void *data, uint32_t index) {}
+
+/**
+ * Time computing the layouts of several outputs at once, in turn on the
+ * calling thread and on the worker pool
+ *
+ * @param only_style style to benchmark, or -1 for all of them
+ * @param max_iterations number of batches timed per configuration
+ * @param samples room for max_iterations samples
+ * @return false on error
+ * */
+static bool bench_batches(int only_style, uint32_t max_iterations,
+                          uint64_t *samples) {
+  puts("style,workers,outputs,views,total_views,iterations,inline_p50_ns,"
+       "pool_p50_ns");
+  for (uint32_t style = 0; style < delta_layout_count(); style++) {
+    if (only_style >= 0 && style != (uint32_t)only_style)
+      continue;
+    batch_params = (struct LayoutParams){
+        .layout_style = style,
+        .main_count = 1,
+        .main_ratio = LAYOUT_RATIO_ONE * 55 / 100,
+        .view_padding = 5,
+        .outer_padding = 5,
+    };
+    for (size_t o = 0; o < ARRAY_LENGTH(batch_outputs); o++) {
+      for (size_t v = 0; v < ARRAY_LENGTH(batch_views); v++) {
+        uint32_t outputs = batch_outputs[o];
+        batch_view_count = batch_views[v];
+        // Warm up, letting the buffers grow to their final size
+        for (uint32_t i = 0; i < outputs; i++)
+          bench_run_batch_job(NULL, i);
+
+        uint64_t medians[2];
+        for (uint32_t pooled = 0; pooled < 2; pooled++) {
+          for (uint32_t i = 0; i < max_iterations; i++) {
+            uint64_t start = now_ns();
+            if (!pooled || !delta_pool_run(outputs, bench_run_batch_job,
+                                           bench_finish_batch_job, NULL)) {
+              for (uint32_t j = 0; j < outputs; j++)
+                bench_run_batch_job(NULL, j);
+            }
+            samples[i] = now_ns() - start;
+          }
+          qsort(samples, max_iterations, sizeof(uint64_t), compare_uint64);
+          medians[pooled] = samples[max_iterations / 2];
+        }
+        printf("%s,%u,%u,%u,%u,%u,%lu,%lu\n",
+               delta_layout_descriptor(style)->name,
+               delta_pool_worker_count(), outputs, batch_view_count,
+               outputs * batch_view_count, max_iterations,
+               (unsigned long)medians[0], (unsigned long)medians[1]);
+      }
+    }
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(batch_buffers); i++)
+    delta_view_buffer_free(&batch_buffers[i]);
+  return true;
+}
+
+/**
+ * Benchmark every configuration of the layout styles
+ *
+ * @param only_style style to benchmark, or -1 for all of them
+ * @param max_iterations maximum number of demands timed per configuration
+ * @param samples room for max_iterations samples
+ * @param buffer view buffer reused by every demand
+ * @param serial serial of the last demand
+ * @return false on error
+ * */
+static bool bench_styles(int only_style, uint32_t max_iterations,
+                         uint64_t *samples, struct ViewBuffer *buffer,
+                         uint32_t *serial) {
+  // The layout object is never dereferenced by the stubbed marshalling
+  struct river_layout_v3 *layout = NULL;
+  const char *kernels =
+      delta_geometry_kernels_name(delta_geometry_selected_kernels());
+
+  for (uint32_t style = 0; style < delta_layout_count(); style++) {
+    if (only_style >= 0 && style != (uint32_t)only_style)
+      continue;
+    const char *name = delta_layout_descriptor(style)->name;
+    for (size_t v = 0; v < ARRAY_LENGTH(view_counts); v++) {
+      for (size_t r = 0; r < ARRAY_LENGTH(resolutions); r++) {
+        for (size_t p = 0; p < ARRAY_LENGTH(paddings); p++) {
+          struct LayoutParams params = {
+              .layout_style = style,
+              .main_count = 1,
+              .main_ratio = LAYOUT_RATIO_ONE * 55 / 100,
+              .view_padding = paddings[p][0],
+              .outer_padding = paddings[p][1],
+          };
+          uint32_t view_count = view_counts[v];
+          uint32_t width = resolutions[r][0], height = resolutions[r][1];
+          // Keep the work per configuration roughly constant
+          uint32_t iterations =
+              MIN(max_iterations, MAX(10, 1000000 / view_count));
+
+          // Warm up, letting the buffer grow to its final size
+          if (!delta_layout_compute(&params, view_count, width, height,
+                                    buffer)) {
+            fputs("Failed to allocate.\n", stderr);
+            return false;
+          }
+
+          uint64_t allocations = allocation_count, marshalled = marshal_count;
+          uint64_t total = 0, compute_total = 0;
+          for (uint32_t i = 0; i < iterations; i++) {
+            uint64_t start = now_ns();
+            delta_layout_compute(&params, view_count, width, height, buffer);
+            compute_total += now_ns() - start;
+            delta_emit_layout(layout, buffer, delta_layout_name(style),
+                              ++*serial);
+            samples[i] = now_ns() - start;
+            total += samples[i];
+          }
+          allocations = allocation_count - allocations;
+          marshalled = marshal_count - marshalled;
+          if (marshalled != (uint64_t)iterations * (view_count + 1)) {
+            fprintf(stderr, "ERROR: %s pushed the wrong number of views\n",
+                    name);
+            return false;
+          }
+
+          qsort(samples, iterations, sizeof(uint64_t), compare_uint64);
+          printf("%s,%s,%u,%u,%u,%u,%u,%u,%.1f,%lu,%lu,%.1f,%lu\n", name,
+                 kernels, view_count, width, height, params.view_padding,
+                 params.outer_padding, iterations, (double)total / iterations,
+                 (unsigned long)samples[iterations / 2],
+                 (unsigned long)samples[(uint64_t)iterations * 99 / 100],
+                 (double)compute_total / iterations,
+                 (unsigned long)allocations);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t max_iterations = 1000;
+  int only_style = -1;
+  bool all_kernels = false;
+  int batch_workers = -1;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-h") == 0 || strcmp(argv[arg], "--help") == 0) {
+      bench_print_help();
+      return EXIT_SUCCESS;
+    }
+    if (arg == argc - 1) {
+      fputs("ERROR: Argument with no value. All arguments must have values.\n",
+            stderr);
+      return EXIT_FAILURE;
+    }
+    if (strcmp(argv[arg], "-iterations") == 0) {
+      max_iterations = MAX(atoi(argv[arg + 1]), 1);
+      arg++;
+    } else if (strcmp(argv[arg], "-plugin") == 0) {
+      if (!delta_plugin_load(argv[++arg]))
+        return EXIT_FAILURE;
+    } else if (strcmp(argv[arg], "-program") == 0) {
+      if (!delta_program_load(argv[++arg]))
+        return EXIT_FAILURE;
+    } else if (strcmp(argv[arg], "-style") == 0) {
+      const char *name = argv[++arg];
+      uint32_t style;
+      if (!delta_layout_find(name, strlen(name), &style)) {
+        fprintf(stderr, "ERROR: unknown layout: %s\n", name);
+        return EXIT_FAILURE;
+      }
+      only_style = style;
+    } else if (strcmp(argv[arg], "-batches") == 0) {
+      int workers = atoi(argv[++arg]);
+      batch_workers = MIN(MAX(workers, 0), POOL_MAX_WORKERS);
+    } else if (strcmp(argv[arg], "-kernels") == 0) {
+      const char *name = argv[++arg];
+      int selected = -1;
+      for (int kernels = GEOMETRY_KERNELS_AUTO;
+           kernels <= GEOMETRY_KERNELS_AVX2; kernels++) {
+        if (strcmp(name, delta_geometry_kernels_name(kernels)) == 0)
+          selected = kernels;
+      }
+      all_kernels = strcmp(name, "all") == 0;
+      if (selected < 0 && !all_kernels) {
+        fprintf(stderr, "ERROR: unknown kernels: %s\n", name);
+        return EXIT_FAILURE;
+      }
+      if (selected >= 0 && !delta_geometry_select_kernels(selected)) {
+        fprintf(stderr, "ERROR: kernels not supported here: %s\n", name);
+        return EXIT_FAILURE;
+      }
+    } else {
+      fprintf(stderr, "ERROR: Unknown argument: %s\n", argv[arg]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  uint64_t *samples = malloc(max_iterations * sizeof(uint64_t));
+  if (samples == NULL) {
+    fputs("Failed to allocate.\n", stderr);
+    return EXIT_FAILURE;
+  }
+  if (batch_workers >= 0) {
+    bool ok = delta_pool_init(batch_workers) &&
+              bench_batches(only_style, max_iterations, samples);
+    delta_pool_finish();
+    free(samples);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  struct ViewBuffer buffer = {0};
+  uint32_t serial = 0;
+
+  puts("style,kernels,view_count,width,height,view_padding,outer_padding,"
+       "iterations,ns_per_demand,p50_ns,p99_ns,compute_ns,allocations");
+  bool ok = true;
+  if (!all_kernels) {
+    ok = bench_styles(only_style, max_iterations, samples, &buffer, &serial);
+  } else {
+    // Every implementation the CPU supports in turn
+    for (int kernels = GEOMETRY_KERNELS_SCALAR;
+         ok && kernels <= GEOMETRY_KERNELS_AVX2; kernels++) {
+      if (delta_geometry_select_kernels(kernels))
+        ok = bench_styles(only_style, max_iterations, samples, &buffer,
+                          &serial);
+    }
+  }
+  if (!ok)
+    return EXIT_FAILURE;
+
+  delta_view_buffer_free(&buffer);
+  free(samples);
+  return EXIT_SUCCESS;
+}
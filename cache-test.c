@@ -0,0 +1,140 @@
+/*
+ * Checks of the layout cache of delta
+ *
+ * Runs demands and precomputed (speculative) layouts through a cache and
+ * checks that:
+ *  - precomputing never drops a demanded layout, however many are made
+ *  - demanded layouts only drop each other, least recently used first
+ *  - a precomputed layout that is demanded is kept like a demanded one
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cache.h"
+#include "layout.h"
+
+static uint32_t failures = 0;
+
+static void test_check(bool ok, const char *problem) {
+  if (ok)
+    return;
+  fprintf(stderr, "FAILED: %s\n", problem);
+  failures++;
+}
+
+/* Layouts only differ by their number of views here */
+static struct LayoutCacheKey test_key(uint32_t view_count) {
+  return (struct LayoutCacheKey){
+      .params = {.layout_style = TILE,
+                 .main_count = 1,
+                 .main_ratio = LAYOUT_RATIO_ONE / 2,
+                 .view_padding = 5,
+                 .outer_padding = 5},
+      .view_count = view_count,
+      .width = 1920,
+      .height = 1080,
+  };
+}
+
+/* Answer a demand like delta does, computing nothing */
+static bool test_demand(struct LayoutCache *cache, uint32_t view_count) {
+  struct LayoutCacheKey key = test_key(view_count);
+  if (delta_layout_cache_lookup(cache, &key) != NULL)
+    return true;
+  delta_layout_cache_insert(cache,
+                            delta_layout_cache_claim(cache, &key, false));
+  return false;
+}
+
+static void test_speculate(struct LayoutCache *cache, uint32_t view_count) {
+  struct LayoutCacheKey key = test_key(view_count);
+  delta_layout_cache_insert(cache,
+                            delta_layout_cache_claim(cache, &key, true));
+  cache->speculated++;
+}
+
+static bool test_contains(const struct LayoutCache *cache,
+                          uint32_t view_count) {
+  struct LayoutCacheKey key = test_key(view_count);
+  return delta_layout_cache_contains(cache, &key);
+}
+
+static void test_speculation_keeps_demanded(void) {
+  struct LayoutCache cache = {0};
+  for (uint32_t i = 1; i <= LAYOUT_CACHE_SIZE; i++)
+    test_demand(&cache, i);
+  for (uint32_t i = 100; i < 200; i++)
+    test_speculate(&cache, i);
+  for (uint32_t i = 1; i <= LAYOUT_CACHE_SIZE; i++)
+    test_check(test_demand(&cache, i),
+               "a demanded layout was dropped for a precomputed one");
+  test_check(cache.misses == LAYOUT_CACHE_SIZE && cache.speculative_hits == 0,
+             "demands were counted wrong");
+  test_check(cache.speculative_wasted == 100 - LAYOUT_CACHE_SPECULATIVE,
+             "dropped precomputed layouts were counted wrong");
+  for (uint32_t i = 200 - LAYOUT_CACHE_SPECULATIVE; i < 200; i++)
+    test_check(test_contains(&cache, i),
+               "a recent precomputed layout was dropped");
+  delta_layout_cache_free(&cache);
+}
+
+static void test_demanded_drop_oldest(void) {
+  struct LayoutCache cache = {0};
+  for (uint32_t i = 100; i < 100 + LAYOUT_CACHE_SPECULATIVE; i++)
+    test_speculate(&cache, i);
+  for (uint32_t i = 1; i <= 3 * LAYOUT_CACHE_SIZE; i++)
+    test_demand(&cache, i);
+  for (uint32_t i = 1; i <= 3 * LAYOUT_CACHE_SIZE; i++)
+    test_check(test_contains(&cache, i) == (i > 2 * LAYOUT_CACHE_SIZE),
+               "demanded layouts weren't dropped least recently used first");
+  for (uint32_t i = 100; i < 100 + LAYOUT_CACHE_SPECULATIVE; i++)
+    test_check(test_contains(&cache, i),
+               "a precomputed layout was dropped for a demanded one");
+  delta_layout_cache_free(&cache);
+}
+
+static void test_speculative_hit(void) {
+  struct LayoutCache cache = {0};
+  for (uint32_t i = 1; i <= LAYOUT_CACHE_SIZE; i++)
+    test_demand(&cache, i);
+  test_speculate(&cache, 100);
+  test_check(test_demand(&cache, 100), "a precomputed layout wasn't used");
+  test_check(cache.speculative_hits == 1, "the use wasn't counted");
+  // It took the place of the least recently demanded layout
+  test_check(!test_contains(&cache, 1) && test_contains(&cache, 2),
+             "using a precomputed layout dropped the wrong layout");
+  // and is now kept like any demanded layout
+  for (uint32_t i = 200; i < 300; i++)
+    test_speculate(&cache, i);
+  test_check(test_contains(&cache, 100),
+             "a used precomputed layout was dropped for another one");
+  delta_layout_cache_free(&cache);
+}
+
+int main(int argc, char *argv[]) {
+  test_speculation_keeps_demanded();
+  test_demanded_drop_oldest();
+  test_speculative_hit();
+  if (failures != 0)
+    return EXIT_FAILURE;
+  puts("Layout cache checks passed");
+  return EXIT_SUCCESS;
+}
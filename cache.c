@@ -0,0 +1,139 @@
+/*
+ * Bounded LRU cache of the layouts computed for an output
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "layout.h"
+
+#define LAYOUT_CACHE_ENTRIES (LAYOUT_CACHE_SIZE + LAYOUT_CACHE_SPECULATIVE)
+
+static bool delta_layout_cache_key_equal(const struct LayoutCacheKey *a,
+                                         const struct LayoutCacheKey *b) {
+  return delta_layout_params_equivalent(&a->params, &b->params) &&
+         a->view_count == b->view_count && a->width == b->width &&
+         a->height == b->height;
+}
+
+/* Number of layouts of a kind held */
+static uint32_t delta_layout_cache_count(const struct LayoutCache *cache,
+                                         bool speculative) {
+  uint32_t count = 0;
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++) {
+    const struct LayoutCacheEntry *entry = &cache->entries[i];
+    count += entry->last_used != 0 && entry->speculative == speculative;
+  }
+  return count;
+}
+
+/* An empty entry, there is one while a kind has room for another layout */
+static struct LayoutCacheEntry *
+delta_layout_cache_empty(struct LayoutCache *cache) {
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++) {
+    if (cache->entries[i].last_used == 0)
+      return &cache->entries[i];
+  }
+  return NULL;
+}
+
+/* Least recently used layout of a kind, NULL if there is none */
+static struct LayoutCacheEntry *
+delta_layout_cache_oldest(struct LayoutCache *cache, bool speculative) {
+  struct LayoutCacheEntry *oldest = NULL;
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++) {
+    struct LayoutCacheEntry *entry = &cache->entries[i];
+    if (entry->last_used != 0 && entry->speculative == speculative &&
+        (oldest == NULL || entry->last_used < oldest->last_used))
+      oldest = entry;
+  }
+  return oldest;
+}
+
+/* Make an entry empty */
+static void delta_layout_cache_drop(struct LayoutCache *cache,
+                                    struct LayoutCacheEntry *entry) {
+  if (entry->last_used != 0 && entry->speculative)
+    cache->speculative_wasted++;
+  entry->last_used = 0;
+  entry->speculative = false;
+}
+
+struct LayoutCacheEntry *
+delta_layout_cache_lookup(struct LayoutCache *cache,
+                          const struct LayoutCacheKey *key) {
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++) {
+    struct LayoutCacheEntry *entry = &cache->entries[i];
+    if (entry->last_used == 0 ||
+        !delta_layout_cache_key_equal(&entry->key, key))
+      continue;
+    if (entry->speculative) {
+      if (delta_layout_cache_count(cache, false) == LAYOUT_CACHE_SIZE)
+        delta_layout_cache_drop(cache,
+                                delta_layout_cache_oldest(cache, false));
+      cache->speculative_hits++;
+      entry->speculative = false;
+    }
+    entry->last_used = ++cache->clock;
+    cache->hits++;
+    return entry;
+  }
+  cache->misses++;
+  return NULL;
+}
+
+struct LayoutCacheEntry *
+delta_layout_cache_claim(struct LayoutCache *cache,
+                         const struct LayoutCacheKey *key, bool speculative) {
+  // Each kind only ever replaces its own layouts once it holds its share
+  uint32_t limit = speculative ? LAYOUT_CACHE_SPECULATIVE : LAYOUT_CACHE_SIZE;
+  struct LayoutCacheEntry *victim =
+      delta_layout_cache_count(cache, speculative) < limit
+          ? delta_layout_cache_empty(cache)
+          : delta_layout_cache_oldest(cache, speculative);
+  delta_layout_cache_drop(cache, victim);
+  victim->speculative = speculative;
+  victim->key = *key;
+  return victim;
+}
+
+void delta_layout_cache_insert(struct LayoutCache *cache,
+                               struct LayoutCacheEntry *entry) {
+  entry->last_used = ++cache->clock;
+}
+
+bool delta_layout_cache_contains(const struct LayoutCache *cache,
+                                 const struct LayoutCacheKey *key) {
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++) {
+    if (cache->entries[i].last_used != 0 &&
+        delta_layout_cache_key_equal(&cache->entries[i].key, key))
+      return true;
+  }
+  return false;
+}
+
+void delta_layout_cache_clear(struct LayoutCache *cache) {
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++)
+    delta_layout_cache_drop(cache, &cache->entries[i]);
+}
+
+void delta_layout_cache_free(struct LayoutCache *cache) {
+  for (unsigned int i = 0; i < LAYOUT_CACHE_ENTRIES; i++)
+    delta_view_buffer_free(&cache->entries[i].views);
+}
@@ -0,0 +1,110 @@
+/*
+ * Bounded LRU cache of the layouts computed for an output
+ *
+ * Layouts precomputed while delta is idle (speculative ones) are kept apart
+ * from those that were demanded: they only ever replace each other, so
+ * precomputing never pushes out a layout the compositor asked for. A
+ * speculative layout that gets demanded becomes an ordinary one.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_CACHE_H
+#define DELTA_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "layout.h"
+
+/* Number of demanded layouts remembered for each output */
+#define LAYOUT_CACHE_SIZE 8
+
+/* Number of speculative layouts remembered on top of those */
+#define LAYOUT_CACHE_SPECULATIVE 4
+
+/* Everything the geometry of a layout depends on */
+struct LayoutCacheKey {
+  struct LayoutParams params;
+  uint32_t view_count;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct LayoutCacheEntry {
+  struct LayoutCacheKey key;
+  struct ViewBuffer views;
+  uint64_t last_used; // Value of the cache clock on last use, 0 if empty
+  bool speculative;   // Precomputed while idle, and not used since
+};
+
+/* A zeroed cache is empty */
+struct LayoutCache {
+  struct LayoutCacheEntry
+      entries[LAYOUT_CACHE_SIZE + LAYOUT_CACHE_SPECULATIVE];
+  uint64_t clock;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t speculated;         // Layouts precomputed while idle
+  uint64_t speculative_hits;   // Demands answered with one of them
+  uint64_t speculative_wasted; // Those dropped without being used
+};
+
+/**
+ * Look up a previously computed layout for a demand
+ *
+ * A speculative layout found becomes a demanded one, which may drop the
+ * least recently used demanded layout to make room.
+ *
+ * @param cache cache of the output
+ * @param key parameters of the layout demand
+ * @return the matching entry, or NULL if the layout has to be computed
+ * */
+struct LayoutCacheEntry *
+delta_layout_cache_lookup(struct LayoutCache *cache,
+                          const struct LayoutCacheKey *key);
+
+/**
+ * Pick the entry a new layout is computed into
+ *
+ * An empty entry is used while there is room for one more layout of the
+ * kind, otherwise the least recently used layout of the same kind is
+ * replaced. Its view buffer is only ever grown, so a warm cache does not
+ * allocate. The entry stays empty until delta_layout_cache_insert.
+ *
+ * @param cache cache of the output
+ * @param key parameters of the layout
+ * @param speculative whether the layout is precomputed rather than demanded
+ * @return the entry to compute the layout into
+ * */
+struct LayoutCacheEntry *
+delta_layout_cache_claim(struct LayoutCache *cache,
+                         const struct LayoutCacheKey *key, bool speculative);
+
+/* Make an entry holding a computed layout available for lookups */
+void delta_layout_cache_insert(struct LayoutCache *cache,
+                               struct LayoutCacheEntry *entry);
+
+/* Whether a layout is cached, without counting it as a use */
+bool delta_layout_cache_contains(const struct LayoutCache *cache,
+                                 const struct LayoutCacheKey *key);
+
+/* Forget every cached layout, the view buffers are kept */
+void delta_layout_cache_clear(struct LayoutCache *cache);
+
+void delta_layout_cache_free(struct LayoutCache *cache);
+
+#endif
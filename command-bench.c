@@ -0,0 +1,123 @@
+/*
+ * Throughput benchmark for the user command parser of delta
+ *
+ * Every command of a small corpus of typical (and a few invalid) commands is
+ * applied over and over, and the time per command is printed as CSV, one
+ * line per command, so that runs on different revisions can be compared.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "command.h"
+#include "layout.h"
+
+#define MAX(a, b) (a > b ? a : b)
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+static const char *corpus[] = {
+    "main_ratio +0.05",
+    "main_ratio -0.05",
+    "main_count +1",
+    "main_count -1",
+    "view_padding 10",
+    "outer_padding 0",
+    "set_layout grid",
+    "swap_layout",
+    "toggle_monocle",
+    "reset",
+    "set_layout diminishing; main_count 2; main_ratio 0.6",
+    "  main_ratio   0.5  ",
+    "set_layout bogus",
+    "main_count 12x",
+    "not_a_command",
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_print_help(void) {
+  puts("Benchmark the user command parser of delta\n"
+       "\n"
+       "Usage: delta-command-bench [options]\n"
+       "\t-h,--help: Print this help message and exit\n"
+       "\t-iterations <count>: Number of times every command is applied\n"
+       "\n"
+       "Output is CSV, one line per command, with the mean time per command\n"
+       "in nanoseconds and the resulting commands per second. The last line\n"
+       "covers the whole corpus.");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t iterations = 1000000;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-h") == 0 || strcmp(argv[arg], "--help") == 0) {
+      bench_print_help();
+      return EXIT_SUCCESS;
+    }
+    if (arg == argc - 1) {
+      fputs("ERROR: Argument with no value. All arguments must have values.\n",
+            stderr);
+      return EXIT_FAILURE;
+    }
+    if (strcmp(argv[arg], "-iterations") == 0) {
+      iterations = MAX(atoi(argv[arg + 1]), 1);
+      arg++;
+    } else {
+      fprintf(stderr, "ERROR: Unknown argument: %s\n", argv[arg]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const struct LayoutParams defaults = {
+      .layout_style = TILE,
+      .main_count = 1,
+      .main_ratio = LAYOUT_RATIO_ONE / 2,
+      .view_padding = 5,
+      .outer_padding = 5,
+  };
+  struct CommandState state = {.params = defaults, .monocle_switch = MONOCLE};
+  uint64_t valid = 0, total_ns = 0;
+
+  puts("command,iterations,ns_per_command,commands_per_second");
+  for (size_t i = 0; i < ARRAY_LENGTH(corpus); i++) {
+    uint64_t start = now_ns();
+    for (uint32_t j = 0; j < iterations; j++)
+      valid += delta_command_apply(corpus[i], &defaults, &state, NULL);
+    uint64_t elapsed = now_ns() - start;
+    total_ns += elapsed;
+    printf("\"%s\",%u,%.1f,%.0f\n", corpus[i], iterations,
+           (double)elapsed / iterations, iterations / (elapsed / 1e9));
+  }
+  uint64_t total = (uint64_t)iterations * ARRAY_LENGTH(corpus);
+  printf("all,%lu,%.1f,%.0f\n", (unsigned long)total, (double)total_ns / total,
+         total / (total_ns / 1e9));
+
+  // Use the results, so the compiler can't drop any of the work
+  if (valid == 0 || state.params.main_ratio > LAYOUT_RATIO_ONE)
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
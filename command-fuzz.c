@@ -0,0 +1,298 @@
+/*
+ * Fuzz driver for the user command parser of delta
+ *
+ * Random command strings, built from a mix of real command names, numbers,
+ * layout names, separators and garbage bytes, are applied and checked:
+ *  - a rejected string leaves the state untouched, and its error points into
+ *    the string
+ *  - an accepted string leaves the parameters in their valid ranges, and
+ *    has the same effect as applying its commands one at a time
+ *
+ * Built with -DDELTA_LIBFUZZER, it instead provides LLVMFuzzerTestOneInput
+ * for libFuzzer (-fsanitize=fuzzer), running the same checks.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "layout.h"
+
+#define MAX(a, b) (a > b ? a : b)
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Longest generated command string */
+#define FUZZ_MAX_LENGTH 256
+
+static const char *words[] = {
+    "main_count", "view_padding", "outer_padding", "main_ratio",
+    "set_layout", "reset",        "swap_layout",   "toggle_monocle",
+    "main_coun",  "main_count_",  "MAIN_COUNT",    "tile",
+    "spiral",     "diminishing",  "column",        "stack",
+    "grid",       "monocle",      "0",             "1",
+    "+1",         "-1",           "+0.05",         "-0.05",
+    "0.5",        ".5",           "5.",            "1e3",
+    "0.0000001",  "4294.999999",  "0.123456",      "-0.000001",
+    "inf",        "nan",          "0x10",          "4294967295",
+    "4294967296", "-4294967295",  "99999999999",   "+",
+    "-",          ".",            "1.2.3",         "--1",
+    "load_layout", "load_program", "/tmp/layouts.so", "layouts.so",
+};
+
+static const char *spaces[] = {" ", "  ", "\t", "\n", ";", " ; ", ";;"};
+
+static uint64_t rng_state = 1;
+
+/* xorshift64*, plenty for generating inputs */
+static uint64_t fuzz_random(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ull;
+}
+
+static bool fuzz_state_equal(const struct CommandState *a,
+                             const struct CommandState *b) {
+  return delta_layout_params_equal(&a->params, &b->params) &&
+         a->monocle_switch == b->monocle_switch;
+}
+
+static void fuzz_fail(const char *input, const char *problem) {
+  fprintf(stderr, "FAILED: %s\ninput:", problem);
+  for (const char *c = input; *c != '\0'; c++)
+    fprintf(stderr, " %02x", (unsigned char)*c);
+  fprintf(stderr, "\n'%s'\n", input);
+  abort();
+}
+
+/* Check a command string, returns whether it was accepted */
+static bool fuzz_check(const char *input, const struct CommandState *start) {
+  const struct LayoutParams defaults = {
+      .layout_style = TILE,
+      .main_count = 1,
+      .main_ratio = LAYOUT_RATIO_ONE / 2,
+      .view_padding = 5,
+      .outer_padding = 5,
+  };
+  size_t length = strlen(input);
+
+  struct CommandState state = *start;
+  struct CommandError error;
+  if (!delta_command_apply(input, &defaults, &state, &error)) {
+    if (!fuzz_state_equal(&state, start))
+      fuzz_fail(input, "rejected command modified the state");
+    if (error.index == 0 || error.message == NULL)
+      fuzz_fail(input, "incomplete error");
+    if (error.token < input ||
+        error.token + error.token_length > input + length)
+      fuzz_fail(input, "error token outside of the command");
+    return false;
+  }
+
+  if (state.params.main_ratio < LAYOUT_RATIO_ONE / 10 ||
+      state.params.main_ratio > LAYOUT_RATIO_ONE * 9 / 10 ||
+      state.params.layout_style >= delta_layout_count() ||
+      state.monocle_switch >= delta_layout_count() ||
+      !delta_layout_allowed(state.styles, state.params.layout_style))
+    fuzz_fail(input, "accepted command left invalid parameters");
+  if (state.plugin != NULL &&
+      (state.plugin < input || state.plugin[0] != '/' ||
+       state.plugin + state.plugin_length > input + length))
+    fuzz_fail(input, "plugin path is not an absolute path in the command");
+  if (state.program != NULL &&
+      (state.program < input || state.program[0] != '/' ||
+       state.program + state.program_length > input + length))
+    fuzz_fail(input, "program path is not an absolute path in the command");
+
+  // Applying the commands one at a time has to give the same result
+  char split[FUZZ_MAX_LENGTH + 1];
+  if (length > FUZZ_MAX_LENGTH)
+    return true;
+  memcpy(split, input, length + 1);
+  struct CommandState sequential = *start;
+  for (char *next = split; next != NULL;) {
+    char *single = next;
+    next = strchr(single, COMMAND_SEPARATOR);
+    if (next != NULL)
+      *next++ = '\0';
+    if (!delta_command_apply(single, &defaults, &sequential, NULL))
+      fuzz_fail(input, "a command of an accepted batch is invalid alone");
+  }
+  if (!fuzz_state_equal(&state, &sequential))
+    fuzz_fail(input, "batch differs from applying its commands in turn");
+  return true;
+}
+
+#ifdef DELTA_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  char input[FUZZ_MAX_LENGTH + 1];
+  size = size > FUZZ_MAX_LENGTH ? FUZZ_MAX_LENGTH : size;
+  memcpy(input, data, size);
+  input[size] = '\0';
+  const struct CommandState start = {
+      .params = {.layout_style = SPIRAL,
+                 .main_count = 2,
+                 .main_ratio = LAYOUT_RATIO_ONE * 6 / 10,
+                 .view_padding = 3,
+                 .outer_padding = 7},
+      .monocle_switch = MONOCLE,
+  };
+  fuzz_check(input, &start);
+  return 0;
+}
+
+#else
+
+/* Build a random command string in input */
+static void fuzz_generate(char *input) {
+  size_t length = 0;
+  uint32_t pieces = fuzz_random() % 12;
+  for (uint32_t i = 0; i < pieces; i++) {
+    const char *piece;
+    char byte[2] = {0};
+    uint64_t choice = fuzz_random() % 10;
+    if (choice < 5) {
+      piece = words[fuzz_random() % ARRAY_LENGTH(words)];
+    } else if (choice < 9) {
+      piece = spaces[fuzz_random() % ARRAY_LENGTH(spaces)];
+    } else {
+      // Any byte but the terminator
+      byte[0] = (char)(fuzz_random() % 255 + 1);
+      piece = byte;
+    }
+    size_t piece_length = strlen(piece);
+    if (length + piece_length > FUZZ_MAX_LENGTH)
+      break;
+    memcpy(input + length, piece, piece_length);
+    length += piece_length;
+  }
+  input[length] = '\0';
+}
+
+/* One of each command, all valid, so each has to be found by name */
+static const char *every_command[] = {
+    "main_count 2",
+    "view_padding 2",
+    "outer_padding 2",
+    "main_ratio 0.5",
+    "set_layout grid",
+    "reset",
+    "swap_layout",
+    "toggle_monocle",
+    "load_layout /tmp/layouts.so",
+    "load_program /tmp/layout.dl",
+};
+
+static void fuzz_check_every_command(void) {
+  for (size_t i = 0; i < ARRAY_LENGTH(every_command); i++) {
+    const struct LayoutParams defaults = {.layout_style = TILE};
+    struct CommandState state = {.params = defaults,
+                                 .monocle_switch = MONOCLE};
+    if (!delta_command_apply(every_command[i], &defaults, &state, NULL))
+      fuzz_fail(every_command[i], "a valid command is rejected");
+  }
+}
+
+static void fuzz_print_help(void) {
+  puts("Fuzz the user command parser of delta\n"
+       "\n"
+       "Usage: delta-command-fuzz [options]\n"
+       "\t-h,--help: Print this help message and exit\n"
+       "\t-iterations <count>: Number of random command strings to check\n"
+       "\t-seed <seed>: Seed of the random generator\n"
+       "\n"
+       "Aborts, printing the input, on the first failed check.");
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t iterations = 1000000;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-h") == 0 || strcmp(argv[arg], "--help") == 0) {
+      fuzz_print_help();
+      return EXIT_SUCCESS;
+    }
+    if (arg == argc - 1) {
+      fputs("ERROR: Argument with no value. All arguments must have values.\n",
+            stderr);
+      return EXIT_FAILURE;
+    }
+    if (strcmp(argv[arg], "-iterations") == 0) {
+      iterations = MAX(atoi(argv[arg + 1]), 1);
+      arg++;
+    } else if (strcmp(argv[arg], "-seed") == 0) {
+      rng_state = strtoull(argv[++arg], NULL, 10);
+      // xorshift gets stuck at 0
+      if (rng_state == 0)
+        rng_state = 1;
+    } else {
+      fprintf(stderr, "ERROR: Unknown argument: %s\n", argv[arg]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  fuzz_check_every_command();
+  char input[FUZZ_MAX_LENGTH + 1];
+  uint64_t accepted = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    struct CommandState start = {
+        .params = {.layout_style = fuzz_random() % delta_layout_count(),
+                   .main_count = fuzz_random() % 4,
+                   .main_ratio = LAYOUT_RATIO_ONE / 10 +
+                                 fuzz_random() % (LAYOUT_RATIO_ONE * 8 / 10),
+                   .view_padding = fuzz_random() % 20,
+                   .outer_padding = fuzz_random() % 20},
+        .monocle_switch = fuzz_random() % delta_layout_count(),
+    };
+    // Half of the time only some layouts are allowed, always including the
+    // current and default ones
+    if (fuzz_random() % 2 == 0)
+      start.styles = fuzz_random() | 1ull << start.params.layout_style |
+                     1ull << TILE;
+    // and some of those go through them in a random order
+    struct LayoutCycle cycle = {0};
+    if (start.styles != 0 && fuzz_random() % 2 == 0) {
+      uint32_t order[LAYOUT_MAX_COUNT], allowed = 0;
+      for (uint32_t style = 0; style < delta_layout_count(); style++)
+        if (delta_layout_allowed(start.styles, style))
+          order[allowed++] = style;
+      for (uint32_t j = allowed; j > 1; j--) {
+        uint32_t k = fuzz_random() % j, style = order[j - 1];
+        order[j - 1] = order[k];
+        order[k] = style;
+      }
+      for (uint32_t j = 0; j < allowed; j++)
+        delta_layout_cycle_add(&cycle, order[j]);
+      start.styles = cycle.styles;
+      start.cycle = cycle.order;
+      start.cycle_length = cycle.length;
+    }
+    fuzz_generate(input);
+    accepted += fuzz_check(input, &start);
+  }
+  printf("Checked %u command strings, %lu of them valid\n", iterations,
+         (unsigned long)accepted);
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,548 @@
+/*
+ * Parsing and applying the user commands of delta
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "command.h"
+#include "layout.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+#define CLAMP(a, b, c) (MIN(MAX(b, c), MAX(MIN(b, c), a)))
+
+/* A command only needs its name and one argument, one more token is kept to
+ * point at in the error for too many arguments
+ */
+#define COMMAND_MAX_TOKENS 3
+
+/* Slots of the command hash table, a power of two well above the number of
+ * commands so lookups rarely probe
+ */
+#define COMMAND_HASH_SIZE 32
+
+/* A word of a command, pointing into the command string */
+struct Token {
+  const char *start;
+  size_t length;
+};
+
+enum CommandValue {
+  COMMAND_NONE,   // The command has no argument
+  COMMAND_UINT32, // Absolute, or relative if it starts with '+' or '-'
+  COMMAND_RATIO,  // Absolute or relative, clamped to the range of the command
+  COMMAND_LAYOUT, // Name of a layout style
+  COMMAND_PATH,   // Absolute path of a file
+};
+
+struct CommandSpec;
+
+/**
+ * Carry out a command on the state
+ *
+ * @param spec the command
+ * @param argument the argument, NULL if the command has none
+ * @param defaults parameters restored by reset
+ * @param state state to modify
+ * @param message set to a description of the problem if the argument is
+ * invalid
+ * @return false if the argument is invalid
+ * */
+typedef bool (*CommandHandler)(const struct CommandSpec *spec,
+                               const struct Token *argument,
+                               const struct LayoutParams *defaults,
+                               struct CommandState *state,
+                               const char **message);
+
+struct CommandSpec {
+  const char *name;
+  uint32_t arity; // Number of arguments, 0 or 1
+  enum CommandValue type;
+  size_t offset; // Offset of the modified field in struct LayoutParams
+  uint32_t min, max; // Range of a ratio
+  CommandHandler handler;
+};
+
+struct CommandSlot {
+  uint32_t hash;
+  const struct CommandSpec *spec; // NULL for an empty slot
+};
+
+static bool delta_command_set_value(const struct CommandSpec *spec,
+                                    const struct Token *argument,
+                                    const struct LayoutParams *defaults,
+                                    struct CommandState *state,
+                                    const char **message);
+static bool delta_command_set_layout(const struct CommandSpec *spec,
+                                     const struct Token *argument,
+                                     const struct LayoutParams *defaults,
+                                     struct CommandState *state,
+                                     const char **message);
+static bool delta_command_reset(const struct CommandSpec *spec,
+                                const struct Token *argument,
+                                const struct LayoutParams *defaults,
+                                struct CommandState *state,
+                                const char **message);
+static bool delta_command_swap_layout(const struct CommandSpec *spec,
+                                      const struct Token *argument,
+                                      const struct LayoutParams *defaults,
+                                      struct CommandState *state,
+                                      const char **message);
+static bool delta_command_toggle_monocle(const struct CommandSpec *spec,
+                                         const struct Token *argument,
+                                         const struct LayoutParams *defaults,
+                                         struct CommandState *state,
+                                         const char **message);
+static bool delta_command_load_layout(const struct CommandSpec *spec,
+                                      const struct Token *argument,
+                                      const struct LayoutParams *defaults,
+                                      struct CommandState *state,
+                                      const char **message);
+static bool delta_command_load_program(const struct CommandSpec *spec,
+                                       const struct Token *argument,
+                                       const struct LayoutParams *defaults,
+                                       struct CommandState *state,
+                                       const char **message);
+
+static const struct CommandSpec commands[] = {
+    {"main_count", 1, COMMAND_UINT32, offsetof(struct LayoutParams, main_count),
+     0, 0, delta_command_set_value},
+    {"view_padding", 1, COMMAND_UINT32,
+     offsetof(struct LayoutParams, view_padding), 0, 0,
+     delta_command_set_value},
+    {"outer_padding", 1, COMMAND_UINT32,
+     offsetof(struct LayoutParams, outer_padding), 0, 0,
+     delta_command_set_value},
+    {"main_ratio", 1, COMMAND_RATIO, offsetof(struct LayoutParams, main_ratio),
+     LAYOUT_RATIO_ONE / 10, LAYOUT_RATIO_ONE * 9 / 10, delta_command_set_value},
+    {"set_layout", 1, COMMAND_LAYOUT,
+     offsetof(struct LayoutParams, layout_style), 0, 0,
+     delta_command_set_layout},
+    {"reset", 0, COMMAND_NONE, 0, 0, 0, delta_command_reset},
+    {"swap_layout", 0, COMMAND_NONE, 0, 0, 0, delta_command_swap_layout},
+    {"toggle_monocle", 0, COMMAND_NONE, 0, 0, 0,
+     delta_command_toggle_monocle},
+    {"load_layout", 1, COMMAND_PATH, 0, 0, 0, delta_command_load_layout},
+    {"load_program", 1, COMMAND_PATH, 0, 0, 0, delta_command_load_program},
+};
+
+/* Hash table of the commands, worked out ahead of time: each name is in the
+ * slot its FNV-1a hash (delta_command_hash) picks modulo COMMAND_HASH_SIZE,
+ * or in the next free one after it. A command added above needs its slot
+ * here as well, delta-command-fuzz checks that every command is found. */
+static const struct CommandSlot command_slots[COMMAND_HASH_SIZE] = {
+    [0] = {0x650d33c0u, &commands[5]},   // reset
+    [2] = {0xcbf31302u, &commands[9]},   // load_program
+    [4] = {0x0e8d5404u, &commands[0]},   // main_count
+    [9] = {0xe00b3e29u, &commands[6]},   // swap_layout
+    [17] = {0xe4658651u, &commands[7]},  // toggle_monocle
+    [20] = {0x5ba7a594u, &commands[3]},  // main_ratio
+    [22] = {0x1bb54456u, &commands[1]},  // view_padding
+    [26] = {0xa69f56dau, &commands[2]},  // outer_padding
+    [27] = {0xb9492e9au, &commands[4]},  // set_layout, after outer_padding
+    [28] = {0x708d241cu, &commands[8]},  // load_layout
+};
+
+/* isspace is undefined for negative values, which a plain char can hold */
+static bool is_space(char c) { return isspace((unsigned char)c); }
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/* 32 bit FNV-1a */
+static uint32_t delta_command_hash(const char *string, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)string[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static const struct CommandSpec *
+delta_command_lookup(const struct Token *name) {
+  uint32_t hash = delta_command_hash(name->start, name->length);
+  for (uint32_t slot = hash % COMMAND_HASH_SIZE;
+       command_slots[slot].spec != NULL;
+       slot = (slot + 1) % COMMAND_HASH_SIZE) {
+    const struct CommandSpec *spec = command_slots[slot].spec;
+    if (command_slots[slot].hash == hash &&
+        strncmp(spec->name, name->start, name->length) == 0 &&
+        spec->name[name->length] == '\0')
+      return spec;
+  }
+  return NULL;
+}
+
+/**
+ * Parse an unsigned integer argument
+ *
+ * @param token the argument, only digits, optionally preceded by a sign
+ * @param current value the argument is relative to if it has a sign
+ * @param value set to the new value, saturated to the range of a uint32_t
+ * @param message set to a description of the problem on error
+ * @return false if the argument is not a valid number
+ * */
+static bool delta_command_parse_uint32(const struct Token *token,
+                                       uint32_t current, uint32_t *value,
+                                       const char **message) {
+  const char *c = token->start, *end = token->start + token->length;
+  char sign = (*c == '+' || *c == '-') ? *c++ : '\0';
+  if (c == end) {
+    *message = "Invalid number";
+    return false;
+  }
+  uint64_t number = 0;
+  for (; c < end; c++) {
+    if (!is_digit(*c)) {
+      *message = "Invalid number";
+      return false;
+    }
+    number = number * 10 + (*c - '0');
+    if (number > UINT32_MAX) {
+      *message = "Number out of range";
+      return false;
+    }
+  }
+
+  if (sign == '+')
+    *value = (uint32_t)MIN(current + number, UINT32_MAX);
+  else if (sign == '-')
+    *value = number > current ? 0 : current - (uint32_t)number;
+  else
+    *value = (uint32_t)number;
+  return true;
+}
+
+/**
+ * Parse a ratio argument
+ *
+ * @param token the argument, digits with at most one decimal point and six
+ * decimals, optionally preceded by a sign
+ * @param sign set to the sign of the argument, '\0' if it has none
+ * @param value set to the magnitude of the ratio, in fixed point
+ * @param message set to a description of the problem on error
+ * @return false if the argument is not a valid number
+ * */
+static bool delta_command_parse_ratio(const struct Token *token, char *sign,
+                                      uint32_t *value, const char **message) {
+  const char *c = token->start, *end = token->start + token->length;
+  *sign = (*c == '+' || *c == '-') ? *c++ : '\0';
+  uint64_t whole = 0, fraction = 0;
+  uint32_t scale = LAYOUT_RATIO_ONE; // Value of the next decimal
+  bool digits = false, point = false;
+  for (; c < end; c++) {
+    if (*c == '.' && !point) {
+      point = true;
+      continue;
+    }
+    if (!is_digit(*c)) {
+      *message = "Invalid number";
+      return false;
+    }
+    digits = true;
+    if (!point) {
+      whole = whole * 10 + (*c - '0');
+      if (whole > UINT32_MAX / LAYOUT_RATIO_ONE) {
+        *message = "Number out of range";
+        return false;
+      }
+    } else {
+      scale /= 10;
+      if (scale == 0) {
+        *message = "Too many decimals";
+        return false;
+      }
+      fraction += (*c - '0') * scale;
+    }
+  }
+  if (!digits) {
+    *message = "Invalid number";
+    return false;
+  }
+  uint64_t ratio = whole * LAYOUT_RATIO_ONE + fraction;
+  if (ratio > UINT32_MAX) {
+    *message = "Number out of range";
+    return false;
+  }
+  *value = ratio;
+  return true;
+}
+
+bool delta_command_number(const char *value, size_t length,
+                          uint32_t *number) {
+  const struct Token token = {value, length};
+  const char *message;
+  return length > 0 && is_digit(*value) &&
+         delta_command_parse_uint32(&token, 0, number, &message);
+}
+
+bool delta_command_ratio(const char *value, size_t length, uint32_t *ratio) {
+  const struct Token token = {value, length};
+  const char *message;
+  char sign;
+  return length > 0 && *value != '+' && *value != '-' &&
+         delta_command_parse_ratio(&token, &sign, ratio, &message);
+}
+
+static bool delta_command_set_value(const struct CommandSpec *spec,
+                                    const struct Token *argument,
+                                    const struct LayoutParams *defaults,
+                                    struct CommandState *state,
+                                    const char **message) {
+  uint32_t *value = (uint32_t *)((char *)&state->params + spec->offset);
+  if (spec->type == COMMAND_UINT32)
+    return delta_command_parse_uint32(argument, *value, value, message);
+
+  uint32_t ratio;
+  char sign;
+  if (!delta_command_parse_ratio(argument, &sign, &ratio, message))
+    return false;
+  int64_t result = ratio;
+  if (sign == '+')
+    result = (int64_t)*value + ratio;
+  else if (sign == '-')
+    result = (int64_t)*value - ratio;
+  *value = CLAMP(result, (int64_t)spec->min, (int64_t)spec->max);
+  return true;
+}
+
+static bool delta_command_set_layout(const struct CommandSpec *spec,
+                                     const struct Token *argument,
+                                     const struct LayoutParams *defaults,
+                                     struct CommandState *state,
+                                     const char **message) {
+  uint32_t style;
+  if (!delta_layout_find(argument->start, argument->length, &style)) {
+    // Layouts are only loaded once every command was applied
+    *message = state->plugin != NULL || state->program != NULL
+                   ? "Unknown layout, those loaded by load_layout and "
+                     "load_program can only be used by later commands"
+                   : "Unknown layout";
+    return false;
+  }
+  if (!delta_layout_allowed(state->styles, style)) {
+    *message = "Layout not allowed in this namespace";
+    return false;
+  }
+  state->params.layout_style = style;
+  return true;
+}
+
+static bool delta_command_reset(const struct CommandSpec *spec,
+                                const struct Token *argument,
+                                const struct LayoutParams *defaults,
+                                struct CommandState *state,
+                                const char **message) {
+  /* This is an example of a command that does something different
+   * than just modifying a value. It resets all values to their
+   * defaults.
+   */
+  state->params.main_count = defaults->main_count;
+  state->params.main_ratio = defaults->main_ratio;
+  state->params.view_padding = defaults->view_padding;
+  state->params.outer_padding = defaults->outer_padding;
+  return true;
+}
+
+static bool delta_command_swap_layout(const struct CommandSpec *spec,
+                                      const struct Token *argument,
+                                      const struct LayoutParams *defaults,
+                                      struct CommandState *state,
+                                      const char **message) {
+  if (state->cycle_length > 0) {
+    // Move to the layout after the current one, or start the cycle over
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < state->cycle_length; i++) {
+      if (state->cycle[i] == state->params.layout_style) {
+        next = (i + 1) % state->cycle_length;
+        break;
+      }
+    }
+    state->params.layout_style = state->cycle[next];
+    return true;
+  }
+
+  // Swap to next layout style allowed, staying if there is no other
+  uint32_t count = delta_layout_count();
+  for (uint32_t step = 1; step < count; step++) {
+    uint32_t style = (state->params.layout_style + step) % count;
+    if (delta_layout_allowed(state->styles, style)) {
+      state->params.layout_style = style;
+      break;
+    }
+  }
+  return true;
+}
+
+static bool delta_command_toggle_monocle(const struct CommandSpec *spec,
+                                         const struct Token *argument,
+                                         const struct LayoutParams *defaults,
+                                         struct CommandState *state,
+                                         const char **message) {
+  if (state->monocle_switch == MONOCLE) {
+    // Not currently in monocle style (as switch
+    // represents previous layout style)
+    if (!delta_layout_allowed(state->styles, MONOCLE)) {
+      *message = "Layout not allowed in this namespace";
+      return false;
+    }
+
+    // Set the previous style in order to recover it
+    state->monocle_switch = state->params.layout_style;
+    // Change the current view to monocle
+    state->params.layout_style = MONOCLE;
+  } else {
+    // Go back to the previous layout, which may have been chosen in another
+    // namespace
+    state->params.layout_style =
+        delta_layout_allowed(state->styles, state->monocle_switch)
+            ? state->monocle_switch
+            : defaults->layout_style;
+    // Set the switch to monocle so next time it will
+    // switch into monocle mode
+    state->monocle_switch = MONOCLE;
+  }
+  return true;
+}
+
+/**
+ * Take the path of a file to load once the commands are applied
+ *
+ * @param argument the path
+ * @param path set to the path
+ * @param length set to the length of the path
+ * @param message set to a description of the problem on error
+ * @return false if the path is not absolute, or a path was already taken
+ * */
+static bool delta_command_take_path(const struct Token *argument,
+                                    const char **path, size_t *length,
+                                    const char **message) {
+  // A relative path would depend on where delta was started, and a bare name
+  // would be looked up in the library path
+  if (argument->start[0] != '/') {
+    *message = "Path is not absolute";
+    return false;
+  }
+  if (*path != NULL) {
+    *message = "Only one file of each kind can be loaded at once";
+    return false;
+  }
+  *path = argument->start;
+  *length = argument->length;
+  return true;
+}
+
+static bool delta_command_load_layout(const struct CommandSpec *spec,
+                                      const struct Token *argument,
+                                      const struct LayoutParams *defaults,
+                                      struct CommandState *state,
+                                      const char **message) {
+  return delta_command_take_path(argument, &state->plugin,
+                                 &state->plugin_length, message);
+}
+
+static bool delta_command_load_program(const struct CommandSpec *spec,
+                                       const struct Token *argument,
+                                       const struct LayoutParams *defaults,
+                                       struct CommandState *state,
+                                       const char **message) {
+  return delta_command_take_path(argument, &state->program,
+                                 &state->program_length, message);
+}
+
+/**
+ * Run a single command
+ *
+ * @param tokens the first tokens of the command
+ * @param count number of tokens of the command, may be more than were kept
+ * @return false if the command is invalid, with error filled in
+ * */
+static bool delta_command_run(const struct Token *tokens, size_t count,
+                              const struct LayoutParams *defaults,
+                              struct CommandState *state,
+                              struct CommandError *error) {
+  // An empty command does nothing
+  if (count == 0)
+    return true;
+
+  const struct CommandSpec *spec = delta_command_lookup(&tokens[0]);
+  const struct Token *culprit = &tokens[0];
+  if (spec == NULL) {
+    error->message = "Unknown command";
+  } else if (count - 1 < spec->arity) {
+    error->message = "Too few arguments";
+  } else if (count - 1 > spec->arity) {
+    error->message = "Too many arguments";
+    culprit = &tokens[spec->arity + 1];
+  } else {
+    const struct Token *argument = spec->arity > 0 ? &tokens[1] : NULL;
+    if (spec->handler(spec, argument, defaults, state, &error->message))
+      return true;
+    // Commands without arguments can fail as well (toggle_monocle)
+    if (argument != NULL)
+      culprit = argument;
+  }
+  error->token = culprit->start;
+  error->token_length = culprit->length;
+  return false;
+}
+
+bool delta_command_apply(const char *command,
+                         const struct LayoutParams *defaults,
+                         struct CommandState *state,
+                         struct CommandError *error) {
+  struct CommandError ignored;
+  if (error == NULL)
+    error = &ignored;
+  error->index = 1;
+
+  // The commands work on a copy, which is only kept if all of them succeed
+  struct CommandState next = *state;
+  struct Token tokens[COMMAND_MAX_TOKENS];
+  size_t count = 0;
+  const char *c = command;
+  for (;;) {
+    while (is_space(*c))
+      c++;
+
+    if (*c == '\0' || *c == COMMAND_SEPARATOR) {
+      if (!delta_command_run(tokens, count, defaults, &next, error))
+        return false;
+      if (*c == '\0')
+        break;
+      c++;
+      error->index++;
+      count = 0;
+      continue;
+    }
+
+    const char *start = c;
+    while (*c != '\0' && *c != COMMAND_SEPARATOR && !is_space(*c))
+      c++;
+    if (count < COMMAND_MAX_TOKENS)
+      tokens[count] = (struct Token){.start = start, .length = c - start};
+    count++;
+  }
+
+  *state = next;
+  return true;
+}
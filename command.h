@@ -0,0 +1,103 @@
+/*
+ * Parsing and applying the user commands of delta
+ *
+ * A command string holds one or more commands separated by ';'. Every
+ * command is a name followed by its arguments, separated by whitespace. The
+ * string is tokenized in a single pass without copying or modifying it, and
+ * the commands are looked up by hash in a static table describing their
+ * arguments.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_COMMAND_H
+#define DELTA_COMMAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "layout.h"
+
+/* Separates the commands of a user_command sent as a batch */
+#define COMMAND_SEPARATOR ';'
+
+/* What the commands modify */
+struct CommandState {
+  struct LayoutParams params;
+  // Style to return to with toggle_monocle, MONOCLE if not in monocle
+  uint32_t monocle_switch;
+  // Layouts the commands may switch to, see delta_layout_allowed
+  uint64_t styles;
+  // Order swap_layout goes through them in (see struct LayoutCycle), NULL
+  // for the order of the registry
+  const uint8_t *cycle;
+  uint32_t cycle_length;
+  // Layout plugin to load once the commands are applied (load_layout), not
+  // terminated, NULL if none. Its layouts aren't known to set_layout until
+  // then, so a batch of commands can't pick a layout it loads itself.
+  const char *plugin;
+  size_t plugin_length;
+  // Layout program to load once the commands are applied (load_program), as
+  // above, with the same restriction
+  const char *program;
+  size_t program_length;
+};
+
+/* Why a command string was rejected */
+struct CommandError {
+  uint32_t index;      // Position of the failing command, starting at 1
+  const char *message; // Static description of the problem
+  const char *token;   // The offending part of the string, not terminated
+  size_t token_length;
+};
+
+/**
+ * Apply every command of a string, or none of them
+ *
+ * @param command the commands, separated by COMMAND_SEPARATOR
+ * @param defaults parameters restored by the reset command
+ * @param state modified only if every command is valid
+ * @param error filled in if a command is invalid, may be NULL
+ * @return false if a command is invalid
+ * */
+bool delta_command_apply(const char *command,
+                         const struct LayoutParams *defaults,
+                         struct CommandState *state,
+                         struct CommandError *error);
+
+/**
+ * Parse a whole value as an unsigned integer, like a command argument
+ *
+ * @param value digits only, not terminated
+ * @param length length of the value
+ * @param number set to the value
+ * @return false if it isn't a number or doesn't fit in a uint32_t
+ * */
+bool delta_command_number(const char *value, size_t length, uint32_t *number);
+
+/**
+ * Parse a whole value as a ratio, like a command argument
+ *
+ * @param value digits with at most one decimal point and six decimals, not
+ * terminated
+ * @param length length of the value
+ * @param ratio set to the value in fixed point (see LAYOUT_RATIO_ONE)
+ * @return false if it isn't a ratio
+ * */
+bool delta_command_ratio(const char *value, size_t length, uint32_t *ratio);
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ * Config file, reloaded whenever it changes
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "config.h"
+#include "layout.h"
+#include "loop.h"
+
+static char *config_path = NULL;
+static bool config_required; // Whether the file was given, or the default
+
+static int watch_fd = -1;
+static struct LoopSource *watch_source = NULL;
+static const char *watched_name; // Part of config_path after the last slash
+static ConfigCallback config_changed;
+
+static char *delta_config_default_path(void) {
+  const char *config_home = getenv("XDG_CONFIG_HOME");
+  const char *home = getenv("HOME");
+  const char *base, *suffix;
+  if (config_home != NULL && config_home[0] == '/') {
+    base = config_home;
+    suffix = "/delta/config";
+  } else if (home != NULL) {
+    base = home;
+    suffix = "/.config/delta/config";
+  } else {
+    return NULL;
+  }
+  char *path = malloc(strlen(base) + strlen(suffix) + 1);
+  if (path == NULL)
+    return NULL;
+  strcpy(path, base);
+  strcat(path, suffix);
+  return path;
+}
+
+/* Skip whitespace at both ends of a string, in place */
+static char *delta_config_trim(char *text) {
+  while (isspace((unsigned char)*text))
+    text++;
+  size_t length = strlen(text);
+  while (length > 0 && isspace((unsigned char)text[length - 1]))
+    text[--length] = '\0';
+  return text;
+}
+
+/* Parse a line of a section, returns an error message or NULL */
+static const char *delta_config_setting(const char *key, char *value,
+                                        struct ConfigSettings *settings) {
+  uint32_t number;
+  uint32_t style;
+  if (strcmp(key, "layout") == 0) {
+    if (!delta_layout_find(value, strlen(value), &style))
+      return "Unknown layout";
+    settings->params.layout_style = style;
+    settings->given |= CONFIG_LAYOUT;
+  } else if (strcmp(key, "layouts") == 0) {
+    settings->layouts = (struct LayoutCycle){0};
+    for (char *name = strtok(value, " \t"); name != NULL;
+         name = strtok(NULL, " \t")) {
+      if (!delta_layout_find(name, strlen(name), &style))
+        return "Unknown layout";
+      delta_layout_cycle_add(&settings->layouts, style);
+    }
+    if (settings->layouts.length == 0)
+      return "No layouts given";
+    settings->given |= CONFIG_LAYOUTS;
+  } else if (strcmp(key, "main-count") == 0) {
+    if (!delta_command_number(value, strlen(value), &number))
+      return "Invalid count";
+    settings->params.main_count = number;
+    settings->given |= CONFIG_MAIN_COUNT;
+  } else if (strcmp(key, "main-ratio") == 0) {
+    if (!delta_command_ratio(value, strlen(value), &number) ||
+        number > LAYOUT_RATIO_ONE)
+      return "Invalid ratio";
+    settings->params.main_ratio = number;
+    settings->given |= CONFIG_MAIN_RATIO;
+  } else if (strcmp(key, "view-padding") == 0) {
+    if (!delta_command_number(value, strlen(value), &number))
+      return "Invalid padding";
+    settings->params.view_padding = number;
+    settings->given |= CONFIG_VIEW_PADDING;
+  } else if (strcmp(key, "outer-padding") == 0) {
+    if (!delta_command_number(value, strlen(value), &number))
+      return "Invalid padding";
+    settings->params.outer_padding = number;
+    settings->given |= CONFIG_OUTER_PADDING;
+  } else {
+    return "Unknown setting";
+  }
+  return NULL;
+}
+
+/* Find the section of an output, adding it if needed, NULL if full */
+static struct ConfigSettings *delta_config_section(struct Config *config,
+                                                   const char *name) {
+  for (uint32_t i = 0; i < config->output_count; i++) {
+    if (strcmp(config->outputs[i].name, name) == 0)
+      return &config->outputs[i].settings;
+  }
+  if (config->output_count == CONFIG_MAX_OUTPUTS)
+    return NULL;
+  struct ConfigOutput *output = &config->outputs[config->output_count++];
+  *output = (struct ConfigOutput){0};
+  strcpy(output->name, name);
+  return &output->settings;
+}
+
+/* Parse a line, returns an error message or NULL */
+static const char *delta_config_line(char *line, struct Config *config,
+                                     struct ConfigSettings **section) {
+  char *comment = strchr(line, '#');
+  if (comment != NULL)
+    *comment = '\0';
+  line = delta_config_trim(line);
+  if (*line == '\0')
+    return NULL;
+
+  if (*line == '[') {
+    size_t length = strlen(line);
+    if (line[length - 1] != ']' || strncmp(line + 1, "output", 6) != 0 ||
+        !isspace((unsigned char)line[7]))
+      return "Invalid section, expected [output <name>]";
+    line[length - 1] = '\0';
+    char *name = delta_config_trim(line + 7);
+    if (*name == '\0' || strlen(name) >= CONFIG_NAME_LENGTH ||
+        strpbrk(name, " \t") != NULL)
+      return "Invalid output name";
+    *section = delta_config_section(config, name);
+    return *section != NULL ? NULL : "Too many outputs";
+  }
+
+  char *value = strchr(line, '=');
+  if (value == NULL)
+    return "Expected <setting> = <value>";
+  *value++ = '\0';
+  return delta_config_setting(delta_config_trim(line),
+                              delta_config_trim(value), *section);
+}
+
+/* Check that the layout of a section is among its layouts */
+static bool delta_config_check(const struct ConfigSettings *settings,
+                               const char *section) {
+  if ((settings->given & CONFIG_LAYOUT) == 0 ||
+      (settings->given & CONFIG_LAYOUTS) == 0 ||
+      delta_layout_allowed(settings->layouts.styles,
+                           settings->params.layout_style))
+    return true;
+  fprintf(stderr, "ERROR: %s: The layout of %s isn't among its layouts\n",
+          config_path, section);
+  return false;
+}
+
+/* Parse the config file into config, which is only modified if it is valid */
+static bool delta_config_parse(struct Config *config) {
+  FILE *file = fopen(config_path, "r");
+  if (file == NULL) {
+    if (errno == ENOENT && !config_required) {
+      *config = (struct Config){0};
+      return true;
+    }
+    fprintf(stderr, "ERROR: Could not read config file %s: %s\n", config_path,
+            strerror(errno));
+    return false;
+  }
+
+  struct Config *parsed = calloc(1, sizeof(struct Config));
+  if (parsed == NULL) {
+    fclose(file);
+    return false;
+  }
+  struct ConfigSettings *section = &parsed->defaults;
+  char *line = NULL;
+  size_t capacity = 0;
+  bool valid = true;
+  for (uint32_t number = 1; getline(&line, &capacity, file) != -1; number++) {
+    const char *error = delta_config_line(line, parsed, &section);
+    if (error != NULL) {
+      fprintf(stderr, "ERROR: %s:%u: %s\n", config_path, number, error);
+      valid = false;
+    }
+  }
+  free(line);
+  fclose(file);
+
+  valid = valid && delta_config_check(&parsed->defaults, "the defaults");
+  for (uint32_t i = 0; valid && i < parsed->output_count; i++)
+    valid = delta_config_check(&parsed->outputs[i].settings,
+                               parsed->outputs[i].name);
+  if (valid)
+    *config = *parsed;
+  free(parsed);
+  return valid;
+}
+
+bool delta_config_open(const char *path, struct Config *config) {
+  config_required = path != NULL;
+  config_path = path != NULL ? strdup(path) : delta_config_default_path();
+  if (config_path == NULL) {
+    *config = (struct Config){0};
+    return !config_required;
+  }
+  return delta_config_parse(config);
+}
+
+bool delta_config_reload(struct Config *config) {
+  // Without a config file there is nothing to reload
+  return config_path == NULL || delta_config_parse(config);
+}
+
+static void delta_config_handle_watch(void *data, uint32_t events) {
+  // Enough for a few events at once, the rest come with the next read
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+  ssize_t length;
+  while ((length = read(watch_fd, buffer, sizeof(buffer))) > 0) {
+    for (char *next = buffer; next < buffer + length;) {
+      const struct inotify_event *event = (const struct inotify_event *)next;
+      if (event->len > 0 && strcmp(event->name, watched_name) == 0)
+        changed = true;
+      next += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  if (changed)
+    config_changed();
+}
+
+bool delta_config_watch(ConfigCallback changed) {
+  if (config_path == NULL)
+    return true;
+  // Editors often write a new file and rename it over the old one, so the
+  // directory is watched rather than the file
+  char *slash = strrchr(config_path, '/');
+  watched_name = slash != NULL ? slash + 1 : config_path;
+  char *directory = slash == config_path ? strdup("/")
+                    : slash != NULL ? strndup(config_path, slash - config_path)
+                                    : strdup(".");
+  if (directory == NULL)
+    return false;
+
+  config_changed = changed;
+  watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  bool watched = watch_fd != -1 &&
+                 inotify_add_watch(watch_fd, directory,
+                                   IN_CLOSE_WRITE | IN_MOVED_TO) != -1;
+  // Without a config file, a missing directory just means there is nothing
+  // to watch
+  if (!watched && (config_required || errno != ENOENT)) {
+    fprintf(stderr, "ERROR: Could not watch %s: %s\n", directory,
+            strerror(errno));
+    free(directory);
+    return false;
+  }
+  free(directory);
+  if (watched) {
+    watch_source =
+        delta_loop_add_fd(watch_fd, EPOLLIN, delta_config_handle_watch, NULL);
+    if (watch_source == NULL) {
+      fputs("ERROR: Could not set up watching the config file\n", stderr);
+      return false;
+    }
+  }
+  return true;
+}
+
+void delta_config_close(void) {
+  delta_loop_remove(watch_source);
+  watch_source = NULL;
+  if (watch_fd != -1)
+    close(watch_fd);
+  watch_fd = -1;
+  free(config_path);
+  config_path = NULL;
+}
+
+void delta_config_apply(const struct ConfigSettings *settings,
+                        struct LayoutParams *params,
+                        struct LayoutCycle *layouts) {
+  if (settings->given & CONFIG_LAYOUT)
+    params->layout_style = settings->params.layout_style;
+  if (settings->given & CONFIG_LAYOUTS)
+    *layouts = settings->layouts;
+  if (settings->given & CONFIG_MAIN_COUNT)
+    params->main_count = settings->params.main_count;
+  if (settings->given & CONFIG_MAIN_RATIO)
+    params->main_ratio = settings->params.main_ratio;
+  if (settings->given & CONFIG_VIEW_PADDING)
+    params->view_padding = settings->params.view_padding;
+  if (settings->given & CONFIG_OUTER_PADDING)
+    params->outer_padding = settings->params.outer_padding;
+}
+
+const struct ConfigSettings *delta_config_output(const struct Config *config,
+                                                 const char *name) {
+  for (uint32_t i = 0; i < config->output_count; i++) {
+    if (strcmp(config->outputs[i].name, name) == 0)
+      return &config->outputs[i].settings;
+  }
+  return NULL;
+}
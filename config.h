@@ -0,0 +1,139 @@
+/*
+ * Config file, reloaded whenever it changes
+ *
+ * The config file ($XDG_CONFIG_HOME/delta/config, or ~/.config/delta/config
+ * by default) holds the defaults of every output, and settings for some
+ * outputs by name, one per line:
+ *
+ *   # Defaults of every output
+ *   main-ratio = 0.55
+ *   layouts = tile grid monocle
+ *
+ *   # Only DP-1, in every namespace
+ *   [output DP-1]
+ *   view-padding = 0
+ *
+ *   # Only DP-1, in the presenter namespace
+ *   [output DP-1@presenter]
+ *   layout = monocle
+ *
+ *   layout = <layout>       Layout of new outputs, and of reset
+ *   layouts = <layout> ...  Layouts commands may pick, swap_layout going
+ *                           through them in this order
+ *   main-count = <count>, main-ratio = <ratio>, view-padding = <padding>,
+ *   outer-padding = <padding>
+ *                           Parameters of new outputs, and of reset
+ *                           Counts and paddings are whole numbers, ratios
+ *                           go from 0 to 1 with at most six decimals
+ *
+ * Options given on the command line win over the defaults of the config
+ * file, the options of a namespace over both, and the sections of an output
+ * over everything. The file is parsed once into fixed size structs, and the
+ * directory holding it is watched with inotify, so edits are picked up while
+ * delta runs.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_CONFIG_H
+#define DELTA_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "layout.h"
+
+/* Most outputs with settings of their own */
+#define CONFIG_MAX_OUTPUTS 32
+
+/* Longest section name (<output> or <output>@<namespace>), including the
+ * terminator */
+#define CONFIG_NAME_LENGTH 96
+
+/* Settings given in a section */
+enum ConfigField {
+  CONFIG_LAYOUT = 1 << 0,
+  CONFIG_LAYOUTS = 1 << 1,
+  CONFIG_MAIN_COUNT = 1 << 2,
+  CONFIG_MAIN_RATIO = 1 << 3,
+  CONFIG_VIEW_PADDING = 1 << 4,
+  CONFIG_OUTER_PADDING = 1 << 5,
+};
+
+/* Settings of a section, only the fields given are used */
+struct ConfigSettings {
+  uint32_t given; // ConfigField flags
+  struct LayoutParams params;
+  struct LayoutCycle layouts;
+};
+
+struct ConfigOutput {
+  char name[CONFIG_NAME_LENGTH];
+  struct ConfigSettings settings;
+};
+
+struct Config {
+  struct ConfigSettings defaults;
+  struct ConfigOutput outputs[CONFIG_MAX_OUTPUTS];
+  uint32_t output_count;
+};
+
+/* Called from the event loop when the config file was written */
+typedef void (*ConfigCallback)(void);
+
+/**
+ * Find and parse the config file
+ *
+ * Layouts are looked up when parsing, so plugins and programs have to be
+ * loaded before.
+ *
+ * @param path the config file, NULL for the default one, which may not exist
+ * @param config filled in, empty without a file
+ * @return false if the file can't be read or is invalid, which is printed
+ * */
+bool delta_config_open(const char *path, struct Config *config);
+
+/**
+ * Parse the config file again
+ *
+ * @param config only modified if the file is valid
+ * @return false if the file can't be read or is invalid, which is printed,
+ * true without a config file
+ * */
+bool delta_config_reload(struct Config *config);
+
+/**
+ * Watch the config file for changes, in the event loop
+ *
+ * @param changed called after the file was written or replaced
+ * @return false on error, which is printed
+ * */
+bool delta_config_watch(ConfigCallback changed);
+
+/* Stop watching and forget the config file */
+void delta_config_close(void);
+
+/* Override parameters and layouts with the fields given in settings */
+void delta_config_apply(const struct ConfigSettings *settings,
+                        struct LayoutParams *params,
+                        struct LayoutCycle *layouts);
+
+/* The section of an output (<output> or <output>@<namespace>), NULL if there
+ * is none */
+const struct ConfigSettings *delta_config_output(const struct Config *config,
+                                                 const char *name);
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Local control socket, to query and change delta without the compositor
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "loop.h"
+
+struct ControlReply {
+  char *body;
+  size_t length;
+  size_t capacity;
+  bool failed;
+  bool out_of_memory;
+};
+
+struct ControlClient {
+  int fd; // -1 for an unused slot
+  struct LoopSource *source;
+  uint32_t events; // What the source currently waits for
+
+  char input[CONTROL_MAX_REQUEST]; // Start of the next request
+  size_t input_length;
+
+  // Responses not written yet, from output_start on. The buffer is kept
+  // when the client disconnects, for the next one in this slot.
+  char *output;
+  size_t output_start;
+  size_t output_length;
+  size_t output_capacity;
+
+  bool closing; // No more requests, closed once the responses are written
+};
+
+static int listen_fd = -1;
+static struct LoopSource *listen_source = NULL;
+static char *socket_path = NULL;
+static ControlHandler request_handler;
+static struct ControlClient clients[CONTROL_MAX_CLIENTS];
+
+/* Only one response is built at a time, so they all share this */
+static struct ControlReply reply;
+
+void delta_control_print(struct ControlReply *reply, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(reply->body + reply->length,
+                         reply->capacity - reply->length, format, args);
+  va_end(args);
+  if (length < 0)
+    return;
+  if (reply->length + length >= reply->capacity) {
+    size_t capacity = reply->capacity * 2 > reply->length + length + 1
+                          ? reply->capacity * 2
+                          : reply->length + length + 1;
+    char *body = realloc(reply->body, capacity);
+    if (body == NULL) {
+      reply->out_of_memory = true;
+      return;
+    }
+    reply->body = body;
+    reply->capacity = capacity;
+    va_start(args, format);
+    vsnprintf(reply->body + reply->length, reply->capacity - reply->length,
+              format, args);
+    va_end(args);
+  }
+  reply->length += length;
+}
+
+void delta_control_fail(struct ControlReply *reply) { reply->failed = true; }
+
+static void delta_control_disconnect(struct ControlClient *client) {
+  delta_loop_remove(client->source);
+  close(client->fd);
+  client->fd = -1;
+  client->source = NULL;
+}
+
+/* Queue bytes to send to a client, returns false if allocation failed */
+static bool delta_control_queue(struct ControlClient *client, const char *data,
+                                size_t length) {
+  if (client->output_start > 0) {
+    memmove(client->output, client->output + client->output_start,
+            client->output_length);
+    client->output_start = 0;
+  }
+  if (client->output_length + length > client->output_capacity) {
+    size_t capacity = client->output_capacity * 2;
+    if (capacity < client->output_length + length)
+      capacity = client->output_length + length;
+    char *output = realloc(client->output, capacity);
+    if (output == NULL)
+      return false;
+    client->output = output;
+    client->output_capacity = capacity;
+  }
+  memcpy(client->output + client->output_length, data, length);
+  client->output_length += length;
+  return true;
+}
+
+/* Handle a request and queue its response, returns false on error */
+static bool delta_control_respond(struct ControlClient *client,
+                                  const char *request) {
+  reply.length = 0;
+  reply.failed = false;
+  reply.out_of_memory = false;
+  if (reply.body == NULL) {
+    reply.body = malloc(256);
+    if (reply.body == NULL)
+      return false;
+    reply.capacity = 256;
+  }
+  request_handler(request, &reply);
+  if (reply.out_of_memory)
+    return false;
+
+  char header[32];
+  int header_length = snprintf(header, sizeof(header), "%s %zu\n",
+                               reply.failed ? "error" : "ok", reply.length);
+  return delta_control_queue(client, header, header_length) &&
+         delta_control_queue(client, reply.body, reply.length);
+}
+
+/* Handle every complete request received, returns false on error */
+static bool delta_control_handle_requests(struct ControlClient *client) {
+  char *start = client->input;
+  char *end = client->input + client->input_length;
+  char *newline;
+  while ((newline = memchr(start, '\n', end - start)) != NULL) {
+    *newline = '\0';
+    if (newline > start && newline[-1] == '\r')
+      newline[-1] = '\0';
+    if (!delta_control_respond(client, start))
+      return false;
+    start = newline + 1;
+  }
+  client->input_length = end - start;
+  memmove(client->input, start, client->input_length);
+
+  if (client->input_length == CONTROL_MAX_REQUEST) {
+    static const char too_long[] = "error 17\nRequest too long\n";
+    client->closing = true;
+    return delta_control_queue(client, too_long, sizeof(too_long) - 1);
+  }
+  return true;
+}
+
+/* Write as much of the responses as the socket takes, false on error */
+static bool delta_control_flush(struct ControlClient *client) {
+  while (client->output_length > 0) {
+    ssize_t written =
+        send(client->fd, client->output + client->output_start,
+             client->output_length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    client->output_start += written;
+    client->output_length -= written;
+  }
+  client->output_start = 0;
+  return true;
+}
+
+/* Read and handle requests while there are no responses left to write */
+static bool delta_control_read(struct ControlClient *client) {
+  while (!client->closing && client->output_length == 0) {
+    ssize_t count = read(client->fd, client->input + client->input_length,
+                         CONTROL_MAX_REQUEST - client->input_length);
+    if (count == 0) {
+      // The client sent everything, it may still wait for the responses
+      client->closing = true;
+    } else if (count == -1) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    } else {
+      client->input_length += count;
+      if (!delta_control_handle_requests(client) ||
+          !delta_control_flush(client))
+        return false;
+    }
+  }
+  return true;
+}
+
+static void delta_control_handle_client(void *data, uint32_t events) {
+  struct ControlClient *client = data;
+  // Once the responses are written, the client may have sent more requests
+  if ((events & (EPOLLERR | EPOLLHUP)) ||
+      ((events & EPOLLOUT) && !delta_control_flush(client)) ||
+      !delta_control_read(client) ||
+      (client->closing && client->output_length == 0)) {
+    delta_control_disconnect(client);
+    return;
+  }
+  uint32_t wanted = client->output_length > 0 ? EPOLLOUT : EPOLLIN;
+  if (wanted != client->events) {
+    if (!delta_loop_update_fd(client->source, wanted)) {
+      delta_control_disconnect(client);
+      return;
+    }
+    client->events = wanted;
+  }
+}
+
+static void delta_control_accept(void *data, uint32_t events) {
+  for (;;) {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+
+    struct ControlClient *client = NULL;
+    for (uint32_t i = 0; i < CONTROL_MAX_CLIENTS && client == NULL; i++) {
+      if (clients[i].fd == -1)
+        client = &clients[i];
+    }
+    if (client == NULL) {
+      static const char busy[] = "error 17\nToo many clients\n";
+      send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+      close(fd);
+      continue;
+    }
+
+    client->fd = fd;
+    client->events = EPOLLIN;
+    client->input_length = 0;
+    client->output_start = 0;
+    client->output_length = 0;
+    client->closing = false;
+    client->source = delta_loop_add_fd(fd, EPOLLIN,
+                                       delta_control_handle_client, client);
+    if (client->source == NULL) {
+      close(fd);
+      client->fd = -1;
+    }
+  }
+}
+
+/* Whether something is listening on a socket */
+static bool delta_control_in_use(const struct sockaddr_un *address) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return false;
+  bool in_use =
+      connect(fd, (const struct sockaddr *)address, sizeof(*address)) == 0;
+  close(fd);
+  return in_use;
+}
+
+/* Bind the listening socket, which only the user of delta may connect to */
+static int delta_control_bind(const struct sockaddr_un *address) {
+  // The socket is created with the permissions left by the umask, so it is
+  // narrowed around bind, rather than changed after others could connect
+  mode_t umask_before = umask(0177);
+  int result =
+      bind(listen_fd, (const struct sockaddr *)address, sizeof(*address));
+  int bind_errno = errno;
+  umask(umask_before);
+  errno = bind_errno;
+  return result;
+}
+
+bool delta_control_open(const char *path, ControlHandler handler) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "ERROR: Control socket path too long: %s\n", path);
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  for (uint32_t i = 0; i < CONTROL_MAX_CLIENTS; i++)
+    clients[i].fd = -1;
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1) {
+    fprintf(stderr, "ERROR: Could not create control socket: %s\n",
+            strerror(errno));
+    return false;
+  }
+
+  int result = delta_control_bind(&address);
+  if (result == -1 && errno == EADDRINUSE) {
+    if (delta_control_in_use(&address)) {
+      fprintf(stderr, "ERROR: Control socket %s is used by another process\n",
+              path);
+      delta_control_close();
+      return false;
+    }
+    // Left behind by a delta that is gone
+    unlink(path);
+    result = delta_control_bind(&address);
+  }
+  if (result == -1 || listen(listen_fd, CONTROL_MAX_CLIENTS) == -1) {
+    fprintf(stderr, "ERROR: Could not listen on control socket %s: %s\n",
+            path, strerror(errno));
+    delta_control_close();
+    return false;
+  }
+  // Only remove the socket once it is ours
+  socket_path = strdup(path);
+
+  request_handler = handler;
+  listen_source =
+      delta_loop_add_fd(listen_fd, EPOLLIN, delta_control_accept, NULL);
+  if (socket_path == NULL || listen_source == NULL) {
+    fputs("ERROR: Could not set up the control socket\n", stderr);
+    delta_control_close();
+    return false;
+  }
+  return true;
+}
+
+void delta_control_close(void) {
+  if (listen_fd == -1)
+    return;
+  for (uint32_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+    if (clients[i].fd != -1)
+      delta_control_disconnect(&clients[i]);
+    free(clients[i].output);
+    clients[i].output = NULL;
+    clients[i].output_capacity = 0;
+  }
+  delta_loop_remove(listen_source);
+  listen_source = NULL;
+  if (listen_fd != -1)
+    close(listen_fd);
+  listen_fd = -1;
+  if (socket_path != NULL)
+    unlink(socket_path);
+  free(socket_path);
+  socket_path = NULL;
+  free(reply.body);
+  reply.body = NULL;
+  reply.capacity = 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Local control socket, to query and change delta without the compositor
+ *
+ * Clients connect to a Unix domain stream socket and send requests, one per
+ * line. Every request gets exactly one response, in order:
+ *
+ *   ok <length>\n<length bytes of body>
+ *   error <length>\n<length bytes of body>
+ *
+ * so that a client always knows where a response ends, even when the body
+ * spans several lines (each of them ending with a newline). The requests
+ * themselves are handled by delta.c.
+ *
+ * Everything is non-blocking and served from the event loop. A client is
+ * only read from once all of its responses have been written, so one that
+ * doesn't read its responses just stops being served, and can never hold up
+ * layout demands.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_CONTROL_H
+#define DELTA_CONTROL_H
+
+#include <stdbool.h>
+
+/* Longest request, including the newline */
+#define CONTROL_MAX_REQUEST 4096
+
+/* Most clients connected at once, others are turned away */
+#define CONTROL_MAX_CLIENTS 16
+
+/* Response being built by a request handler */
+struct ControlReply;
+
+/**
+ * Handle a request
+ *
+ * @param request the request, without the newline
+ * @param reply where the response is written, with delta_control_print and
+ * delta_control_fail
+ * */
+typedef void (*ControlHandler)(const char *request, struct ControlReply *reply);
+
+/**
+ * Listen on a socket, served by the event loop
+ *
+ * A socket file left behind by a delta that is gone is replaced. The socket
+ * is created with mode 0600, so only the user running delta can connect.
+ *
+ * @param path path of the socket
+ * @param handler called for every request
+ * @return false on error, which is printed
+ * */
+bool delta_control_open(const char *path, ControlHandler handler);
+
+/* Disconnect every client and remove the socket */
+void delta_control_close(void);
+
+/* Append to the body of a response, like printf */
+void delta_control_print(struct ControlReply *reply, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Turn a response into an error, the body says why */
+void delta_control_fail(struct ControlReply *reply);
+
+#endif
@@ -22,59 +22,143 @@
  */
 #include <assert.h>
 #include <ctype.h>
-#include <math.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <wayland-client-protocol.h>
 #include <wayland-client.h>
 
+#include "cache.h"
+#include "command.h"
+#include "config.h"
+#include "control.h"
+#include "emit.h"
+#include "geometry.h"
+#include "histogram.h"
+#include "layout.h"
+#include "loop.h"
+#include "namespace.h"
+#include "plugin.h"
+#include "pool.h"
+#include "probe.h"
+#include "program.h"
 #include "river-layout-v3.h"
+#include "startup.h"
+#include "state.h"
+#include "trace.h"
 
 /* A few macros to indulge the inner glibc user. */
 #define MIN(a, b) (a < b ? a : b)
 #define MAX(a, b) (a > b ? a : b)
 #define CLAMP(a, b, c) (MIN(MAX(b, c), MAX(MIN(b, c), a)))
 
-/* Define number of views */
-#define LAYOUT_STYLE_COUNT 7
-
-/* Create an enum to describe the layout state */
-enum LayoutStyle {
-  TILE,        // Normal Tiled Layout
-  SPIRAL,      // Fibonacci Spiral
-  DIMINISHING, // Dimminishing Spiral
-  COLUMN,      // Equal sized columns
-  STACK,       // Equal sized rows
-  GRID,        // Equal sized rows and columns
-  MONOCLE,     // Single large window
+uint32_t delta_monocle_switch = TILE;
+
+/* Likely next layouts of an output, precomputed while the loop is idle */
+enum Speculation {
+  SPECULATE_MORE_VIEWS = 1 << 0,  // A view is opened
+  SPECULATE_FEWER_VIEWS = 1 << 1, // A view is closed
+  SPECULATE_SWAP = 1 << 2,        // swap_layout
+  SPECULATE_MONOCLE = 1 << 3,     // toggle_monocle
 };
 
-enum LayoutStyle delta_monocle_switch = TILE;
+#define SPECULATE_ALL                                                          \
+  (SPECULATE_MORE_VIEWS | SPECULATE_FEWER_VIEWS | SPECULATE_SWAP |             \
+   SPECULATE_MONOCLE)
+
+/* Layouts of this many views or more aren't precomputed, since the event loop
+ * waits for each one that is */
+#define SPECULATION_MAX_VIEWS 1024
+
+/* Layouts are only computed on the worker pool once the batch of demands
+ * answered at once has this many views in total. Handing out a batch costs
+ * about 6 us (make bench-batches), which the built-in layouts spend on about
+ * 2000 (spiral) to 8000 (tile) views, smaller batches are done before the
+ * workers would even have woken up. */
+#define LAYOUT_BATCH_MIN_VIEWS 4096
+
+/* Worker threads started by default, at most one less than the CPUs */
+#define DEFAULT_WORKERS 3
+
+/* Latest layout demand of an output that hasn't been answered yet */
+struct PendingDemand {
+  uint32_t view_count;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tags;
+  uint32_t serial;
+  uint64_t received_ns; // When it arrived, for the latency histograms
+  bool pending;
+};
 
-struct Output {
-  struct wl_list link;
+/* Longest output name remembered, including the terminator */
+#define OUTPUT_NAME_LENGTH 64
 
+/* Outputs that went away whose parameters are kept, in case they return */
+#define RETIRED_OUTPUT_COUNT 8
+
+struct Output {
   struct wl_output *output;
   struct river_layout_v3 *layout;
 
-  uint32_t main_count;
-  double main_ratio;
-  uint32_t view_padding;
-  uint32_t outer_padding;
-  enum LayoutStyle layout_style;
+  uint32_t id;          // Identifies the output in traces
+  uint32_t global_name; // Name of the wl_output global in the registry
+  uint32_t namespace;   // Index in namespaces of the layout
+  char name[OUTPUT_NAME_LENGTH]; // e.g. DP-1, empty until the compositor says
+  uint64_t retired_at;           // Value of retire_clock when it went away
+
+  // Parameters for each tag, a layout uses those of its lowest focused tag
+  struct LayoutParams tag_params[TAG_COUNT];
+  // Parameters of new tags and of reset, and the layouts commands may pick,
+  // from the namespace and the config file
+  struct LayoutParams defaults;
+  struct LayoutCycle layouts;
+  uint32_t command_tags; // Tags the next user command applies to
+  bool per_tag;          // Whether the compositor sends user_command_tags
+
+  struct StateSlot *state; // Where the parameters are saved, may be NULL
+
+  struct LayoutCache cache;
+  // Latest layout sent, the precomputed ones are near it
+  struct LayoutCacheKey speculation;
+  uint32_t speculation_pending; // Speculation flags of those left to compute
+
+  struct PendingDemand demand;
+  struct Histogram latency; // From layout demands to their commit, in ns
 
   bool configured;
 };
 
-// Global variables for the parameters that can be passed in as arguments
-uint32_t global_main_count = 1;
-double global_main_ratio = 0.5;
-uint32_t global_view_padding = 5;
-uint32_t global_outer_padding = 5;
+/* Parameters used when neither the arguments nor the config file give them */
+const struct LayoutParams builtin_defaults = {
+    .layout_style = TILE,
+    .main_count = 1,
+    .main_ratio = LAYOUT_RATIO_ONE / 2,
+    .view_padding = 5,
+    .outer_padding = 5,
+};
+
+// Parameters passed in as arguments, they win over those of the config file
+struct ConfigSettings argument_settings = {0};
+
+struct Config config;
+
+/* Namespaces the layouts are served in, every output has a layout in each */
+struct Namespace namespaces[NAMESPACE_MAX_COUNT];
+uint32_t namespace_count = 0;
+
+/* The namespaces as given, parsed again whenever the config file changes */
+const char *namespace_specs[NAMESPACE_MAX_COUNT] = {DEFAULT_NAMESPACE};
+uint32_t namespace_spec_count = 0;
 
 /* In Wayland it's a good idea to have your main data global, since you'll need
  * it everywhere anyway.
@@ -82,484 +166,516 @@ uint32_t global_outer_padding = 5;
 struct wl_display *wl_display;
 struct wl_registry *wl_registry;
 struct wl_callback *sync_callback;
+struct wl_callback *ready_callback;
 struct river_layout_manager_v3 *layout_manager;
-struct wl_list outputs;
+
+/* Every Output record, kept in one array so going through them is a linear
+ * scan: first the outputs in use, then the retired ones, which went away but
+ * keep their parameters, then free ones. Records are never freed, and keep
+ * their cache buffers when reused. Moving a record to another index updates
+ * the user data of its Wayland objects, so listeners always get the current
+ * address.
+ */
+struct Output *outputs = NULL;
+uint32_t output_count = 0;   // Outputs in use
+uint32_t retired_count = 0;  // Retired outputs, following those in use
+uint32_t output_capacity = 0;
+uint64_t retire_clock = 0;
 bool loop = true;
 int ret = EXIT_FAILURE;
 
+/* Trace of received events, only recorded when requested */
+struct TraceWriter trace_writer;
+uint32_t next_output_id = 0;
+
+/* Recorded traces are written out at least this often */
+#define TRACE_FLUSH_INTERVAL_NS 1000000000ull
+
+/* Sources of the event loop */
+struct LoopSource *wayland_source;
+struct LoopSource *trace_flush_timer;
+bool wayland_reading = false;       // Whether a read of events is prepared
+bool wayland_write_blocked = false; // Whether the socket buffer is full
+
+/* Path of the control socket, NULL for none */
+const char *control_path = NULL;
+
+/* Where the events recorded by the probes are written, NULL to not record */
+const char *probe_path = NULL;
+
+/* Whether layouts are encoded and written to the socket at once, see emit.h */
+bool batch_emit = false;
+
+/* Whether likely next layouts are precomputed while idle */
+bool speculate = true;
+bool speculation_pending = false; // Whether an output has some left
+
+/* Layout plugins and programs to load, queued by load_layout and
+ * load_program. Loading one (dlopen resolving every symbol, or reading and
+ * compiling a program) can take a while, so it is left until the demands
+ * waiting have been answered, instead of being done while handling the
+ * command. */
+#define LOAD_QUEUE_SIZE 8
+struct PendingLoad {
+  char path[PATH_MAX];
+  bool program; // Whether it is a program rather than a plugin
+};
+struct PendingLoad pending_loads[LOAD_QUEUE_SIZE];
+uint32_t pending_load_count = 0;
+
+/* Number of layout demands that were superseded before being answered */
+uint64_t coalesced_demands = 0;
+
+/* Demands are counted in buckets of view counts: 0, 1, 2-3, 4-7, ... */
+#define VIEW_COUNT_BUCKETS 16
+
+/* Latency of answering layout demands, by layout style and view count (those
+ * of each output are kept with it) */
+struct Histogram style_latency[LAYOUT_MAX_COUNT];
+struct Histogram view_count_latency[VIEW_COUNT_BUCKETS];
+
+/* A layout computed on the worker pool */
+struct LayoutJob {
+  struct Output *output;
+  struct LayoutCacheEntry *entry;
+  bool computed;
+};
+
+/* Layouts of the current batch for the worker pool, only ever grows */
+struct LayoutJob *layout_jobs = NULL;
+uint32_t layout_job_capacity = 0;
+
 /**
- * Handle a layout request for a Tiled layout
+ * Compute the layout of a claimed entry
  *
- * The tiled layout has a set of main windows (laid out in a stack),
- * and another column (also laid out in a stack)
+ * This only touches the entry, so the layouts of different outputs can be
+ * computed on different threads.
  *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
+ * @return false if allocation failed
  * */
-static void delta_handle_layout_demand_tile(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial) {
-  /* Simple tiled layout with no frills.*/
-
-  // Start by calculating the width and the height after accounting for the
-  // padding
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  unsigned int main_size, // Size (width) of the main column
-      stack_size,         // Size (width) of the stack
-      view_x,             // x-coord OFFSET of the view (from the left)
-      view_y,             // y-coord OFFSET of the view (from the top)
-      view_width,         // Width of the view
-      view_height;        // Height of the view
-  // If the number of views to be put in the main column is 0, set
-  // the main size to 0 and the stack size to the full width
-  if (output->main_count == 0) {
-    main_size = 0;
-    stack_size = width;
-  } else if (view_count <= output->main_count) {
-    /* If all of the views are to be assigned to the main stack, set the
-     * main size to be the full width, and the stack size to 0 */
-    main_size = width;
-    stack_size = 0;
-  } else {
-    /* Otherwise, set the main size to the the width multiplied by the
-     * main ratio, and the stacksize to be the remainder of the usable area*/
-    main_size = width * output->main_ratio;
-    stack_size = width - main_size;
-  }
-  // Iterate through each view, starting from the top of the stack
-  // NOTE: The view/inner padding is handled in the push view dimensions call
-  // below
-  for (unsigned int i = 0; i < view_count; i++) {
-    if (i < output->main_count) {
-      // The main area
-      view_x = 0;             // The offset for the main area is 0
-      view_width = main_size; // The width of the main area is the main_size
-      view_height =
-          height /
-          MIN(output->main_count,
-              view_count); // The height is divided equally among all main views
-      view_y = i * view_height; // Offset is the number of views above this one
-                                // multiplied by their height
-    } else {
-      // Stack area
-      view_x =
-          main_size; // This area starts after the full width of the main area
-      view_width = stack_size; // The width is the previously calculated width
-                               // of the stack size
-      view_height =
-          height /
-          (view_count -
-           output->main_count); // Height is divided equally among views
-      view_y = (i - output->main_count) *
-               view_height; // View offset calculated from number of views
-                            // above, and their heights
-    }
+static bool delta_layout_cache_compute(struct LayoutCacheEntry *entry) {
+  const struct LayoutCacheKey *key = &entry->key;
+  DELTA_PROBE(compute, begin, key->view_count, key->params.layout_style, 0);
+  bool computed = delta_layout_compute(&key->params, key->view_count,
+                                       key->width, key->height, &entry->views);
+  DELTA_PROBE(compute, end, key->view_count, key->params.layout_style, 0);
+  return computed;
+}
+
+static void delta_handle_layout_demand(void *data,
+                                       struct river_layout_v3 *river_layout_v3,
+                                       uint32_t view_count, uint32_t width,
+                                       uint32_t height, uint32_t tags,
+                                       uint32_t serial) {
+  struct Output *output = (struct Output *)data;
+  DELTA_PROBE(demand, mark, output->id, view_count, serial);
+  delta_trace_write_demand(&trace_writer, output->id, view_count, width, height,
+                           tags, serial);
 
-    // Submit the dimensions to the view
-    river_layout_v3_push_view_dimensions(
-        output->layout, // This is just passed in from the data
-        view_x + output->view_padding +
-            output
-                ->outer_padding, // The x-coord is the offset from above, plus
-                                 // the view padding. This is added to the
-                                 // outer_padding to get the actual x-coordinate
-        view_y + output->view_padding +
-            output->outer_padding, // Same as the x-coord
-        view_width -
-            (2 * output->view_padding), // Width, accounting for desired padding
-        view_height - (2 * output->view_padding),
-        serial); // Height, accounting for desired padding
-  }
-  // Commit the layout (finalize the layout which was set for the various views)
-  river_layout_v3_commit(output->layout, "[]=", serial);
+  /* Only remember the demand for now. The compositor ignores responses to all
+   * but its most recent layout demand, so if another one for this output is
+   * among the events still queued, this one is never answered at all.
+   */
+  if (output->demand.pending)
+    coalesced_demands++;
+  output->demand = (struct PendingDemand){
+      .view_count = view_count,
+      .width = width,
+      .height = height,
+      .tags = tags,
+      .serial = serial,
+      .received_ns = delta_trace_now_ns(),
+      .pending = true,
+  };
 }
 
-/**
- * Handle a layout request for a spiral layout
- *
- * This layout halves the size of the of each view, alternating
- * between width and height
- *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
- * @param diminish whether the spiral should be diminishing (goes to the right
- * bottom corner)
- * */
-static void delta_handle_layout_demand_spiral(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial, bool diminish) {
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  printf("Usable width is: %d", width);
-  printf("Usable height is: %d", height);
-  unsigned int view_x, view_y, view_width, view_height;
-  view_x = 0;
-  view_y = 0;
-  // View width starts as full width
-  view_width = width;
-  // Same with height
-  view_height = height;
-  for (unsigned int i = 0; i < view_count; i++) {
-    if (i == view_count - 1) {
-      // For the last view, just take the full width/height
-      river_layout_v3_push_view_dimensions(
-          output->layout, view_x + output->view_padding + output->outer_padding,
-          view_y + output->view_padding + output->outer_padding,
-          view_width - (2 * output->view_padding),
-          view_height - (2 * output->view_padding), serial);
-    } else {
+/* Bucket of a view count in view_count_latency */
+static uint32_t delta_view_count_bucket(uint32_t view_count) {
+  if (view_count == 0)
+    return 0;
+  return MIN(32 - __builtin_clz(view_count), VIEW_COUNT_BUCKETS - 1);
+}
 
-      if (i % 2 == 0) {
-        // If i is even, the width will be split
-        view_width /= 2;
-        if ((i % 4 == 2) && !diminish) {
-          // View is on the right side
-          river_layout_v3_push_view_dimensions(
-              output->layout,
-              view_x + output->view_padding + output->outer_padding +
-                  view_width,
-              view_y + output->view_padding + output->outer_padding,
-              view_width - (2 * output->view_padding),
-              view_height - (2 * output->view_padding), serial);
-        } else {
-          // View is on the left side
-          river_layout_v3_push_view_dimensions(
-              output->layout,
-              view_x + output->view_padding + output->outer_padding,
-              view_y + output->view_padding + output->outer_padding,
-              view_width - (2 * output->view_padding),
-              view_height - (2 * output->view_padding), serial);
-          view_x += view_width;
-        }
-      } else {
-        // If i is odd, the height will be split
-        view_height /= 2;
-        if ((i % 4 == 3) && !diminish) {
-          // View is on the up side
-          river_layout_v3_push_view_dimensions(
-              output->layout,
-              view_x + output->view_padding + output->outer_padding,
-              view_y + output->view_padding + output->outer_padding +
-                  view_height,
-              view_width - (2 * output->view_padding),
-              view_height - (2 * output->view_padding), serial);
-        } else {
-          // View is on the down side
-          river_layout_v3_push_view_dimensions(
-              output->layout,
-              view_x + output->view_padding + output->outer_padding,
-              view_y + output->view_padding + output->outer_padding,
-              view_width - (2 * output->view_padding),
-              view_height - (2 * output->view_padding), serial);
-          view_y += view_height;
-        }
-      }
-    }
-  }
-  if (diminish) {
-    river_layout_v3_commit(output->layout, "↘", serial);
-  } else {
-    river_layout_v3_commit(output->layout, "꩜", serial);
+/* Record how long answering the latest demand of an output took */
+static void delta_record_latency(struct Output *output, uint32_t style) {
+  const struct PendingDemand *demand = &output->demand;
+  uint64_t latency = delta_trace_now_ns() - demand->received_ns;
+  delta_histogram_record(&output->latency, latency);
+  delta_histogram_record(&style_latency[style], latency);
+  delta_histogram_record(
+      &view_count_latency[delta_view_count_bucket(demand->view_count)],
+      latency);
+}
+
+/* Index of the parameters used for a set of tags */
+static uint32_t delta_tag_index(uint32_t tags) {
+  return tags == 0 ? 0 : (uint32_t)__builtin_ctz(tags);
+}
+
+/* Precompute the likely next layouts of an output, once the loop is idle */
+static void delta_speculation_start(struct Output *output,
+                                    const struct LayoutCacheKey *key) {
+  if (!speculate || key->view_count >= SPECULATION_MAX_VIEWS) {
+    output->speculation_pending = 0;
+    return;
   }
+  output->speculation = *key;
+  output->speculation_pending = SPECULATE_ALL;
+  speculation_pending = true;
 }
 
 /**
- * Handle a layout request for a column layout
- *
- * This layout is just equal sized columns for each view
+ * Work out a likely next layout of an output
  *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
+ * @param output the output
+ * @param speculation which one
+ * @param key filled in with the layout
+ * @return false if there is no such layout
  * */
-static void delta_handle_layout_demand_column(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial) {
-  // Find the usable width and height accounting for padding
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  unsigned int view_x,  // x-coord offset
-      view_outer_width, // Total width of view (including padding)
-      view_inner_width; // width of view (without padding)
-  view_outer_width = width / view_count;
-  view_inner_width = view_outer_width - (2 * output->view_padding);
-  for (unsigned int i = 0; i < view_count; i++) {
-    view_x = i * view_outer_width;
-    river_layout_v3_push_view_dimensions(
-        output->layout,
-        view_x + output->view_padding + output->outer_padding, // x-coord
-        output->outer_padding + output->view_padding,          // y-coord
-        view_inner_width, // Width of view (after padding accounted for)
-        height - (2 * output->view_padding), // Full usable height
-        serial);
-  }
-  river_layout_v3_commit(output->layout, "|||", serial);
+static bool delta_speculation_key(const struct Output *output,
+                                  enum Speculation speculation,
+                                  struct LayoutCacheKey *key) {
+  *key = output->speculation;
+  if (speculation == SPECULATE_MORE_VIEWS) {
+    key->view_count++;
+    return true;
+  }
+  if (speculation == SPECULATE_FEWER_VIEWS) {
+    if (key->view_count == 0)
+      return false;
+    key->view_count--;
+    return true;
+  }
+  // Applied to a copy, the output and delta_monocle_switch are left alone
+  struct CommandState state = {
+      .params = key->params,
+      .monocle_switch = delta_monocle_switch,
+      .styles = output->layouts.styles,
+      .cycle = output->layouts.order,
+      .cycle_length = output->layouts.length,
+  };
+  const char *command =
+      speculation == SPECULATE_SWAP ? "swap_layout" : "toggle_monocle";
+  if (!delta_command_apply(command, &output->defaults, &state, NULL))
+    return false;
+  key->params = state.params;
+  return true;
 }
 
 /**
- * Handle a layout request for a stacked layout
+ * Precompute one likely next layout, while nothing else is going on
  *
- * This layout is just a single stack across the entire usable width
+ * The layout goes in the cache of its output, so a demand for it is answered
+ * without computing anything. It only ever replaces other precomputed
+ * layouts, never demanded ones, see cache.h.
  *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
+ * @return whether there may be more left
  * */
-static void delta_handle_layout_demand_stack(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial) {
-  // Start by calculating the available width and height after accocunting
-  // for the outer padding
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  unsigned int view_y,   // y-coord offset
-      view_outer_height, // Total height of view (including padding)
-      view_inner_height; // Height of view (without padding)
-  view_outer_height = height / view_count;
-  view_inner_height = view_outer_height - (2 * output->view_padding);
-  // Iterate through all of the views, starting from the top of the stack
-  for (unsigned int i = 0; i < view_count; i++) {
-    view_y = i * view_outer_height;
-    river_layout_v3_push_view_dimensions(
-        output->layout,
-        output->outer_padding +
-            output->view_padding, // View x-coord is just the outer_padding
-        view_y + output->view_padding +
-            output->outer_padding, // View y-coord accounting for padding
-        width - (2 * output->view_padding), // Just full usable width
-        view_inner_height, // Height of the view (accounting for padding )
-        serial);
-  }
-  river_layout_v3_commit(output->layout, "=", serial);
+static bool delta_speculate(void) {
+  for (uint32_t i = 0; i < output_count; i++) {
+    struct Output *output = &outputs[i];
+    while (output->speculation_pending != 0) {
+      uint32_t speculation =
+          output->speculation_pending & -output->speculation_pending;
+      output->speculation_pending &= ~speculation;
+      struct LayoutCacheKey key;
+      if (!delta_speculation_key(output, speculation, &key) ||
+          delta_layout_cache_contains(&output->cache, &key))
+        continue;
+      struct LayoutCacheEntry *entry =
+          delta_layout_cache_claim(&output->cache, &key, true);
+      // Without memory for it, the entry just stays empty
+      if (!delta_layout_cache_compute(entry))
+        continue;
+      delta_layout_cache_insert(&output->cache, entry);
+      output->cache.speculated++;
+      return true;
+    }
+  }
+  return false;
 }
 
 /**
- * Handle a layout request for a grid layout
+ * Start answering the latest demand of an output
  *
- * This layout is a grid of views, with an equal number of rows and columns
+ * A layout found in the cache is sent right away.
  *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
+ * @param output the output
+ * @return the cache entry to compute the layout into, then passed to
+ * delta_finish_answer, or NULL if the demand was answered from the cache
  * */
-static void delta_handle_layout_demand_grid(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial) {
-  // Start by calculating the available width and height after accocunting
-  // for the outer padding
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  // Also calculate the number of rows/cols
-  uint32_t grid_size = floor(sqrt(view_count));
-  if (grid_size * grid_size < view_count) {
-    grid_size++;
-  }
-  unsigned int view_x,   // x-coord offset
-      view_y,            // y-coord offset
-      view_outer_height, // height of view (including view padding)
-      view_inner_height, // Height of view (without padding)
-      view_outer_width,  // width of view (including view padding)
-      view_inner_width,  // width of view (without padding)
-      row,               // Row of the view
-      col;               // Column of the view
-  view_outer_height = height / grid_size; // Equally divide the height into rows
-  view_outer_width = width / grid_size; // Equally divide the width into columns
-  view_inner_height = view_outer_height - (2 * output->view_padding);
-  view_inner_width = view_outer_width - (2 * output->view_padding);
-  // Iterate through all of the views, starting from the top of the stack
-  // In row major order
-  for (unsigned int i = 0; i < view_count; i++) {
-    // Find the row
-    row = i / grid_size;
-    col = i % grid_size;
-    view_x = col * view_outer_width;
-    view_y = row * view_outer_height;
-    river_layout_v3_push_view_dimensions(
-        output->layout,
-        view_x + output->view_padding + output->outer_padding, // View x-coord
-        view_y + output->view_padding + output->outer_padding, // View y-coord
-        view_inner_width,  // Just full usable width
-        view_inner_height, // Height of the view (accounting for padding )
-        serial);
-  }
-  river_layout_v3_commit(output->layout, "#", serial);
+static struct LayoutCacheEntry *delta_start_answer(struct Output *output) {
+  struct PendingDemand *demand = &output->demand;
+  demand->pending = false;
+
+  // Answer from the cache if this exact layout was computed before, otherwise
+  // compute it, remembering the result for next time
+  struct LayoutCacheKey key = {
+      .params = output->tag_params[delta_tag_index(demand->tags)],
+      .view_count = demand->view_count,
+      .width = demand->width,
+      .height = demand->height,
+  };
+  struct LayoutCacheEntry *entry =
+      delta_layout_cache_lookup(&output->cache, &key);
+  if (entry == NULL)
+    return delta_layout_cache_claim(&output->cache, &key, false);
+
+  // There is no layout object when replaying a trace
+  if (output->layout != NULL) {
+    delta_emit_layout(output->layout, &entry->views,
+                      delta_layout_name(key.params.layout_style),
+                      demand->serial);
+    delta_startup_record(STARTUP_FIRST_COMMIT, output->id);
+  }
+  delta_record_latency(output, key.params.layout_style);
+  delta_speculation_start(output, &key);
+  return NULL;
 }
 
-/**
- * Handle a layout request for a monocle layout
- *
- * This layout is a single large window
- *
- * @param view_count number of views in the layout
- * @param width width of the usable area
- * @param height height of the usable area
- * @param tags tags of teh output, 32-bit bitfield
- * @param serial serial of the layout demand
- * */
-static void delta_handle_layout_demand_monocle(
-    struct Output *output, struct river_layout_v3 *river_layout_v3,
-    uint32_t view_count, uint32_t width, uint32_t height, uint32_t tags,
-    uint32_t serial) {
-  // Start by calculating the available width and height after accocunting
-  // for the outer padding
-  width -= 2 * output->outer_padding, height -= 2 * output->outer_padding;
-  for (unsigned int i = 0; i < view_count; i++) {
-    river_layout_v3_push_view_dimensions(
-        output->layout,
-        output->outer_padding + output->view_padding, // View x-coord
-        output->outer_padding + output->view_padding, // View y-coord
-        width - (2 * output->view_padding),           // Full width
-        height - (2 * output->view_padding),          // Full height
-        serial);
-  }
-  river_layout_v3_commit(output->layout, "🔍", serial);
+/* Send the layout computed for the latest demand of an output */
+static void delta_finish_answer(struct Output *output,
+                                struct LayoutCacheEntry *entry,
+                                bool computed) {
+  if (!computed) {
+    fputs("Failed to allocate.\n", stderr);
+    loop = false;
+    return;
+  }
+  delta_layout_cache_insert(&output->cache, entry);
+  if (output->layout != NULL) {
+    delta_emit_layout(output->layout, &entry->views,
+                      delta_layout_name(entry->key.params.layout_style),
+                      output->demand.serial);
+    delta_startup_record(STARTUP_FIRST_COMMIT, output->id);
+  }
+  delta_record_latency(output, entry->key.params.layout_style);
+  delta_speculation_start(output, &entry->key);
 }
 
-static void delta_handle_layout_demand(void *data,
-                                       struct river_layout_v3 *river_layout_v3,
-                                       uint32_t view_count, uint32_t width,
-                                       uint32_t height, uint32_t tags,
-                                       uint32_t serial) {
-  struct Output *output = (struct Output *)data;
-  switch (output->layout_style) {
-  case TILE:
-    delta_handle_layout_demand_tile(output, river_layout_v3, view_count, width,
-                                    height, tags, serial);
-    break;
-  case SPIRAL:
-    delta_handle_layout_demand_spiral(output, river_layout_v3, view_count,
-                                      width, height, tags, serial, false);
-    break;
-  case DIMINISHING:
-    delta_handle_layout_demand_spiral(output, river_layout_v3, view_count,
-                                      width, height, tags, serial, true);
-    break;
-  case COLUMN:
-    delta_handle_layout_demand_column(output, river_layout_v3, view_count,
-                                      width, height, tags, serial);
-    break;
-  case STACK:
-    delta_handle_layout_demand_stack(output, river_layout_v3, view_count, width,
-                                     height, tags, serial);
-    break;
-  case GRID:
-    delta_handle_layout_demand_grid(output, river_layout_v3, view_count, width,
-                                    height, tags, serial);
-    break;
-  case MONOCLE:
-    delta_handle_layout_demand_monocle(output, river_layout_v3, view_count,
-                                       width, height, tags, serial);
-    break;
+/* Compute and send the layout for the latest demand of an output */
+static void delta_answer_layout_demand(struct Output *output) {
+  struct LayoutCacheEntry *entry = delta_start_answer(output);
+  if (entry != NULL)
+    delta_finish_answer(output, entry, delta_layout_cache_compute(entry));
+}
+
+static bool delta_layout_jobs_reserve(uint32_t capacity) {
+  if (layout_job_capacity >= capacity)
+    return true;
+  uint32_t new_capacity = MAX(layout_job_capacity * 2, capacity);
+  struct LayoutJob *jobs =
+      realloc(layout_jobs, new_capacity * sizeof(struct LayoutJob));
+  if (jobs == NULL)
+    return false;
+  layout_jobs = jobs;
+  layout_job_capacity = new_capacity;
+  return true;
+}
+
+/* Runs on any thread of the pool */
+static void delta_run_layout_job(void *data, uint32_t index) {
+  struct LayoutJob *job = &layout_jobs[index];
+  job->computed = delta_layout_cache_compute(job->entry);
+}
+
+/* Runs on the Wayland thread, as soon as the job is done */
+static void delta_finish_layout_job(void *data, uint32_t index) {
+  struct LayoutJob *job = &layout_jobs[index];
+  delta_finish_answer(job->output, job->entry, job->computed);
+}
+
+/* Answer the layout demands left after dispatching all queued events
+ *
+ * Layouts that aren't cached are computed in parallel on the worker pool,
+ * if there are enough views in total, so that answering every output takes
+ * about as long as its slowest layout.
+ */
+static void delta_answer_layout_demands(void) {
+  // Layouts found in the cache are sent right away, the others are collected
+  // into a batch
+  uint32_t job_count = 0;
+  uint64_t batch_views = 0;
+  for (uint32_t i = 0; i < output_count; i++) {
+    struct Output *output = &outputs[i];
+    if (!output->demand.pending)
+      continue;
+    struct LayoutCacheEntry *entry = delta_start_answer(output);
+    if (entry == NULL)
+      continue;
+    if (!delta_layout_jobs_reserve(job_count + 1)) {
+      delta_finish_answer(output, entry, delta_layout_cache_compute(entry));
+      continue;
+    }
+    layout_jobs[job_count++] = (struct LayoutJob){
+        .output = output,
+        .entry = entry,
+    };
+    batch_views += entry->key.view_count;
+  }
+
+  if (job_count < 2 || batch_views < LAYOUT_BATCH_MIN_VIEWS ||
+      !delta_pool_run(job_count, delta_run_layout_job, delta_finish_layout_job,
+                      NULL)) {
+    // Too little work to hand out, or it couldn't be, do it here
+    for (uint32_t i = 0; i < job_count; i++) {
+      delta_run_layout_job(NULL, i);
+      delta_finish_layout_job(NULL, i);
+    }
   }
 }
 
+static void destroy_output(struct Output *output);
+
 static void
 delta_handle_namespace_in_use(void *data,
                               struct river_layout_v3 *river_layout_v3) {
   /* Oh no, the namespace we choose is already used by another client!
-   * All we can do now is destroy the river_layout object. Because we are
-   * lazy, we just abort and let our cleanup mechanism destroy it. A more
-   * sophisticated client could instead destroy only the one single
-   * affected river_layout object and recover from this mishap. Writing
-   * such a client is left as an exercise for the reader.
+   * All we can do now is destroy the river_layout object. The other layouts
+   * of the namespace get this as well, so they are all dropped at once, and
+   * the namespace isn't asked for on new outputs. The other namespaces carry
+   * on, unless there are none left.
    */
-  fputs("Namespace already in use.\n", stderr);
-  loop = false;
+  struct Output *output = (struct Output *)data;
+  uint32_t namespace = output->namespace;
+  fprintf(stderr, "Namespace %s already in use.\n", namespaces[namespace].name);
+  namespaces[namespace].in_use = true;
+  for (uint32_t i = 0; i < output_count;) {
+    // This moves another output to i
+    if (outputs[i].namespace == namespace)
+      destroy_output(&outputs[i]);
+    else
+      i++;
+  }
+
+  bool all_in_use = true;
+  for (uint32_t i = 0; i < namespace_count; i++)
+    all_in_use = all_in_use && namespaces[i].in_use;
+  // Only stop here, a stop asked for before this is kept
+  if (all_in_use)
+    loop = false;
 }
 
-static bool skip_whitespace(char **ptr) {
-  if (*ptr == NULL)
-    return false;
-  while (isspace(**ptr)) {
-    (*ptr)++;
-    if (**ptr == '\0')
-      return false;
+static bool word_comp(const char *word, const char *comp) {
+  if (strncmp(word, comp, strlen(comp)) == 0) {
+    const char *after_comp = word + strlen(comp);
+    if (isspace(*after_comp) || *after_comp == '\0')
+      return true;
   }
-  return true;
+  return false;
 }
 
-static bool skip_nonwhitespace(char **ptr) {
-  if (*ptr == NULL)
+/**
+ * Copy the path taken from a command, which isn't terminated
+ *
+ * @param path buffer of PATH_MAX bytes receiving the path
+ * @param start the path in the command
+ * @param length length of the path
+ * @return false if the path is too long, which is printed
+ * */
+static bool delta_copy_path(char *path, const char *start, size_t length) {
+  if (length >= PATH_MAX) {
+    fprintf(stderr, "ERROR: Path too long: '%.*s'\n", (int)length, start);
     return false;
-  while (!isspace(**ptr)) {
-    (*ptr)++;
-    if (**ptr == '\0')
-      return false;
   }
+  memcpy(path, start, length);
+  path[length] = '\0';
   return true;
 }
 
-static const char *get_second_word(char **ptr, const char *name) {
-  /* Skip to the next word. */
-  if (!skip_nonwhitespace(ptr) || !skip_whitespace(ptr)) {
-    fprintf(stderr, "ERROR: Too few arguments. '%s' needs one argument.\n",
-            name);
-    return NULL;
+/**
+ * Queue a plugin or program to load, see pending_loads
+ *
+ * @param start the path in the command, not terminated
+ * @param length length of the path
+ * @param program whether it is a program rather than a plugin
+ * */
+static void delta_queue_load(const char *start, size_t length, bool program) {
+  if (pending_load_count == LOAD_QUEUE_SIZE) {
+    fprintf(stderr, "ERROR: Too many layouts waiting to be loaded: '%.*s'\n",
+            (int)length, start);
+    return;
   }
-
-  /* Now we know where the second word begins. */
-  const char *second_word = *ptr;
-
-  /* Check if there is a third word. */
-  if (skip_nonwhitespace(ptr) && skip_whitespace(ptr)) {
-    fprintf(stderr, "ERROR: Too many arguments. '%s' needs one argument.\n",
-            name);
-    return NULL;
+  struct PendingLoad *load = &pending_loads[pending_load_count];
+  if (delta_copy_path(load->path, start, length)) {
+    load->program = program;
+    pending_load_count++;
   }
-
-  return second_word;
 }
 
-static void handle_uint32_command(char **ptr, uint32_t *value,
-                                  const char *name) {
-  const char *second_word = get_second_word(ptr, name);
-  if (second_word == NULL)
-    return;
-  const int32_t arg = atoi(second_word);
-  if (*second_word == '+' || *second_word == '-')
-    *value = (uint32_t)MAX((int32_t)*value + arg, 0);
-  else
-    *value = (uint32_t)MAX(arg, 0);
+/* Load the plugins and programs queued by commands, in order */
+static void delta_load_pending(void) {
+  for (uint32_t i = 0; i < pending_load_count; i++) {
+    if (pending_loads[i].program)
+      delta_program_load(pending_loads[i].path);
+    else
+      delta_plugin_load(pending_loads[i].path);
+  }
+  pending_load_count = 0;
 }
 
-static void handle_float_command(char **ptr, double *value, const char *name,
-                                 double clamp_upper, double clamp_lower) {
-  const char *second_word = get_second_word(ptr, name);
-  if (second_word == NULL)
-    return;
-  const double arg = atof(second_word);
-  if (*second_word == '+' || *second_word == '-')
-    *value = CLAMP(*value + arg, clamp_upper, clamp_lower);
-  else
-    *value = CLAMP(arg, clamp_upper, clamp_lower);
-}
+/**
+ * Apply commands to the parameters of an output
+ *
+ * @param output the output
+ * @param tags tags whose parameters change, all of them if the compositor
+ * doesn't say which tags commands are for
+ * @param command the commands, separated by COMMAND_SEPARATOR
+ * @param loads_allowed whether load_layout and load_program may be used
+ * @param error filled in if a command is invalid
+ * @return false if a command is invalid, none of them are applied then
+ * */
+static bool delta_apply_commands(struct Output *output, uint32_t tags,
+                                 const char *command, bool loads_allowed,
+                                 struct CommandError *error) {
+  struct LayoutParams *params = &output->tag_params[delta_tag_index(tags)];
+  struct CommandState state = {
+      .params = *params,
+      .monocle_switch = delta_monocle_switch,
+      .styles = output->layouts.styles,
+      .cycle = output->layouts.order,
+      .cycle_length = output->layouts.length,
+  };
+  DELTA_PROBE(command, begin, output->id, tags, 0);
+  bool applied = delta_command_apply(command, &output->defaults, &state, error);
+  DELTA_PROBE(command, end, output->id, tags, 0);
+  if (!applied)
+    return false;
+  if (!loads_allowed && (state.plugin != NULL || state.program != NULL)) {
+    *error = (struct CommandError){
+        .index = 0,
+        .message = "Layouts can't be loaded from here",
+        .token = state.plugin != NULL ? state.plugin : state.program,
+        .token_length = state.plugin != NULL ? state.plugin_length
+                                             : state.program_length,
+    };
+    return false;
+  }
 
-static bool word_comp(const char *word, const char *comp) {
-  if (strncmp(word, comp, strlen(comp)) == 0) {
-    const char *after_comp = word + strlen(comp);
-    if (isspace(*after_comp) || *after_comp == '\0')
-      return true;
+  delta_monocle_switch = state.monocle_switch;
+  if (state.plugin != NULL)
+    delta_queue_load(state.plugin, state.plugin_length, false);
+  if (state.program != NULL)
+    delta_queue_load(state.program, state.program_length, true);
+  if (delta_layout_params_equal(&state.params, params))
+    return true;
+
+  // The layouts cached for this output are kept, they are looked up by their
+  // parameters, so toggling back and forth is answered from the cache
+  if (output->per_tag) {
+    *params = state.params;
+  } else {
+    for (uint32_t tag = 0; tag < TAG_COUNT; tag++)
+      output->tag_params[tag] = state.params;
   }
-  return false;
+  delta_state_save(output->state, output->tag_params);
+  return true;
 }
 
 static void
 delta_handle_user_command(void *data,
                           struct river_layout_v3 *river_layout_manager_v3,
-                          const char *_command) {
+                          const char *command) {
   /* The user_command event will be received whenever the user decided to
    * send us a command. As an example, commands can be used to change the
    * layout values. Parsing the commands is the job of the layout
@@ -567,94 +683,229 @@ delta_handle_user_command(void *data,
    *
    * After this event is recevied, the views on the output will be
    * re-arranged and so we will also receive a layout_demand event.
+   *
+   * Several commands can be sent at once, separated by ';'. They are applied
+   * together, so they only cost a single relayout, and only if every one of
+   * them is valid.
+   *
+   * Commands change the parameters of the tags announced just before by
+   * user_command_tags. Compositors only implementing version 1 don't say,
+   * so then commands change the parameters of all tags.
    */
 
   struct Output *output = (struct Output *)data;
+  delta_trace_write_command(&trace_writer, output->id, command);
+  struct CommandError error;
+  if (!delta_apply_commands(output, output->command_tags, command, true,
+                            &error)) {
+    fprintf(stderr, "ERROR: %s: '%.*s'\n", error.message,
+            (int)error.token_length, error.token);
+    if (strchr(command, COMMAND_SEPARATOR) != NULL)
+      fprintf(stderr,
+              "ERROR: Command %u of '%s' failed, none of them were applied.\n",
+              error.index, command);
+  }
+}
+
+static void delta_handle_user_command_tags(void *data,
+                                           struct river_layout_v3 *layout,
+                                           uint32_t tags) {
+  /* Since version 2 this is sent right before every user_command, with the
+   * tags focused on the output when the user sent it.
+   */
+  struct Output *output = (struct Output *)data;
+  delta_trace_write_command_tags(&trace_writer, output->id, tags);
+  output->command_tags = tags;
+  output->per_tag = true;
+}
+
+static const struct river_layout_v3_listener layout_listener = {
+    .namespace_in_use = delta_handle_namespace_in_use,
+    .layout_demand = delta_handle_layout_demand,
+    .user_command = delta_handle_user_command,
+    .user_command_tags = delta_handle_user_command_tags,
+};
+
+/* Point the Wayland objects of an output in use at its record again */
+static void delta_output_attach(struct Output *output) {
+  if (output->output != NULL)
+    wl_output_set_user_data(output->output, output);
+  if (output->layout != NULL)
+    river_layout_v3_set_user_data(output->layout, output);
+}
 
-  /* Skip preceding whitespace. */
-  char *command = (char *)_command;
-  if (!skip_whitespace(&command))
+/* Exchange two records, keeping the Wayland objects of both pointed at them */
+static void delta_output_swap(uint32_t a, uint32_t b) {
+  if (a == b)
     return;
+  struct Output record = outputs[a];
+  outputs[a] = outputs[b];
+  outputs[b] = record;
+  delta_output_attach(&outputs[a]);
+  delta_output_attach(&outputs[b]);
+}
 
-  if (word_comp(command, "main_count"))
-    handle_uint32_command(&command, &output->main_count, "main_count");
-  else if (word_comp(command, "view_padding"))
-    handle_uint32_command(&command, &output->view_padding, "view_padding");
-  else if (word_comp(command, "outer_padding"))
-    handle_uint32_command(&command, &output->outer_padding, "outer_padding");
-  else if (word_comp(command, "main_ratio"))
-    handle_float_command(&command, &output->main_ratio, "main_ratio", 0.1, 0.9);
-  else if (word_comp(command, "reset")) {
-    /* This is an example of a command that does something different
-     * than just modifying a value. It resets all values to their
-     * defaults.
-     */
+/* Make sure there is a free record, returns false if allocation failed */
+static bool delta_output_reserve(void) {
+  uint32_t used = output_count + retired_count;
+  if (used < output_capacity)
+    return true;
+  uint32_t capacity = MAX(output_capacity * 2, 4);
+  struct Output *records = realloc(outputs, capacity * sizeof(struct Output));
+  if (records == NULL)
+    return false;
+  memset(&records[output_capacity], 0,
+         (capacity - output_capacity) * sizeof(struct Output));
+  outputs = records;
+  output_capacity = capacity;
+  for (uint32_t i = 0; i < output_count; i++)
+    delta_output_attach(&outputs[i]);
+  return true;
+}
 
-    if (skip_nonwhitespace(&command) && skip_whitespace(&command)) {
-      fputs("ERROR: Too many arguments. 'reset' has no arguments.\n", stderr);
-      return;
-    }
+/* Turn the retired record at an index into a free one */
+static void delta_output_free_retired(uint32_t index) {
+  outputs[index].name[0] = '\0';
+  delta_output_swap(index, output_count + retired_count - 1);
+  retired_count--;
+}
 
-    output->main_count = global_main_count;
-    output->main_ratio = global_main_ratio;
-    output->view_padding = global_view_padding;
-    output->outer_padding = global_outer_padding;
-  } else if (word_comp(command, "swap_layout")) {
-    // Check that no additional argument was passed
-    if (skip_nonwhitespace(&command) && skip_whitespace(&command)) {
-      fputs("ERROR: Too many arguments. 'swap' has no arguments.\n", stderr);
-      return;
-    }
+/**
+ * Take the parameters (and cached layouts) of a retired record with the same
+ * name as an output, which then becomes free
+ *
+ * @return false if there is no such record
+ * */
+static bool delta_adopt_retired_output(struct Output *output) {
+  for (uint32_t i = output_count; i < output_count + retired_count; i++) {
+    struct Output *retired = &outputs[i];
+    if (retired->namespace != output->namespace ||
+        strcmp(retired->name, output->name) != 0)
+      continue;
+    memcpy(output->tag_params, retired->tag_params,
+           sizeof(output->tag_params));
+    output->per_tag = retired->per_tag;
+    // The layouts are of the same output, so they are still valid
+    struct LayoutCache cache = output->cache;
+    output->cache = retired->cache;
+    retired->cache = cache;
+    delta_output_free_retired(i);
+    return true;
+  }
+  return false;
+}
 
-    // Swap to next layout style
-    output->layout_style = (output->layout_style + 1) % LAYOUT_STYLE_COUNT;
+/**
+ * Work out the defaults and layouts of an output, from its namespace and the
+ * sections of the config file for it
+ *
+ * Parameters that were left at the previous defaults move to the new ones,
+ * those changed by commands are kept. Layouts that aren't allowed anymore
+ * are replaced by the default one.
+ *
+ * @return whether the settings of the output changed
+ * */
+static bool delta_output_update_settings(struct Output *output) {
+  const struct Namespace *namespace = &namespaces[output->namespace];
+  struct LayoutParams defaults = namespace->defaults;
+  struct LayoutCycle layouts = namespace->layouts;
+  if (output->name[0] != '\0') {
+    // The section of the output in every namespace, then that of this one
+    char key[OUTPUT_NAME_LENGTH + NAMESPACE_NAME_LENGTH];
+    const struct ConfigSettings *settings =
+        delta_config_output(&config, output->name);
+    if (settings != NULL)
+      delta_config_apply(settings, &defaults, &layouts);
+    snprintf(key, sizeof(key), "%s@%s", output->name, namespace->name);
+    settings = delta_config_output(&config, key);
+    if (settings != NULL)
+      delta_config_apply(settings, &defaults, &layouts);
+  }
+  if (!delta_layout_allowed(layouts.styles, defaults.layout_style))
+    defaults.layout_style = layouts.order[0];
 
-  } else if (word_comp(command, "set_layout")) {
-    const char *new_layout = get_second_word(&command, "set_layout");
-    if (new_layout == NULL)
-      return;
-    if (word_comp(new_layout, "tile")) {
-      output->layout_style = TILE;
-    } else if (word_comp(new_layout, "spiral")) {
-      output->layout_style = SPIRAL;
-    } else if (word_comp(new_layout, "diminishing")) {
-      output->layout_style = DIMINISHING;
-    } else if (word_comp(new_layout, "column")) {
-      output->layout_style = COLUMN;
-    } else if (word_comp(new_layout, "stack")) {
-      output->layout_style = STACK;
-    } else if (word_comp(new_layout, "grid")) {
-      output->layout_style = GRID;
-    } else if (word_comp(new_layout, "monocle")) {
-      output->layout_style = MONOCLE;
-    } else {
-      fprintf(stderr, "ERROR: unknown layout: %s\n", new_layout);
-    }
-  } else if (word_comp(command, "toggle_monocle")) {
-    if (delta_monocle_switch == MONOCLE) {
-      // Not currently in monocle style (as switch
-      // represents previous layout style)
-
-      // Set the previous style in order to recover it
-      delta_monocle_switch = output->layout_style;
-      // Change the current view to monocle
-      output->layout_style = MONOCLE;
-    } else {
-      // Go back to the previous layout
-      output->layout_style = delta_monocle_switch;
-      // Set the switch to monocle so next time it will
-      // switch into monocle mode
-      delta_monocle_switch = MONOCLE;
-    }
+  if (delta_layout_params_equal(&defaults, &output->defaults) &&
+      delta_layout_cycle_equal(&layouts, &output->layouts))
+    return false;
+  const struct LayoutParams *old = &output->defaults;
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++) {
+    struct LayoutParams *params = &output->tag_params[tag];
+    if (params->layout_style == old->layout_style ||
+        !delta_layout_allowed(layouts.styles, params->layout_style))
+      params->layout_style = defaults.layout_style;
+    if (params->main_count == old->main_count)
+      params->main_count = defaults.main_count;
+    if (params->main_ratio == old->main_ratio)
+      params->main_ratio = defaults.main_ratio;
+    if (params->view_padding == old->view_padding)
+      params->view_padding = defaults.view_padding;
+    if (params->outer_padding == old->outer_padding)
+      params->outer_padding = defaults.outer_padding;
+  }
+  output->defaults = defaults;
+  output->layouts = layouts;
+  delta_state_save(output->state, output->tag_params);
+  return true;
+}
+
+static void output_handle_geometry(void *data, struct wl_output *wl_output,
+                                   int32_t x, int32_t y, int32_t width,
+                                   int32_t height, int32_t subpixel,
+                                   const char *make, const char *model,
+                                   int32_t transform) {}
 
-  } else
-    fprintf(stderr, "ERROR: Unknown command: %s\n", command);
+static void output_handle_mode(void *data, struct wl_output *wl_output,
+                               uint32_t flags, int32_t width, int32_t height,
+                               int32_t refresh) {}
+
+static void output_handle_done(void *data, struct wl_output *wl_output) {}
+
+static void output_handle_scale(void *data, struct wl_output *wl_output,
+                                int32_t factor) {}
+
+static void output_handle_name(void *data, struct wl_output *wl_output,
+                               const char *name) {
+  /* The name is sent right after binding the output, so it always arrives
+   * before the first layout_demand, and the saved parameters are in place
+   * for the very first layout.
+   */
+  struct Output *output = (struct Output *)data;
+  const struct Namespace *namespace = &namespaces[output->namespace];
+  strncpy(output->name, name, OUTPUT_NAME_LENGTH - 1);
+  delta_output_update_settings(output);
+
+  // Layouts in other namespaces than the default one are saved as
+  // <output>@<namespace>
+  char key[OUTPUT_NAME_LENGTH + NAMESPACE_NAME_LENGTH];
+  if (strcmp(namespace->name, DEFAULT_NAMESPACE) == 0)
+    snprintf(key, sizeof(key), "%s", output->name);
+  else
+    snprintf(key, sizeof(key), "%s@%s", output->name, namespace->name);
+  output->state = delta_state_slot(key);
+
+  // An output that comes back takes its parameters and layouts over from
+  // its retired record, the state file only has them when it is kept
+  if (delta_adopt_retired_output(output) ||
+      !delta_state_load(output->state, output->tag_params))
+    return;
+  // The allowed layouts may have changed since they were saved
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++) {
+    if (!delta_layout_allowed(output->layouts.styles,
+                              output->tag_params[tag].layout_style))
+      output->tag_params[tag].layout_style = output->defaults.layout_style;
+  }
 }
 
-static const struct river_layout_v3_listener layout_listener = {
-    .namespace_in_use = delta_handle_namespace_in_use,
-    .layout_demand = delta_handle_layout_demand,
-    .user_command = delta_handle_user_command,
+static void output_handle_description(void *data, struct wl_output *wl_output,
+                                      const char *description) {}
+
+static const struct wl_output_listener output_listener = {
+    .geometry = output_handle_geometry,
+    .mode = output_handle_mode,
+    .done = output_handle_done,
+    .scale = output_handle_scale,
+    .name = output_handle_name,
+    .description = output_handle_description,
 };
 
 static void configure_output(struct Output *output) {
@@ -662,23 +913,41 @@ static void configure_output(struct Output *output) {
 
   /* The namespace of the layout is how the compositor chooses what layout
    * to use. It can be any arbitrary string. It should describe roughly
-   * what kind of layout your client will create, so here we use "swapable".
+   * what kind of layout your client will create, so by default we use
+   * "swapable".
    */
   output->layout = river_layout_manager_v3_get_layout(
-      layout_manager, output->output, "swapable");
+      layout_manager, output->output, namespaces[output->namespace].name);
   river_layout_v3_add_listener(output->layout, &layout_listener, output);
+  delta_startup_record(STARTUP_CONFIGURE, output->id);
 }
 
-static bool create_output(struct wl_output *wl_output) {
-  struct Output *output = calloc(1, sizeof(struct Output));
-  if (output == NULL) {
+static struct Output *create_output(struct wl_output *wl_output,
+                                    uint32_t global_name, uint32_t namespace) {
+  if (!delta_output_reserve()) {
     fputs("Failed to allocate.\n", stderr);
-    return false;
+    return NULL;
   }
 
-  output->output = wl_output;
-  output->layout = NULL;
-  output->configured = false;
+  // The first free record goes right after the outputs in use, the retired
+  // record there moves to the end instead
+  delta_output_swap(output_count, output_count + retired_count);
+  struct Output *output = &outputs[output_count++];
+
+  // The cache buffers of the record are kept, and counted in the statistics
+  struct LayoutCache cache = output->cache;
+  delta_layout_cache_clear(&cache);
+  *output = (struct Output){
+      .output = wl_output,
+      .layout = NULL,
+      .id = next_output_id++,
+      .global_name = global_name,
+      .namespace = namespace,
+      .defaults = namespaces[namespace].defaults,
+      .layouts = namespaces[namespace].layouts,
+      .cache = cache,
+      .configured = false,
+  };
 
   /* These are the parameters of our layout. In this case, they are the
    * ones you'd typically expect from a dynamic tiling layout, but if you
@@ -691,10 +960,12 @@ static bool create_output(struct wl_output *wl_output) {
    * layout values. The server only sends user_command events when there
    * actually is a command the user wants to send us.
    */
-  output->main_count = global_main_count;
-  output->main_ratio = global_main_ratio;
-  output->view_padding = global_view_padding;
-  output->outer_padding = global_outer_padding;
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++)
+    output->tag_params[tag] = output->defaults;
+
+  // Outputs are only named since version 4, older ones aren't saved
+  if (wl_output != NULL && wl_output_get_version(wl_output) >= 4)
+    wl_output_add_listener(wl_output, &output_listener, output);
 
   /* If we already have the river_layout_manager, we can get a
    * river_layout object for this output.
@@ -702,50 +973,121 @@ static bool create_output(struct wl_output *wl_output) {
   if (layout_manager != NULL)
     configure_output(output);
 
-  wl_list_insert(&outputs, &output->link);
-  return true;
+  return output;
 }
 
+/**
+ * Stop using an output that went away
+ *
+ * Its record is retired if the output had a name, so that its parameters are
+ * taken over if it comes back, and only the oldest retired records are freed.
+ * This moves other records, so pointers to outputs must not be kept.
+ * */
 static void destroy_output(struct Output *output) {
   if (output->layout != NULL)
     river_layout_v3_destroy(output->layout);
-  wl_output_destroy(output->output);
-  wl_list_remove(&output->link);
-  free(output);
+  if (output->output != NULL)
+    wl_output_destroy(output->output);
+  output->layout = NULL;
+  output->output = NULL;
+  output->demand.pending = false;
+  output->retired_at = ++retire_clock;
+
+  uint32_t index = output - outputs;
+  delta_output_swap(index, --output_count);
+  retired_count++;
+  if (outputs[output_count].name[0] == '\0') {
+    delta_output_free_retired(output_count);
+  } else if (retired_count > RETIRED_OUTPUT_COUNT) {
+    uint32_t oldest = output_count;
+    for (uint32_t i = output_count; i < output_count + retired_count; i++) {
+      if (outputs[i].retired_at < outputs[oldest].retired_at)
+        oldest = i;
+    }
+    delta_output_free_retired(oldest);
+  }
 }
 
 static void destroy_all_outputs() {
-  struct Output *output, *tmp;
-  wl_list_for_each_safe(output, tmp, &outputs, link) destroy_output(output);
+  while (output_count > 0)
+    destroy_output(&outputs[output_count - 1]);
+  for (uint32_t i = 0; i < output_capacity; i++)
+    delta_layout_cache_free(&outputs[i].cache);
+  free(outputs);
+  outputs = NULL;
+  retired_count = 0;
+  output_capacity = 0;
 }
 
 static void registry_handle_global(void *data, struct wl_registry *registry,
                                    uint32_t name, const char *interface,
                                    uint32_t version) {
+  /* Version 2 adds user_command_tags, which is needed to keep the parameters
+   * of every tag separately.
+   */
   if (strcmp(interface, river_layout_manager_v3_interface.name) == 0)
-    layout_manager =
-        wl_registry_bind(registry, name, &river_layout_manager_v3_interface, 1);
+    layout_manager = wl_registry_bind(registry, name,
+                                      &river_layout_manager_v3_interface,
+                                      MIN(version, 2));
   else if (strcmp(interface, wl_output_interface.name) == 0) {
-    struct wl_output *wl_output =
-        wl_registry_bind(registry, name, &wl_output_interface, version);
-    if (!create_output(wl_output)) {
-      loop = false;
-      ret = EXIT_FAILURE;
+    /* The output is bound once for each namespace, so that every layout has
+     * an Output record of its own, and the records stay independent.
+     */
+    for (uint32_t i = 0; i < namespace_count; i++) {
+      if (namespaces[i].in_use)
+        continue;
+      struct wl_output *wl_output = wl_registry_bind(
+          registry, name, &wl_output_interface, MIN(version, 4));
+      if (create_output(wl_output, name, i) == NULL) {
+        loop = false;
+        ret = EXIT_FAILURE;
+        return;
+      }
     }
   }
 }
 
-/* A no-op function we plug into listeners when we don't want to handle an
- * event. */
-static void noop(void *data, struct wl_registry *registry, uint32_t name) {}
+static void registry_handle_global_remove(void *data,
+                                          struct wl_registry *registry,
+                                          uint32_t name) {
+  /* An output was unplugged. Its river_layout is useless now, and river
+   * doesn't destroy it for us.
+   */
+  for (uint32_t i = 0; i < output_count;) {
+    // This moves another output to i
+    if (outputs[i].global_name == name)
+      destroy_output(&outputs[i]);
+    else
+      i++;
+  }
+}
 
 static const struct wl_registry_listener registry_listener = {
-    .global = registry_handle_global, .global_remove = noop};
+    .global = registry_handle_global,
+    .global_remove = registry_handle_global_remove,
+};
+
+static void ready_handle_done(void *data, struct wl_callback *wl_callback,
+                              uint32_t irrelevant) {
+  wl_callback_destroy(wl_callback);
+  ready_callback = NULL;
+
+  /* The compositor handled every request sent before, so it has a layout
+   * object for every output in every namespace that isn't taken.
+   */
+  if (loop)
+    delta_startup_record(STARTUP_READY, 0);
+}
+
+static const struct wl_callback_listener ready_callback_listener = {
+    .done = ready_handle_done,
+};
 
 static void sync_handle_done(void *data, struct wl_callback *wl_callback,
                              uint32_t irrelevant) {
   wl_callback_destroy(wl_callback);
   sync_callback = NULL;
+  delta_startup_record(STARTUP_REGISTRY, 0);
 
   /* When this function is called, the registry finished advertising all
    * available globals. Let's check if we have everything we need.
@@ -761,9 +1103,16 @@ static void sync_handle_done(void *data, struct wl_callback *wl_callback,
    * available, they won't have a river_layout, so we need to create those
    * here.
    */
-  struct Output *output;
-  wl_list_for_each(output, &outputs, link) if (!output->configured)
-      configure_output(output);
+  for (uint32_t i = 0; i < output_count; i++) {
+    if (!outputs[i].configured)
+      configure_output(&outputs[i]);
+  }
+
+  /* delta is ready once the compositor got all of those, which another sync
+   * tells us.
+   */
+  ready_callback = wl_display_sync(wl_display);
+  wl_callback_add_listener(ready_callback, &ready_callback_listener, NULL);
 }
 
 static const struct wl_callback_listener sync_callback_listener = {
@@ -787,8 +1136,9 @@ static bool init_wayland(void) {
     fputs("Can not connect to Wayland server.\n", stderr);
     return false;
   }
-
-  wl_list_init(&outputs);
+  delta_startup_record(STARTUP_CONNECT, 0);
+  if (batch_emit)
+    delta_emit_batch_to(wl_display);
 
   /* The registry is a global object which is used to advertise all
    * available global objects.
@@ -807,21 +1157,564 @@ static bool init_wayland(void) {
   return true;
 }
 
+/* Report how well the layout cache did over the lifetime of delta */
+static void delta_print_cache_stats(void) {
+  // Records of outputs that went away still count
+  uint64_t hits = 0, misses = 0;
+  uint64_t speculated = 0, speculative_hits = 0, wasted = 0;
+  for (uint32_t i = 0; i < output_capacity; i++) {
+    hits += outputs[i].cache.hits;
+    misses += outputs[i].cache.misses;
+    speculated += outputs[i].cache.speculated;
+    speculative_hits += outputs[i].cache.speculative_hits;
+    wasted += outputs[i].cache.speculative_wasted;
+  }
+  if (hits + misses > 0)
+    fprintf(stderr, "Layout cache: %lu hits, %lu misses (%.1f%% hit rate)\n",
+            (unsigned long)hits, (unsigned long)misses,
+            100.0 * hits / (hits + misses));
+  if (speculated > 0)
+    fprintf(stderr,
+            "Precomputed %lu layouts while idle: %lu used, %lu wasted\n",
+            (unsigned long)speculated, (unsigned long)speculative_hits,
+            (unsigned long)wasted);
+  if (coalesced_demands > 0)
+    fprintf(stderr, "Coalesced %lu superseded layout demands\n",
+            (unsigned long)coalesced_demands);
+}
+
+/* Print a latency histogram, to a file or else to a control reply */
+static void delta_print_histogram(FILE *file, struct ControlReply *reply,
+                                  const char *label,
+                                  const struct Histogram *histogram) {
+  char summary[256];
+  delta_histogram_summary(histogram, summary, sizeof(summary));
+  if (file != NULL)
+    fprintf(file, "latency %s %s\n", label, summary);
+  else
+    delta_control_print(reply, "latency %s %s\n", label, summary);
+}
+
+/**
+ * Print the latency of answering layout demands (from receiving them to
+ * committing the layout, in ns) by layout style, by number of views, and of
+ * every output, skipping those never used
+ *
+ * @param file where to print, or NULL to print to reply
+ * @param reply the control reply to print to otherwise
+ * */
+static void delta_print_latency(FILE *file, struct ControlReply *reply) {
+  char label[128];
+  for (uint32_t style = 0; style < delta_layout_count(); style++) {
+    if (style_latency[style].count == 0)
+      continue;
+    snprintf(label, sizeof(label), "style=%s",
+             delta_layout_descriptor(style)->name);
+    delta_print_histogram(file, reply, label, &style_latency[style]);
+  }
+  for (uint32_t bucket = 0; bucket < VIEW_COUNT_BUCKETS; bucket++) {
+    if (view_count_latency[bucket].count == 0)
+      continue;
+    uint32_t first = bucket == 0 ? 0 : 1u << (bucket - 1);
+    if (bucket <= 1)
+      snprintf(label, sizeof(label), "views=%u", first);
+    else if (bucket == VIEW_COUNT_BUCKETS - 1)
+      snprintf(label, sizeof(label), "views=%u+", first);
+    else
+      snprintf(label, sizeof(label), "views=%u-%u", first, 2 * first - 1);
+    delta_print_histogram(file, reply, label, &view_count_latency[bucket]);
+  }
+  for (uint32_t i = 0; i < output_count; i++) {
+    const struct Output *output = &outputs[i];
+    if (output->latency.count == 0)
+      continue;
+    snprintf(label, sizeof(label), "output=%s id=%u namespace=%s",
+             output->name[0] != '\0' ? output->name : "-", output->id,
+             namespaces[output->namespace].name);
+    delta_print_histogram(file, reply, label, &output->latency);
+  }
+}
+
+/* Flush requests, waiting for the socket to become writable if it is full */
+static void delta_flush_wayland(void) {
+  DELTA_PROBE(flush, begin, 0, 0, 0);
+  // Batched layouts the socket didn't take go before the requests libwayland
+  // holds
+  int emitted = delta_emit_flush();
+  if (emitted == -1) {
+    DELTA_PROBE(flush, end, 0, 0, 0);
+    loop = false;
+    return;
+  }
+  bool blocked = emitted == 0 ||
+                 (wl_display_flush(wl_display) == -1 && errno == EAGAIN);
+  DELTA_PROBE(flush, end, 0, 0, 0);
+  if (blocked != wayland_write_blocked) {
+    wayland_write_blocked = blocked;
+    delta_loop_update_fd(wayland_source,
+                         blocked ? EPOLLIN | EPOLLOUT : EPOLLIN);
+  }
+}
+
+static void delta_handle_wayland_fd(void *data, uint32_t events) {
+  if (events & EPOLLIN) {
+    // This completes the read prepared before waiting
+    wayland_reading = false;
+    if (wl_display_read_events(wl_display) == -1)
+      loop = false;
+  }
+  if (events & EPOLLOUT)
+    delta_flush_wayland();
+  if (events & (EPOLLERR | EPOLLHUP))
+    loop = false;
+}
+
+static void delta_handle_stop_signal(void *data, uint32_t signal) {
+  fprintf(stderr, "Received %s, exiting.\n", strsignal(signal));
+  loop = false;
+}
+
+static void delta_handle_latency_signal(void *data, uint32_t signal) {
+  fputs("Layout demand latency (ns):\n", stderr);
+  delta_print_latency(stderr, NULL);
+}
+
+static void delta_handle_probe_signal(void *data, uint32_t signal) {
+  if (delta_probe_export(probe_path))
+    fprintf(stderr, "Wrote probe events to %s\n", probe_path);
+}
+
+static void delta_handle_trace_flush(void *data, uint32_t expirations) {
+  delta_trace_writer_flush(&trace_writer);
+}
+
+/**
+ * Parse the namespaces given as arguments, on top of the defaults of the
+ * config file and the arguments
+ *
+ * Every namespace is kept as it was if any of them is invalid.
+ *
+ * @return false if a namespace is invalid, which is printed
+ * */
+static bool delta_parse_namespaces(void) {
+  struct LayoutParams defaults = builtin_defaults;
+  struct LayoutCycle layouts = {0};
+  delta_config_apply(&config.defaults, &defaults, &layouts);
+  delta_config_apply(&argument_settings, &defaults, &layouts);
+  if (!delta_layout_allowed(layouts.styles, defaults.layout_style))
+    defaults.layout_style = layouts.order[0];
+
+  struct Namespace parsed[NAMESPACE_MAX_COUNT];
+  uint32_t count = MAX(namespace_spec_count, 1);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!delta_namespace_parse(namespace_specs[i], &defaults, &layouts,
+                               &parsed[i]))
+      return false;
+    for (uint32_t j = 0; j < i; j++) {
+      if (strcmp(parsed[j].name, parsed[i].name) == 0) {
+        fprintf(stderr, "ERROR: Namespace %s is given twice\n",
+                parsed[i].name);
+        return false;
+      }
+    }
+    // Only set once the compositor says so
+    parsed[i].in_use = i < namespace_count && namespaces[i].in_use;
+  }
+  memcpy(namespaces, parsed, count * sizeof(struct Namespace));
+  namespace_count = count;
+  return true;
+}
+
+/**
+ * Parse the config file again, and apply it to the outputs whose settings
+ * it changes
+ *
+ * @param changed set to the number of outputs in use whose settings changed
+ * @return false if the config file or a namespace is invalid, in which case
+ * nothing changes
+ * */
+static bool delta_reload_config(uint32_t *changed) {
+  *changed = 0;
+  // The namespaces are parsed on top of the new config, which is only kept
+  // if they are all valid
+  struct Config previous = config;
+  if (!delta_config_reload(&config))
+    return false;
+  if (!delta_parse_namespaces()) {
+    config = previous;
+    return false;
+  }
+  // Retired records too, they would bring back outdated parameters
+  for (uint32_t i = 0; i < output_count + retired_count; i++) {
+    if (delta_output_update_settings(&outputs[i]) && i < output_count)
+      (*changed)++;
+  }
+  return true;
+}
+
+static void delta_handle_config_change(void) {
+  uint32_t changed;
+  if (delta_reload_config(&changed))
+    fprintf(stderr, "Reloaded the config file, %u outputs changed\n",
+            changed);
+  else
+    fputs("ERROR: Keeping the previous config\n", stderr);
+}
+
+/* Whether an output is picked by the selector of a control request: all,
+ * its id, its name, or its name and namespace as <output>@<namespace> */
+static bool delta_control_selects(const struct Output *output,
+                                  const char *selector, size_t length) {
+  if (length == 3 && strncmp(selector, "all", 3) == 0)
+    return true;
+  char id[16];
+  int id_length = snprintf(id, sizeof(id), "%u", output->id);
+  if ((size_t)id_length == length && strncmp(selector, id, length) == 0)
+    return true;
+  size_t name_length = strlen(output->name);
+  if (name_length == 0 || strncmp(selector, output->name, name_length) != 0)
+    return false;
+  if (length == name_length)
+    return true;
+  const char *namespace = namespaces[output->namespace].name;
+  return selector[name_length] == '@' &&
+         length - name_length - 1 == strlen(namespace) &&
+         strncmp(selector + name_length + 1, namespace,
+                 length - name_length - 1) == 0;
+}
+
+/* One line with the state of an output, for the tags shown last */
+static void delta_control_print_output(struct ControlReply *reply,
+                                       const struct Output *output) {
+  const struct PendingDemand *demand = &output->demand;
+  const struct LayoutParams *params =
+      &output->tag_params[delta_tag_index(demand->tags)];
+  const struct LayoutDescriptor *layout =
+      delta_layout_descriptor(params->layout_style);
+  delta_control_print(
+      reply,
+      "%s id=%u namespace=%s layout=%s main_count=%u main_ratio=%u.%06u "
+      "view_padding=%u outer_padding=%u view_count=%u width=%u height=%u "
+      "tags=%u\n",
+      output->name[0] != '\0' ? output->name : "-", output->id,
+      namespaces[output->namespace].name,
+      layout != NULL ? layout->name : "-", params->main_count,
+      params->main_ratio / LAYOUT_RATIO_ONE,
+      params->main_ratio % LAYOUT_RATIO_ONE, params->view_padding,
+      params->outer_padding, demand->view_count, demand->width,
+      demand->height, demand->tags);
+}
+
+static void delta_control_print_stats(struct ControlReply *reply) {
+  uint64_t hits = 0, misses = 0;
+  uint64_t speculated = 0, speculative_hits = 0, wasted = 0;
+  for (uint32_t i = 0; i < output_capacity; i++) {
+    hits += outputs[i].cache.hits;
+    misses += outputs[i].cache.misses;
+    speculated += outputs[i].cache.speculated;
+    speculative_hits += outputs[i].cache.speculative_hits;
+    wasted += outputs[i].cache.speculative_wasted;
+  }
+  uint32_t taken = 0;
+  for (uint32_t i = 0; i < namespace_count; i++)
+    taken += namespaces[i].in_use;
+  delta_control_print(reply,
+                      "outputs %u\nretired_outputs %u\nnamespaces %u\n"
+                      "namespaces_taken %u\nlayouts %u\nworkers %u\n"
+                      "cache_hits %lu\ncache_misses %lu\n"
+                      "speculated %lu\nspeculative_hits %lu\n"
+                      "speculative_wasted %lu\ncoalesced_demands %lu\n",
+                      output_count, retired_count, namespace_count, taken,
+                      delta_layout_count(), delta_pool_worker_count(),
+                      (unsigned long)hits, (unsigned long)misses,
+                      (unsigned long)speculated,
+                      (unsigned long)speculative_hits, (unsigned long)wasted,
+                      (unsigned long)coalesced_demands);
+  delta_print_latency(NULL, reply);
+}
+
+/**
+ * Handle a request on the control socket
+ *
+ *   outputs [<selector>]     State of every output (or the selected ones)
+ *   stats                    Counters of the whole process, and latency
+ *                            histograms (see delta_print_latency)
+ *   reload                   Parse the config file again
+ *   probes                   Write the events recorded by the probes to the
+ *                            file given with -probes
+ *   set <selector> <commands>
+ *                            Apply layout commands (as sent with riverctl)
+ *                            to the tags an output shows, they are used from
+ *                            the next layout demand. load_layout and
+ *                            load_program are refused, loading code is left
+ *                            to whoever can send commands through river
+ *
+ * Selectors are all, an output id, an output name (in every namespace) or
+ * <output>@<namespace>.
+ * */
+static void delta_handle_control_request(const char *request,
+                                         struct ControlReply *reply) {
+  while (isspace(*request))
+    request++;
+  const char *word = request;
+  while (*request != '\0' && !isspace(*request))
+    request++;
+  size_t word_length = request - word;
+  while (isspace(*request))
+    request++;
+  const char *selector = request;
+  while (*request != '\0' && !isspace(*request))
+    request++;
+  size_t selector_length = request - selector;
+  while (isspace(*request))
+    request++;
+
+  if (word_comp(word, "stats") && selector_length == 0) {
+    delta_control_print_stats(reply);
+  } else if (word_comp(word, "outputs") && *request == '\0') {
+    for (uint32_t i = 0; i < output_count; i++) {
+      if (selector_length == 0 ||
+          delta_control_selects(&outputs[i], selector, selector_length))
+        delta_control_print_output(reply, &outputs[i]);
+    }
+  } else if (word_comp(word, "reload") && selector_length == 0) {
+    uint32_t changed;
+    if (delta_reload_config(&changed)) {
+      delta_control_print(reply, "%u outputs changed\n", changed);
+    } else {
+      delta_control_fail(reply);
+      delta_control_print(reply, "Invalid config, see the log of delta\n");
+    }
+  } else if (word_comp(word, "probes") && selector_length == 0) {
+    if (probe_path == NULL) {
+      delta_control_fail(reply);
+      delta_control_print(reply, "Probes aren't recorded, see -probes\n");
+    } else if (!delta_probe_export(probe_path)) {
+      delta_control_fail(reply);
+      delta_control_print(reply, "Could not write %s\n", probe_path);
+    } else {
+      delta_control_print(reply, "%s\n", probe_path);
+    }
+  } else if (word_comp(word, "set") && *request != '\0') {
+    uint32_t selected = 0;
+    for (uint32_t i = 0; i < output_count; i++) {
+      struct Output *output = &outputs[i];
+      if (!delta_control_selects(output, selector, selector_length))
+        continue;
+      selected++;
+      struct CommandError error;
+      if (!delta_apply_commands(output, output->demand.tags, request, false,
+                                &error)) {
+        delta_control_fail(reply);
+        delta_control_print(reply, "%s: %s: '%.*s'\n",
+                            output->name[0] != '\0' ? output->name : "-",
+                            error.message, (int)error.token_length,
+                            error.token);
+        continue;
+      }
+      // Recorded like commands from the compositor, so replays match. Those
+      // refused change nothing, and would be accepted when replayed.
+      delta_trace_write_command_tags(&trace_writer, output->id,
+                                     output->demand.tags);
+      delta_trace_write_command(&trace_writer, output->id, request);
+    }
+    if (selected == 0) {
+      delta_control_fail(reply);
+      delta_control_print(reply, "No output matches '%.*s'\n",
+                          (int)selector_length, selector);
+    }
+  } else {
+    delta_control_fail(reply);
+    delta_control_print(reply,
+                        "Unknown request '%.*s', use outputs [<output>], "
+                        "stats, reload, probes or set <output> <commands>\n",
+                        (int)word_length, word);
+  }
+}
+
+static bool init_loop(void) {
+  if (!delta_loop_init()) {
+    fputs("Failed to create the event loop.\n", stderr);
+    return false;
+  }
+
+  wayland_source = delta_loop_add_fd(wl_display_get_fd(wl_display), EPOLLIN,
+                                     delta_handle_wayland_fd, NULL);
+  if (wayland_source == NULL ||
+      !delta_loop_add_signal(SIGTERM, delta_handle_stop_signal, NULL) ||
+      !delta_loop_add_signal(SIGINT, delta_handle_stop_signal, NULL) ||
+      !delta_loop_add_signal(SIGHUP, delta_handle_stop_signal, NULL) ||
+      !delta_loop_add_signal(SIGUSR1, delta_handle_latency_signal, NULL) ||
+      (probe_path != NULL &&
+       !delta_loop_add_signal(SIGUSR2, delta_handle_probe_signal, NULL))) {
+    fputs("Failed to set up the event loop.\n", stderr);
+    return false;
+  }
+
+  if (trace_writer.file != NULL) {
+    trace_flush_timer = delta_loop_add_timer(delta_handle_trace_flush, NULL);
+    if (trace_flush_timer == NULL ||
+        !delta_loop_arm_timer(trace_flush_timer, TRACE_FLUSH_INTERVAL_NS,
+                              TRACE_FLUSH_INTERVAL_NS)) {
+      fputs("Failed to set up the event loop.\n", stderr);
+      return false;
+    }
+  }
+
+  if (!delta_config_watch(delta_handle_config_change))
+    return false;
+  return control_path == NULL ||
+         delta_control_open(control_path, delta_handle_control_request);
+}
+
+static void run_loop(void) {
+  while (loop) {
+    /* libwayland only lets us read once everything already queued has been
+     * dispatched.
+     */
+    while (wl_display_prepare_read(wl_display) != 0) {
+      if (wl_display_dispatch_pending(wl_display) == -1)
+        return;
+    }
+    /* Every queued event has been handled, so the demands left are the latest
+     * ones. The commits are flushed right away, instead of whenever the loop
+     * wakes up next.
+     */
+    delta_answer_layout_demands();
+    if (!loop) {
+      wl_display_cancel_read(wl_display);
+      return;
+    }
+    delta_flush_wayland();
+    delta_load_pending();
+
+    /* While there are layouts left to precompute, the loop only polls, and
+     * computes one of them whenever nothing happened.
+     */
+    wayland_reading = true;
+    int count = delta_loop_dispatch(speculation_pending ? 0 : -1);
+    if (count == -1)
+      loop = false;
+    if (wayland_reading) {
+      // Something else woke us up, the Wayland socket wasn't read
+      wl_display_cancel_read(wl_display);
+      wayland_reading = false;
+    }
+    if (wl_display_dispatch_pending(wl_display) == -1)
+      loop = false;
+    if (count == 0 && speculation_pending)
+      speculation_pending = delta_speculate();
+  }
+}
+
+static void finish_loop(void) {
+  delta_loop_remove(wayland_source);
+  delta_loop_remove(trace_flush_timer);
+  delta_control_close();
+  delta_config_close();
+  delta_loop_finish();
+}
+
 static void finish_wayland(void) {
   if (wl_display == NULL)
     return;
 
+  delta_print_cache_stats();
   destroy_all_outputs();
 
   if (sync_callback != NULL)
     wl_callback_destroy(sync_callback);
+  if (ready_callback != NULL)
+    wl_callback_destroy(ready_callback);
   if (layout_manager != NULL)
     river_layout_manager_v3_destroy(layout_manager);
 
   wl_registry_destroy(wl_registry);
+  delta_emit_batch_to(NULL);
   wl_display_disconnect(wl_display);
 }
 
+/* Find the output with the given id in a trace, creating it if needed */
+static struct Output *delta_replay_output(uint32_t id) {
+  for (uint32_t i = 0; i < output_count; i++) {
+    if (outputs[i].id == id)
+      return &outputs[i];
+  }
+  struct Output *output = create_output(NULL, 0, 0);
+  if (output != NULL)
+    output->id = id;
+  return output;
+}
+
+/**
+ * Feed a recorded trace through the layout code, without a compositor
+ *
+ * @param path trace file recorded with -record
+ * @param paced whether to keep the timing between events of the original
+ * session, rather than replaying as fast as possible
+ * @return whether the whole trace could be replayed
+ * */
+static bool delta_replay(const char *path, bool paced) {
+  struct TraceReader reader;
+  if (!delta_trace_reader_open(&reader, path)) {
+    fprintf(stderr, "ERROR: Could not read trace %s\n", path);
+    return false;
+  }
+
+  uint64_t demands = 0, commands = 0, busy_ns = 0;
+  uint64_t start = delta_trace_now_ns();
+  struct TraceEvent event;
+  int status;
+  while ((status = delta_trace_read(&reader, &event)) == 1) {
+    struct Output *output = delta_replay_output(event.output);
+    if (output == NULL) {
+      status = -1;
+      break;
+    }
+    if (paced) {
+      uint64_t due = start + event.timestamp_ns;
+      struct timespec ts = {.tv_sec = due / 1000000000,
+                            .tv_nsec = due % 1000000000};
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    uint64_t before = delta_trace_now_ns();
+    if (event.type == TRACE_LAYOUT_DEMAND) {
+      delta_handle_layout_demand(output, NULL, event.view_count, event.width,
+                                 event.height, event.tags, event.serial);
+      // Every recorded demand is answered, so the replay measures the layout
+      // code rather than the timing of the recording
+      delta_answer_layout_demand(output);
+      demands++;
+    } else if (event.type == TRACE_USER_COMMAND_TAGS) {
+      delta_handle_user_command_tags(output, NULL, event.tags);
+    } else {
+      delta_handle_user_command(output, NULL, event.command);
+      delta_load_pending();
+      commands++;
+    }
+    busy_ns += delta_trace_now_ns() - before;
+    // The loop would be idle until the next event, which isn't timed
+    while (speculation_pending)
+      speculation_pending = delta_speculate();
+  }
+  if (status < 0)
+    fprintf(stderr, "ERROR: Trace %s is truncated or corrupt\n", path);
+
+  fprintf(stderr,
+          "Replayed %lu layout demands and %lu user commands in %.3f s "
+          "(%.3f s handling events, %.0f ns per event)\n",
+          (unsigned long)demands, (unsigned long)commands,
+          (delta_trace_now_ns() - start) / 1e9, busy_ns / 1e9,
+          demands + commands > 0 ? (double)busy_ns / (demands + commands)
+                                 : 0.0);
+  delta_print_cache_stats();
+  delta_print_latency(stderr, NULL);
+  destroy_all_outputs();
+  delta_trace_reader_close(&reader);
+  return status == 0;
+}
+
 void delta_print_help() {
   puts(
       "Delta a layout generator for the River window manager\n"
@@ -835,6 +1728,44 @@ void delta_print_help() {
       "views\n"
       "\t-outer-padding <padding>: The padding around the edges of the layout\n"
       "\t-view-padding <padding>: The padding around the edges of each view\n"
+      "\t-record <file>: Record every layout demand and command to a trace\n"
+      "\t-replay <file>: Replay a recorded trace without a compositor, then "
+      "exit\n"
+      "\t-replay-pacing <fast|original>: Replay as fast as possible "
+      "(default),\n\t\tor keep the timing of the recorded session\n"
+      "\t-state <file|none>: Where the parameters of every output are kept "
+      "across\n\t\trestarts (default $XDG_STATE_HOME/delta/state), none to "
+      "not keep them\n"
+      "\t-plugin <file>: Load additional layouts from a shared object, can "
+      "be given\n\t\tseveral times\n"
+      "\t-program <file>: Load a layout written as a layout program, can be "
+      "given\n\t\tseveral times\n"
+      "\t-workers <count>: Number of threads computing the layouts of large "
+      "demands\n\t\ton several outputs at once (default 3, 0 to compute "
+      "everything\n\t\ton the main thread)\n"
+      "\t-namespace <name[:options]>: Serve layouts in this namespace (default "
+      "swapable),\n\t\tcan be given several times. Options (comma "
+      "separated):\n\t\tlayout=<layout>, layouts=<layout>+<layout>+... "
+      "(those commands\n\t\tmay pick), main-count=, main-ratio=, "
+      "view-padding=, outer-padding=\n"
+      "\t-ready-fd <fd>: Write a line to an inherited fd once every output has "
+      "a\n\t\tlayout, then close it\n"
+      "\t-ready-file <file>: Create a file holding the pid once every output "
+      "has a\n\t\tlayout, it is removed on exit\n"
+      "\t-probes <file>: Record probe events in memory, written to a file as "
+      "Chrome\n\t\ttrace JSON on SIGUSR2, the probes request and exit\n"
+      "\t-config <file|none>: Config file with the defaults and settings of "
+      "outputs\n\t\t(default $XDG_CONFIG_HOME/delta/config), reloaded when "
+      "it changes,\n\t\tsee config.h\n"
+      "\t-control <socket>: Listen for queries and commands on a Unix "
+      "socket, see\n\t\tcontrol.h\n"
+      "\t-emit <marshal|batched>: Send each request of a layout through "
+      "libwayland\n\t\t(default), or encode them all and write them at "
+      "once\n"
+      "\t-speculate <yes|no>: Precompute the likely next layouts of outputs "
+      "while idle\n\t\t(default yes)\n"
+      "\t-startup-times <yes|no>: Print how long each step of the startup "
+      "took\n\t\t(default no)\n"
       "Layout Commands (while delta is running, sent with riverctl):\n"
       "\tmain_count [+/-]<count>: Set the main count, or modify current value "
       "with +/- values\n"
@@ -849,23 +1780,36 @@ void delta_print_help() {
       "\tswap_layout: Move to the next layout style\n"
       "\tset_layout <layout>: Set the layout style (all lowercase)\n"
       "\ttoggle_monocle: Toggle on/off monocle layout\n"
-      "Layouts:\n"
-      "Tile: one large window with additional view stack (like master stack)\n"
-      "Spiral: views spiraling towards center of screen\n"
-      "Diminishing: views shrinking towards the bottom right corner\n"
-      "Stack: single stack\n"
-      "Columns: equal sized columns\n"
-      "Grid: square grid of views\n"
-      "Monocle: single large view\n");
+      "\tload_layout <file>: Load additional layouts from a shared object "
+      "(absolute\n\t\tpath)\n"
+      "\tload_program <file>: Load a layout written as a layout program "
+      "(absolute\n\t\tpath)\n"
+      "Layouts:");
+  for (uint32_t style = 0; style < delta_layout_count(); style++) {
+    const struct LayoutDescriptor *layout = delta_layout_descriptor(style);
+    printf("%s (%s): %s\n", layout->name, layout->symbol,
+           layout->description != NULL ? layout->description : "");
+  }
 }
 
 int main(int argc, char *argv[]) {
+  delta_startup_begin();
+
   // Check if help flag is passed
   if (argc >= 2 && (word_comp(argv[1], "--help") || word_comp(argv[1], "-h"))) {
     delta_print_help();
     return EXIT_SUCCESS;
   }
 
+  const char *record_path = NULL, *replay_path = NULL, *state_path = NULL;
+  bool keep_state = true;
+  bool replay_paced = false;
+  // Leave a CPU to the compositor
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t workers = CLAMP(cpus - 1, 0, DEFAULT_WORKERS);
+  const char *config_path = NULL;
+  bool use_config = true;
+
   // Step through the arguments
   int arg_pointer = 1;
   while (arg_pointer < argc) {
@@ -874,23 +1818,127 @@ int main(int argc, char *argv[]) {
             stderr);
       break;
     }
+    struct ConfigSettings *arguments = &argument_settings;
     if (word_comp(argv[arg_pointer], "-main-count")) {
-      global_main_count = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->params.main_count = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->given |= CONFIG_MAIN_COUNT;
     } else if (word_comp(argv[arg_pointer], "-main-ratio")) {
-      global_main_ratio = CLAMP(atof(argv[arg_pointer + 1]), 0.0, 1.0);
+      arguments->params.main_ratio =
+          CLAMP(atof(argv[arg_pointer + 1]), 0.0, 1.0) * LAYOUT_RATIO_ONE + 0.5;
+      arguments->given |= CONFIG_MAIN_RATIO;
     } else if (word_comp(argv[arg_pointer], "-view-padding")) {
-      global_view_padding = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->params.view_padding = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->given |= CONFIG_VIEW_PADDING;
     } else if (word_comp(argv[arg_pointer], "-outer-padding")) {
-      global_outer_padding = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->params.outer_padding = MAX(atoi(argv[arg_pointer + 1]), 0);
+      arguments->given |= CONFIG_OUTER_PADDING;
+    } else if (word_comp(argv[arg_pointer], "-config")) {
+      use_config = !word_comp(argv[arg_pointer + 1], "none");
+      config_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-record")) {
+      record_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-replay")) {
+      replay_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-replay-pacing")) {
+      replay_paced = word_comp(argv[arg_pointer + 1], "original");
+    } else if (word_comp(argv[arg_pointer], "-state")) {
+      keep_state = !word_comp(argv[arg_pointer + 1], "none");
+      state_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-plugin")) {
+      if (!delta_plugin_load(argv[arg_pointer + 1]))
+        return EXIT_FAILURE;
+    } else if (word_comp(argv[arg_pointer], "-program")) {
+      if (!delta_program_load(argv[arg_pointer + 1]))
+        return EXIT_FAILURE;
+    } else if (word_comp(argv[arg_pointer], "-workers")) {
+      workers = CLAMP(atoi(argv[arg_pointer + 1]), 0, POOL_MAX_WORKERS);
+    } else if (word_comp(argv[arg_pointer], "-ready-fd")) {
+      // atoi would take anything that isn't a number for stdin
+      const char *value = argv[arg_pointer + 1];
+      char *end;
+      errno = 0;
+      long fd = strtol(value, &end, 10);
+      if (end == value || *end != '\0' || errno != 0 || fd < 0 ||
+          fd > INT_MAX || !delta_startup_notify_fd(fd)) {
+        fprintf(stderr, "ERROR: %s is not an open file descriptor\n",
+                argv[arg_pointer + 1]);
+        return EXIT_FAILURE;
+      }
+    } else if (word_comp(argv[arg_pointer], "-ready-file")) {
+      delta_startup_notify_file(argv[arg_pointer + 1]);
+    } else if (word_comp(argv[arg_pointer], "-namespace")) {
+      if (namespace_spec_count == NAMESPACE_MAX_COUNT) {
+        fprintf(stderr, "ERROR: At most %d namespaces can be served\n",
+                NAMESPACE_MAX_COUNT);
+        return EXIT_FAILURE;
+      }
+      namespace_specs[namespace_spec_count++] = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-probes")) {
+      probe_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-control")) {
+      control_path = argv[arg_pointer + 1];
+    } else if (word_comp(argv[arg_pointer], "-emit")) {
+      batch_emit = word_comp(argv[arg_pointer + 1], "batched");
+    } else if (word_comp(argv[arg_pointer], "-speculate")) {
+      speculate = !word_comp(argv[arg_pointer + 1], "no");
+    } else if (word_comp(argv[arg_pointer], "-startup-times")) {
+      delta_startup_print_to(word_comp(argv[arg_pointer + 1], "yes") ? stderr
+                                                                      : NULL);
     }
     arg_pointer += 2;
   }
 
-  if (init_wayland()) {
+  // The config file and namespaces are parsed last, so that they can use the
+  // layouts of every plugin and program, and the defaults given in any order
+  if ((use_config && !delta_config_open(config_path, &config)) ||
+      !delta_parse_namespaces()) {
+    delta_config_close();
+    return EXIT_FAILURE;
+  }
+
+  if (record_path != NULL &&
+      !delta_trace_writer_open(&trace_writer, record_path)) {
+    fprintf(stderr, "ERROR: Could not open trace %s\n", record_path);
+    return EXIT_FAILURE;
+  }
+
+  if (probe_path != NULL && !delta_probe_start()) {
+    fputs("ERROR: Could not allocate the probe events\n", stderr);
+    return EXIT_FAILURE;
+  }
+
+  if (replay_path != NULL) {
+    ret = delta_replay(replay_path, replay_paced) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (probe_path != NULL)
+      delta_probe_export(probe_path);
+    delta_probe_stop();
+    delta_config_close();
+    delta_trace_writer_close(&trace_writer);
+    return ret;
+  }
+
+  // Without a state file, delta simply starts with the default parameters
+  if (keep_state)
+    delta_state_open(state_path);
+
+  // Pick the geometry kernels before any worker could race to do it, then
+  // start the workers. Without them, layouts are all computed on this thread.
+  delta_geometry_selected_kernels();
+  delta_pool_init(workers);
+
+  if (init_wayland() && init_loop()) {
     ret = EXIT_SUCCESS;
-    while (loop && wl_display_dispatch(wl_display) != -1)
-      ;
+    run_loop();
   }
+  delta_pool_finish();
+  free(layout_jobs);
+  if (probe_path != NULL)
+    delta_probe_export(probe_path);
+  delta_probe_stop();
+  finish_loop();
   finish_wayland();
+  delta_startup_finish();
+  delta_state_close();
+  delta_trace_writer_close(&trace_writer);
   return ret;
 }
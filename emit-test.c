@@ -0,0 +1,183 @@
+/*
+ * Checks of the batched emission of delta against libwayland
+ *
+ * A client connection is made over a socket pair with the real
+ * libwayland-client, and every layout is sent twice: once through the
+ * generated marshalling, once batched (see emit.h). The bytes read from the
+ * other end of the socket have to be the same, so the batched encoding
+ * follows libwayland rather than delta's idea of it.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "emit.h"
+#include "layout.h"
+#include "river-layout-v3.h"
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Room for the largest layout checked, as sent on the wire */
+#define TEST_MAX_BYTES (1 << 16)
+
+static const uint32_t view_counts[] = {1, 2, 3, 7, 100, 1000};
+
+/* Names of every length up to a few words, the commit pads them */
+static const char *names[] = {"", "a", "ab", "abc", "abcd", "abcde", "[]=",
+                              "a name longer than a few words"};
+
+static struct wl_display *display = NULL;
+static struct river_layout_v3 *layout = NULL;
+static int compositor_fd = -1; // The other end of the connection
+
+static uint32_t failures = 0;
+
+/* Read everything sent so far */
+static size_t test_receive(char *bytes) {
+  size_t size = 0;
+  ssize_t received;
+  while (size < TEST_MAX_BYTES &&
+         (received = recv(compositor_fd, bytes + size, TEST_MAX_BYTES - size,
+                          MSG_DONTWAIT)) > 0)
+    size += received;
+  return size;
+}
+
+/* Send a layout both ways and compare what arrives */
+static void test_layout(const struct ViewBuffer *buffer, const char *name,
+                        uint32_t serial) {
+  static char marshalled[TEST_MAX_BYTES], batched[TEST_MAX_BYTES];
+
+  delta_emit_batch_to(NULL);
+  delta_emit_layout(layout, buffer, name, serial);
+  if (wl_display_flush(display) == -1) {
+    fprintf(stderr, "ERROR: Failed to flush the display: %s\n",
+            strerror(errno));
+    failures++;
+    return;
+  }
+  size_t marshalled_size = test_receive(marshalled);
+
+  delta_emit_batch_to(display);
+  delta_emit_layout(layout, buffer, name, serial);
+  if (delta_emit_flush() != 1 || wl_display_flush(display) == -1) {
+    fputs("ERROR: Failed to send a batched layout\n", stderr);
+    failures++;
+    return;
+  }
+  size_t batched_size = test_receive(batched);
+
+  if (marshalled_size != batched_size ||
+      memcmp(marshalled, batched, marshalled_size) != 0) {
+    fprintf(stderr,
+            "FAILED: %u views named '%s' are sent differently batched "
+            "(%zu bytes instead of %zu)\n",
+            buffer->count, name, batched_size, marshalled_size);
+    failures++;
+  }
+}
+
+/* Every built-in layout, in a few sizes */
+static bool test_layouts(struct ViewBuffer *buffer, uint32_t *serial) {
+  for (uint32_t style = 0; style < delta_layout_count(); style++) {
+    for (size_t v = 0; v < ARRAY_LENGTH(view_counts); v++) {
+      struct LayoutParams params = {
+          .layout_style = style,
+          .main_count = 1,
+          .main_ratio = LAYOUT_RATIO_ONE * 55 / 100,
+          .view_padding = 5,
+          .outer_padding = 5,
+      };
+      if (!delta_layout_compute(&params, view_counts[v], 2560, 1440,
+                                buffer)) {
+        fputs("Failed to allocate.\n", stderr);
+        return false;
+      }
+      test_layout(buffer, delta_layout_name(style), ++*serial);
+    }
+  }
+  return true;
+}
+
+/* Coordinates and sizes libwayland has to send as is, and every name */
+static bool test_edge_cases(struct ViewBuffer *buffer, uint32_t *serial) {
+  if (!delta_view_buffer_reserve(buffer, 3)) {
+    fputs("Failed to allocate.\n", stderr);
+    return false;
+  }
+  buffer->count = 3;
+  const int32_t x[] = {-1, INT32_MIN, INT32_MAX};
+  const uint32_t size[] = {0, 1, UINT32_MAX};
+  for (uint32_t i = 0; i < 3; i++) {
+    buffer->x[i] = x[i];
+    buffer->y[i] = -x[i] - 1;
+    buffer->width[i] = size[i];
+    buffer->height[i] = size[2 - i];
+  }
+  for (size_t n = 0; n < ARRAY_LENGTH(names); n++)
+    test_layout(buffer, names[n], ++*serial);
+  // A layout without views is only a commit
+  buffer->count = 0;
+  test_layout(buffer, "[]=", UINT32_MAX);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+    fprintf(stderr, "ERROR: Failed to create a socket pair: %s\n",
+            strerror(errno));
+    return EXIT_FAILURE;
+  }
+  compositor_fd = fds[1];
+  // libwayland takes over its end, no server is needed since nothing is
+  // ever read from it
+  display = wl_display_connect_to_fd(fds[0]);
+  if (display == NULL) {
+    fputs("ERROR: Failed to connect the display.\n", stderr);
+    return EXIT_FAILURE;
+  }
+  layout = (struct river_layout_v3 *)wl_proxy_create(
+      (struct wl_proxy *)display, &river_layout_v3_interface);
+  if (layout == NULL) {
+    fputs("ERROR: Failed to create the layout object.\n", stderr);
+    return EXIT_FAILURE;
+  }
+
+  struct ViewBuffer buffer = {0};
+  uint32_t serial = 0;
+  bool ran = test_layouts(&buffer, &serial) &&
+             test_edge_cases(&buffer, &serial);
+
+  delta_emit_batch_to(NULL);
+  delta_view_buffer_free(&buffer);
+  wl_proxy_destroy((struct wl_proxy *)layout);
+  wl_display_disconnect(display);
+  close(compositor_fd);
+  if (!ran || failures != 0)
+    return EXIT_FAILURE;
+  printf("Batched emission matches libwayland for %u layouts\n", serial);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+/*
+ * Sending computed layouts to river
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "emit.h"
+#include "probe.h"
+
+/* Largest message libwayland sends, in bytes */
+#define EMIT_MAX_MESSAGE_SIZE 4096
+
+/* Words of a push_view_dimensions request: object id, size and opcode, x, y,
+ * width, height and serial */
+#define EMIT_PUSH_WORDS 7
+
+/* Display layouts are sent batched to, NULL to marshal each request */
+static struct wl_display *batch_display = NULL;
+static struct EmitBuffer batch = {0};
+
+/* Bytes of batched layouts the socket didn't take at once */
+struct EmitTail {
+  char *bytes;
+  size_t start; // Sent up to here
+  size_t end;
+  size_t capacity;
+};
+static struct EmitTail tail = {0};
+
+/* Set once a layout behind the tail couldn't be kept, the stream can't go on
+ * without it */
+static bool broken = false;
+
+bool delta_emit_encode(struct EmitBuffer *encoded, uint32_t object_id,
+                       const struct ViewBuffer *buffer,
+                       const char *layout_name, uint32_t serial) {
+  // Strings are sent with their length and terminator, padded to a word
+  uint32_t name_size = strlen(layout_name) + 1;
+  uint32_t name_words = (name_size + 3) / 4;
+  uint32_t commit_words = 4 + name_words;
+  if (commit_words * 4 > EMIT_MAX_MESSAGE_SIZE ||
+      buffer->count > (UINT32_MAX - commit_words) / EMIT_PUSH_WORDS)
+    return false;
+  uint32_t length = buffer->count * EMIT_PUSH_WORDS + commit_words;
+  if (encoded->capacity < length) {
+    uint32_t *words = realloc(encoded->words, length * sizeof(uint32_t));
+    if (words == NULL)
+      return false;
+    encoded->words = words;
+    encoded->capacity = length;
+  }
+
+  // Each message starts with the object id, then its size in bytes in the
+  // upper half of a word and the opcode in the lower one
+  uint32_t *word = encoded->words;
+  for (uint32_t i = 0; i < buffer->count; i++) {
+    word[0] = object_id;
+    word[1] = EMIT_PUSH_WORDS * 4 << 16 | RIVER_LAYOUT_V3_PUSH_VIEW_DIMENSIONS;
+    word[2] = (uint32_t)buffer->x[i];
+    word[3] = (uint32_t)buffer->y[i];
+    word[4] = buffer->width[i];
+    word[5] = buffer->height[i];
+    word[6] = serial;
+    word += EMIT_PUSH_WORDS;
+  }
+  *word++ = object_id;
+  *word++ = commit_words * 4 << 16 | RIVER_LAYOUT_V3_COMMIT;
+  *word++ = name_size;
+  // The padding is zeroed, as libwayland does
+  word[name_words - 1] = 0;
+  memcpy(word, layout_name, name_size);
+  word += name_words;
+  *word = serial;
+  encoded->length = length;
+  return true;
+}
+
+void delta_emit_buffer_free(struct EmitBuffer *encoded) {
+  free(encoded->words);
+  *encoded = (struct EmitBuffer){0};
+}
+
+/* Make room for more bytes at the end of the tail, false if allocation
+ * failed */
+static bool delta_emit_reserve(size_t size) {
+  // What was sent is dropped first, so the tail only grows while the
+  // compositor doesn't read
+  if (tail.start > 0) {
+    memmove(tail.bytes, tail.bytes + tail.start, tail.end - tail.start);
+    tail.end -= tail.start;
+    tail.start = 0;
+  }
+  if (tail.capacity >= tail.end + size)
+    return true;
+  char *grown = realloc(tail.bytes, tail.end + size);
+  if (grown == NULL)
+    return false;
+  tail.bytes = grown;
+  tail.capacity = tail.end + size;
+  return true;
+}
+
+/* Append bytes to the tail, after delta_emit_reserve */
+static void delta_emit_queue(const char *bytes, size_t size) {
+  memcpy(tail.bytes + tail.end, bytes, size);
+  tail.end += size;
+}
+
+int delta_emit_flush(void) {
+  if (broken)
+    return -1;
+  while (tail.start < tail.end) {
+    ssize_t written =
+        send(wl_display_get_fd(batch_display), tail.bytes + tail.start,
+             tail.end - tail.start, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written > 0) {
+      tail.start += written;
+    } else if (errno == EAGAIN) {
+      return 0;
+    } else if (errno != EINTR) {
+      // The connection is gone, libwayland reports it on its next flush
+      tail.start = tail.end;
+    }
+  }
+  tail.start = tail.end = 0;
+  return 1;
+}
+
+/**
+ * Send a layout batched
+ *
+ * @return false if the layout has to go through the generated marshalling
+ * */
+static bool delta_emit_batched(struct river_layout_v3 *layout,
+                               const struct ViewBuffer *buffer,
+                               const char *layout_name, uint32_t serial) {
+  bool encoded =
+      delta_emit_encode(&batch, wl_proxy_get_id((struct wl_proxy *)layout),
+                        buffer, layout_name, serial);
+  const char *bytes = (const char *)batch.words;
+  size_t size = (size_t)batch.length * 4;
+
+  // Behind a tail the socket didn't take, every layout has to wait as well,
+  // marshalling it would send it first
+  int flushed = delta_emit_flush();
+  if (flushed == 0) {
+    if (encoded && delta_emit_reserve(size)) {
+      delta_emit_queue(bytes, size);
+    } else {
+      fputs("ERROR: Could not queue a layout, closing the connection\n",
+            stderr);
+      broken = true;
+    }
+  }
+  if (flushed != 1)
+    return true;
+  // Requests libwayland still holds have to go first, if they can't it sends
+  // this layout as well. The room for what the socket doesn't take is made
+  // beforehand, since the requests cut short can't be taken back.
+  if (!encoded || wl_display_flush(batch_display) == -1 ||
+      !delta_emit_reserve(size))
+    return false;
+
+  ssize_t written = send(wl_display_get_fd(batch_display), bytes, size,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+  // Errors are left to libwayland to report, as with any other request
+  if (written <= 0)
+    return false;
+  // The rest is sent once the socket is writable again, see delta_emit_flush
+  if ((size_t)written < size)
+    delta_emit_queue(bytes + written, size - written);
+  return true;
+}
+
+void delta_emit_batch_to(struct wl_display *display) {
+  batch_display = display;
+  if (display == NULL) {
+    delta_emit_buffer_free(&batch);
+    free(tail.bytes);
+    tail = (struct EmitTail){0};
+    broken = false;
+  }
+}
+
+void delta_emit_layout(struct river_layout_v3 *layout,
+                       const struct ViewBuffer *buffer,
+                       const char *layout_name, uint32_t serial) {
+  DELTA_PROBE(push, begin, buffer->count, serial, 0);
+  bool batched = batch_display != NULL &&
+                 delta_emit_batched(layout, buffer, layout_name, serial);
+  for (uint32_t i = 0; !batched && i < buffer->count; i++) {
+    river_layout_v3_push_view_dimensions(layout, buffer->x[i], buffer->y[i],
+                                         buffer->width[i], buffer->height[i],
+                                         serial);
+  }
+  DELTA_PROBE(push, end, buffer->count, serial, 0);
+  // Commit the layout (finalize the layout which was set for the various views)
+  if (!batched)
+    river_layout_v3_commit(layout, layout_name, serial);
+  DELTA_PROBE(commit, mark, serial, 0, 0);
+}
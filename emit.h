@@ -0,0 +1,99 @@
+/*
+ * Sending computed layouts to river
+ *
+ * By default every request goes through the marshalling generated from
+ * river-layout-v3.xml, one libwayland call per view. Batched emission encodes
+ * the push_view_dimensions requests and the commit of a layout into one
+ * buffer instead, byte for byte as libwayland would, and writes it to the
+ * socket at once. Requests sent that way don't show up in WAYLAND_DEBUG.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_EMIT_H
+#define DELTA_EMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "layout.h"
+#include "river-layout-v3.h"
+
+/* The requests of a layout as sent on the wire */
+struct EmitBuffer {
+  uint32_t *words;
+  uint32_t length;   // Words in use
+  uint32_t capacity; // Words the buffer can hold
+};
+
+/**
+ * Push the dimensions of every view in the buffer and commit the layout
+ *
+ * @param layout layout object of the output
+ * @param buffer computed view dimensions, in stack order
+ * @param layout_name name of the layout shown by river
+ * @param serial serial of the layout demand
+ * */
+void delta_emit_layout(struct river_layout_v3 *layout,
+                       const struct ViewBuffer *buffer,
+                       const char *layout_name, uint32_t serial);
+
+/**
+ * Encode the requests delta_emit_layout makes, as libwayland sends them
+ *
+ * @param encoded filled in, only ever grown
+ * @param object_id id of the layout object
+ * @param buffer computed view dimensions, in stack order
+ * @param layout_name name of the layout shown by river
+ * @param serial serial of the layout demand
+ * @return false if allocation failed, or the commit doesn't fit a message
+ * */
+bool delta_emit_encode(struct EmitBuffer *encoded, uint32_t object_id,
+                       const struct ViewBuffer *buffer,
+                       const char *layout_name, uint32_t serial);
+
+void delta_emit_buffer_free(struct EmitBuffer *encoded);
+
+/**
+ * Send layouts batched to the socket of a display, see above
+ *
+ * A layout falls back to the generated marshalling whenever libwayland still
+ * has requests queued. The part of a layout the socket doesn't take at once
+ * is kept, along with every layout after it, until delta_emit_flush sends it.
+ *
+ * Other requests marshalled meanwhile (e.g. for outputs plugged in) wait in
+ * libwayland until delta_emit_flush is done, as long as libwayland doesn't
+ * flush them by itself, which it only does once it holds 4 KiB of requests
+ * or more.
+ *
+ * @param display the display, NULL to go back to the generated marshalling
+ * (dropping what is kept)
+ * */
+void delta_emit_batch_to(struct wl_display *display);
+
+/**
+ * Send what is kept of batched layouts, without blocking
+ *
+ * This has to be done before flushing the display, the requests libwayland
+ * holds come after it.
+ *
+ * @return 1 once everything is sent, 0 while some is left (then wait for the
+ * socket to be writable), -1 if a layout couldn't be kept for lack of
+ * memory: the connection can't be used anymore
+ * */
+int delta_emit_flush(void);
+
+#endif
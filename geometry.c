@@ -0,0 +1,244 @@
+/*
+ * Array kernels shared by the layouts, see geometry.h
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "geometry.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GEOMETRY_X86 1
+#include <immintrin.h>
+#endif
+
+#define MIN(a, b) (a < b ? a : b)
+
+struct GeometryKernelTable {
+  void (*fill)(int32_t *offsets, uint32_t *sizes, uint32_t count,
+               uint32_t start, uint32_t step, uint32_t size);
+  // Gets the padding already combined, see delta_geometry_pad
+  void (*pad)(int32_t *offsets, uint32_t *sizes, uint32_t count,
+              uint32_t shift, uint32_t shrink);
+};
+
+static void delta_geometry_fill_scalar(int32_t *offsets, uint32_t *sizes,
+                                       uint32_t count, uint32_t start,
+                                       uint32_t step, uint32_t size) {
+  for (uint32_t i = 0; i < count; i++) {
+    offsets[i] = start + i * step;
+    sizes[i] = size;
+  }
+}
+
+/* shift and shrink are at most INT32_MAX, as are the offsets and sizes, so
+ * nothing overflows a uint32_t */
+static void delta_geometry_pad_scalar(int32_t *offsets, uint32_t *sizes,
+                                      uint32_t count, uint32_t shift,
+                                      uint32_t shrink) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t offset = (uint32_t)offsets[i] + shift;
+    offsets[i] = MIN(offset, INT32_MAX);
+    sizes[i] = sizes[i] > shrink ? sizes[i] - shrink : 0;
+  }
+}
+
+#ifdef GEOMETRY_X86
+/* The vector versions do the same as the scalar ones, four or eight views at
+ * a time, and leave the last few views to the scalar ones. As there are no
+ * unsigned 32 bit comparisons in SSE2, the saturation uses the sign bit:
+ * offset + shift is at most 2^32 - 2, so it went past INT32_MAX exactly when
+ * its sign bit is set, and size - shrink went below 0 exactly when its sign
+ * bit is set.
+ */
+
+__attribute__((target("sse2"))) static void
+delta_geometry_fill_sse2(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                         uint32_t start, uint32_t step, uint32_t size) {
+  __m128i offset = _mm_setr_epi32(start, start + step, start + 2 * step,
+                                  start + 3 * step);
+  __m128i stride = _mm_set1_epi32(4 * step);
+  __m128i sizes_value = _mm_set1_epi32(size);
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_si128((__m128i *)(offsets + i), offset);
+    _mm_storeu_si128((__m128i *)(sizes + i), sizes_value);
+    offset = _mm_add_epi32(offset, stride);
+  }
+  delta_geometry_fill_scalar(offsets + i, sizes + i, count - i,
+                             start + i * step, step, size);
+}
+
+__attribute__((target("sse2"))) static void
+delta_geometry_pad_sse2(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                        uint32_t shift, uint32_t shrink) {
+  __m128i shift_value = _mm_set1_epi32(shift);
+  __m128i shrink_value = _mm_set1_epi32(shrink);
+  __m128i limit = _mm_set1_epi32(INT32_MAX);
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i offset = _mm_loadu_si128((const __m128i *)(offsets + i));
+    offset = _mm_add_epi32(offset, shift_value);
+    __m128i over = _mm_srai_epi32(offset, 31);
+    offset = _mm_or_si128(_mm_andnot_si128(over, offset),
+                          _mm_and_si128(over, limit));
+    _mm_storeu_si128((__m128i *)(offsets + i), offset);
+
+    __m128i size = _mm_loadu_si128((const __m128i *)(sizes + i));
+    size = _mm_sub_epi32(size, shrink_value);
+    size = _mm_andnot_si128(_mm_srai_epi32(size, 31), size);
+    _mm_storeu_si128((__m128i *)(sizes + i), size);
+  }
+  delta_geometry_pad_scalar(offsets + i, sizes + i, count - i, shift, shrink);
+}
+
+__attribute__((target("avx2"))) static void
+delta_geometry_fill_avx2(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                         uint32_t start, uint32_t step, uint32_t size) {
+  __m256i offset = _mm256_setr_epi32(
+      start, start + step, start + 2 * step, start + 3 * step,
+      start + 4 * step, start + 5 * step, start + 6 * step, start + 7 * step);
+  __m256i stride = _mm256_set1_epi32(8 * step);
+  __m256i sizes_value = _mm256_set1_epi32(size);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_si256((__m256i *)(offsets + i), offset);
+    _mm256_storeu_si256((__m256i *)(sizes + i), sizes_value);
+    offset = _mm256_add_epi32(offset, stride);
+  }
+  delta_geometry_fill_scalar(offsets + i, sizes + i, count - i,
+                             start + i * step, step, size);
+}
+
+__attribute__((target("avx2"))) static void
+delta_geometry_pad_avx2(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                        uint32_t shift, uint32_t shrink) {
+  __m256i shift_value = _mm256_set1_epi32(shift);
+  __m256i shrink_value = _mm256_set1_epi32(shrink);
+  __m256i limit = _mm256_set1_epi32(INT32_MAX);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i offset = _mm256_loadu_si256((const __m256i *)(offsets + i));
+    offset = _mm256_add_epi32(offset, shift_value);
+    __m256i over = _mm256_srai_epi32(offset, 31);
+    offset = _mm256_blendv_epi8(offset, limit, over);
+    _mm256_storeu_si256((__m256i *)(offsets + i), offset);
+
+    __m256i size = _mm256_loadu_si256((const __m256i *)(sizes + i));
+    size = _mm256_sub_epi32(size, shrink_value);
+    size = _mm256_andnot_si256(_mm256_srai_epi32(size, 31), size);
+    _mm256_storeu_si256((__m256i *)(sizes + i), size);
+  }
+  delta_geometry_pad_scalar(offsets + i, sizes + i, count - i, shift, shrink);
+}
+#endif
+
+static const struct GeometryKernelTable kernel_tables[] = {
+    [GEOMETRY_KERNELS_SCALAR] = {delta_geometry_fill_scalar,
+                                 delta_geometry_pad_scalar},
+#ifdef GEOMETRY_X86
+    [GEOMETRY_KERNELS_SSE2] = {delta_geometry_fill_sse2,
+                               delta_geometry_pad_sse2},
+    [GEOMETRY_KERNELS_AVX2] = {delta_geometry_fill_avx2,
+                               delta_geometry_pad_avx2},
+#endif
+};
+
+static enum GeometryKernels selected_kernels = GEOMETRY_KERNELS_AUTO;
+
+static bool delta_geometry_kernels_supported(enum GeometryKernels kernels) {
+  switch (kernels) {
+  case GEOMETRY_KERNELS_AUTO:
+  case GEOMETRY_KERNELS_SCALAR:
+    return true;
+#ifdef GEOMETRY_X86
+  case GEOMETRY_KERNELS_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case GEOMETRY_KERNELS_AVX2:
+    return __builtin_cpu_supports("avx2");
+#else
+  case GEOMETRY_KERNELS_SSE2:
+  case GEOMETRY_KERNELS_AVX2:
+    return false;
+#endif
+  }
+  return false;
+}
+
+bool delta_geometry_select_kernels(enum GeometryKernels kernels) {
+  if (!delta_geometry_kernels_supported(kernels))
+    return false;
+  if (kernels == GEOMETRY_KERNELS_AUTO) {
+    kernels = GEOMETRY_KERNELS_SCALAR;
+    if (delta_geometry_kernels_supported(GEOMETRY_KERNELS_SSE2))
+      kernels = GEOMETRY_KERNELS_SSE2;
+    if (delta_geometry_kernels_supported(GEOMETRY_KERNELS_AVX2))
+      kernels = GEOMETRY_KERNELS_AVX2;
+  }
+  selected_kernels = kernels;
+  return true;
+}
+
+enum GeometryKernels delta_geometry_selected_kernels(void) {
+  if (selected_kernels == GEOMETRY_KERNELS_AUTO)
+    delta_geometry_select_kernels(GEOMETRY_KERNELS_AUTO);
+  return selected_kernels;
+}
+
+const char *delta_geometry_kernels_name(enum GeometryKernels kernels) {
+  switch (kernels) {
+  case GEOMETRY_KERNELS_AUTO:
+    return "auto";
+  case GEOMETRY_KERNELS_SCALAR:
+    return "scalar";
+  case GEOMETRY_KERNELS_SSE2:
+    return "sse2";
+  case GEOMETRY_KERNELS_AVX2:
+    return "avx2";
+  }
+  return "?";
+}
+
+void delta_geometry_fill(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                         uint32_t start, uint32_t step, uint32_t size) {
+  kernel_tables[delta_geometry_selected_kernels()].fill(offsets, sizes, count,
+                                                        start, step, size);
+}
+
+void delta_geometry_fill_split(int32_t *offsets, uint32_t *sizes,
+                               uint32_t count, uint32_t start, uint32_t size) {
+  if (count == 0)
+    return;
+  struct GeometrySplit split = delta_geometry_split(size, count);
+  // The larger parts come first, then the others
+  delta_geometry_fill(offsets, sizes, split.remainder, start, split.part + 1,
+                      split.part + 1);
+  delta_geometry_fill(offsets + split.remainder, sizes + split.remainder,
+                      count - split.remainder,
+                      start + split.remainder * (split.part + 1), split.part,
+                      split.part);
+}
+
+void delta_geometry_pad(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                        uint32_t padding, uint32_t outer_padding) {
+  uint64_t shift = (uint64_t)padding + outer_padding;
+  uint64_t shrink = 2 * (uint64_t)padding;
+  kernel_tables[delta_geometry_selected_kernels()].pad(
+      offsets, sizes, count, MIN(shift, INT32_MAX), MIN(shrink, INT32_MAX));
+}
@@ -0,0 +1,173 @@
+/*
+ * Integer arithmetic shared by the layouts
+ *
+ * Layouts only use integers: ratios are fixed point (see LAYOUT_RATIO_ONE),
+ * subtractions saturate at 0 instead of wrapping around, and areas split
+ * into equal parts hand out the remainder pixels, so the parts exactly fill
+ * the area. The results are the same on every build, whatever the compiler
+ * does with floating point.
+ *
+ * The steps most layouts share (filling runs of equal views and applying the
+ * padding) work on whole arrays of a view buffer. They have SSE2 and AVX2
+ * versions, one of which is picked at runtime depending on the CPU, and
+ * scalar versions for everything else. All of them give the same results.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_GEOMETRY_H
+#define DELTA_GEOMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "layout.h"
+
+/* size - 2 * padding, or 0 if the padding takes up everything */
+static inline uint32_t delta_geometry_shrink(uint32_t size, uint32_t padding) {
+  uint64_t both_sides = 2 * (uint64_t)padding;
+  return size > both_sides ? size - (uint32_t)both_sides : 0;
+}
+
+/* Part of size given by a fixed point ratio, rounded down */
+static inline uint32_t delta_geometry_scale(uint32_t size, uint32_t ratio) {
+  uint64_t part = (uint64_t)size * ratio / LAYOUT_RATIO_ONE;
+  return part > size ? size : (uint32_t)part;
+}
+
+/* Square root, rounded down */
+static inline uint32_t delta_geometry_isqrt(uint32_t n) {
+  uint32_t root = 0, bit = 1u << 30;
+  while (bit > n)
+    bit >>= 2;
+  while (bit != 0) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+/* A size split into equal parts, handed out one after the other. The first
+ * size % count parts are one pixel larger than the others, so that together
+ * the parts cover the size exactly.
+ */
+struct GeometrySplit {
+  uint32_t offset;    // Start of the next part
+  uint32_t part;      // Size of the smaller parts
+  uint32_t remainder; // Number of larger parts left
+};
+
+/* Start splitting size into count parts, count must not be 0 */
+static inline struct GeometrySplit delta_geometry_split(uint32_t size,
+                                                        uint32_t count) {
+  return (struct GeometrySplit){
+      .offset = 0,
+      .part = size / count,
+      .remainder = size % count,
+  };
+}
+
+/**
+ * Take the next part of a split
+ *
+ * @param split the split
+ * @param offset set to the start of the part
+ * @return size of the part
+ * */
+static inline uint32_t delta_geometry_split_next(struct GeometrySplit *split,
+                                                 uint32_t *offset) {
+  uint32_t size = split->part;
+  if (split->remainder > 0) {
+    split->remainder--;
+    size++;
+  }
+  *offset = split->offset;
+  split->offset += size;
+  return size;
+}
+
+/* Implementations of the array kernels below */
+enum GeometryKernels {
+  GEOMETRY_KERNELS_AUTO, // The fastest one the CPU supports
+  GEOMETRY_KERNELS_SCALAR,
+  GEOMETRY_KERNELS_SSE2,
+  GEOMETRY_KERNELS_AVX2,
+};
+
+/**
+ * Choose the implementation of the array kernels
+ *
+ * Only needed to compare them, the fastest one is picked on first use
+ * otherwise.
+ *
+ * @param kernels implementation to use
+ * @return false if the CPU (or the build) doesn't support it
+ * */
+bool delta_geometry_select_kernels(enum GeometryKernels kernels);
+
+/* Implementation of the array kernels in use (never GEOMETRY_KERNELS_AUTO) */
+enum GeometryKernels delta_geometry_selected_kernels(void);
+
+/* Name of an implementation of the array kernels (e.g. "avx2") */
+const char *delta_geometry_kernels_name(enum GeometryKernels kernels);
+
+/**
+ * Fill a run of views along one axis
+ *
+ * Sets offsets[i] to start + i * step and sizes[i] to size for every
+ * i < count. Every offset and size must fit in an int32_t.
+ *
+ * @param offsets offsets along the axis (x or y)
+ * @param sizes sizes along the axis (width or height)
+ * @param count number of views
+ * @param start offset of the first view
+ * @param step distance between the offsets of consecutive views
+ * @param size size of every view
+ * */
+void delta_geometry_fill(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                         uint32_t start, uint32_t step, uint32_t size);
+
+/**
+ * Split size into count equal parts along one axis
+ *
+ * The parts start at start, and as with struct GeometrySplit the first ones
+ * get the remainder pixels. count may be 0.
+ * */
+void delta_geometry_fill_split(int32_t *offsets, uint32_t *sizes,
+                               uint32_t count, uint32_t start, uint32_t size);
+
+/**
+ * Apply the padding to the views along one axis
+ *
+ * Offsets move by padding + outer_padding (capped to INT32_MAX), and sizes
+ * shrink by padding on both sides (saturating at 0). Offsets and sizes must
+ * not be larger than INT32_MAX beforehand.
+ *
+ * @param offsets offsets along the axis (x or y)
+ * @param sizes sizes along the axis (width or height)
+ * @param count number of views
+ * @param padding padding around every view
+ * @param outer_padding padding around the whole layout
+ * */
+void delta_geometry_pad(int32_t *offsets, uint32_t *sizes, uint32_t count,
+                        uint32_t padding, uint32_t outer_padding);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Fixed size latency histograms
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+
+/* Values below this have a bucket each */
+#define HISTOGRAM_EXACT (2 * HISTOGRAM_SUB_BUCKETS)
+
+/* Bucket of a value: the position of its highest bit, and the bits after */
+static uint32_t delta_histogram_bucket(uint64_t value) {
+  if (value < HISTOGRAM_EXACT)
+    return value;
+  uint32_t shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS;
+  uint64_t bucket = (uint64_t)shift * HISTOGRAM_SUB_BUCKETS + (value >> shift);
+  return bucket < HISTOGRAM_BUCKET_COUNT ? bucket : HISTOGRAM_BUCKET_COUNT - 1;
+}
+
+/* Largest value that goes in a bucket */
+static uint64_t delta_histogram_bucket_end(uint32_t bucket) {
+  if (bucket < HISTOGRAM_EXACT)
+    return bucket;
+  uint32_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  uint64_t start = (uint64_t)(bucket % HISTOGRAM_SUB_BUCKETS +
+                              HISTOGRAM_SUB_BUCKETS)
+                   << shift;
+  return start + (1ull << shift) - 1;
+}
+
+void delta_histogram_record(struct Histogram *histogram, uint64_t value) {
+  histogram->count++;
+  histogram->sum += value;
+  if (value > histogram->max)
+    histogram->max = value;
+  histogram->buckets[delta_histogram_bucket(value)]++;
+}
+
+uint64_t delta_histogram_percentile(const struct Histogram *histogram,
+                                    double percentile) {
+  if (histogram->count == 0)
+    return 0;
+  // Rank of the value wanted, starting from 1
+  uint64_t rank = percentile / 100 * histogram->count + 0.5;
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++) {
+    seen += histogram->buckets[bucket];
+    if (seen >= rank && bucket < HISTOGRAM_BUCKET_COUNT - 1) {
+      uint64_t end = delta_histogram_bucket_end(bucket);
+      return end < histogram->max ? end : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+int delta_histogram_summary(const struct Histogram *histogram, char *buffer,
+                            size_t size) {
+  return snprintf(
+      buffer, size, "count=%lu mean=%lu p50=%lu p90=%lu p99=%lu max=%lu",
+      (unsigned long)histogram->count,
+      (unsigned long)(histogram->count > 0 ? histogram->sum / histogram->count
+                                           : 0),
+      (unsigned long)delta_histogram_percentile(histogram, 50),
+      (unsigned long)delta_histogram_percentile(histogram, 90),
+      (unsigned long)delta_histogram_percentile(histogram, 99),
+      (unsigned long)histogram->max);
+}
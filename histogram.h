@@ -0,0 +1,71 @@
+/*
+ * Fixed size latency histograms
+ *
+ * Values (nanoseconds) go in log scaled buckets: each power of two is split
+ * in HISTOGRAM_SUB_BUCKETS buckets, so a percentile read back is within 25%
+ * of the real value, from a single nanosecond to seconds, in 1 KiB. Recording
+ * a value is a few instructions and never allocates, so histograms can be
+ * kept up to date all the time.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_HISTOGRAM_H
+#define DELTA_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Buckets each power of two is split in */
+#define HISTOGRAM_SUB_BUCKET_BITS 2
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+
+/* Enough for values up to about 8 s, larger ones go in the last bucket */
+#define HISTOGRAM_BUCKET_COUNT 128
+
+struct Histogram {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t buckets[HISTOGRAM_BUCKET_COUNT];
+};
+
+/* Add a value to a histogram, a zeroed histogram is empty */
+void delta_histogram_record(struct Histogram *histogram, uint64_t value);
+
+/**
+ * Estimate a percentile
+ *
+ * @param histogram the histogram
+ * @param percentile between 0 and 100
+ * @return the upper bound of the bucket holding the percentile (at most the
+ * largest value recorded), 0 for an empty histogram
+ * */
+uint64_t delta_histogram_percentile(const struct Histogram *histogram,
+                                    double percentile);
+
+/**
+ * Summarize a histogram as "count=.. mean=.. p50=.. p90=.. p99=.. max=.."
+ *
+ * @param histogram the histogram
+ * @param buffer where the summary is written, always terminated
+ * @param size size of the buffer
+ * @return the length of the summary, like snprintf
+ * */
+int delta_histogram_summary(const struct Histogram *histogram, char *buffer,
+                            size_t size);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Example layout plugin for delta: main views centered between two stacks
+ *
+ * Build it with `make plugins`, then load it with
+ * `delta -plugin build/delta-layout-centered.so`, or while delta runs with
+ * `riverctl send-layout-cmd delta "load_layout /path/to/it.so"`, and use it
+ * with `set_layout centered`.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+
+#include "geometry.h"
+#include "layout.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+
+/**
+ * Compute a centered layout
+ *
+ * The main views are stacked in a column in the middle, main_ratio of the
+ * width wide. The other views go to the stacks on the right and on the left
+ * in turn, starting with the right one. With a single stack view there is
+ * no left stack, and the right one takes all of the remaining width.
+ * */
+static void delta_layout_centered(const struct LayoutParams *params,
+                                  uint32_t view_count, uint32_t width,
+                                  uint32_t height, struct ViewBuffer *views) {
+  uint32_t main_views = MIN(params->main_count, view_count);
+  uint32_t stack_views = view_count - main_views;
+  uint32_t right_views = (stack_views + 1) / 2, left_views = stack_views / 2;
+
+  uint32_t main_width = width;
+  if (stack_views > 0)
+    main_width =
+        main_views > 0 ? delta_geometry_scale(width, params->main_ratio) : 0;
+  uint32_t left_width = left_views > 0 ? (width - main_width) / 2 : 0;
+  uint32_t right_width = width - main_width - left_width;
+
+  struct GeometrySplit main_rows =
+      delta_geometry_split(height, MAX(main_views, 1));
+  struct GeometrySplit right_rows =
+      delta_geometry_split(height, MAX(right_views, 1));
+  struct GeometrySplit left_rows =
+      delta_geometry_split(height, MAX(left_views, 1));
+  for (uint32_t i = 0; i < view_count; i++) {
+    struct GeometrySplit *rows;
+    uint32_t x, y;
+    if (i < main_views) {
+      rows = &main_rows;
+      x = left_width;
+      views->width[i] = main_width;
+    } else if ((i - main_views) % 2 == 0) {
+      rows = &right_rows;
+      x = left_width + main_width;
+      views->width[i] = right_width;
+    } else {
+      rows = &left_rows;
+      x = 0;
+      views->width[i] = left_width;
+    }
+    views->height[i] = delta_geometry_split_next(rows, &y);
+    views->x[i] = x;
+    views->y[i] = y;
+  }
+}
+
+static const struct LayoutDescriptor layouts[] = {
+    {"centered", "|M|", "main views centered between two stacks",
+     LAYOUT_USES_MAIN_COUNT | LAYOUT_USES_MAIN_RATIO, delta_layout_centered},
+};
+
+const struct LayoutPlugin delta_layout_plugin = {
+    .version = LAYOUT_PLUGIN_VERSION,
+    .count = sizeof(layouts) / sizeof(layouts[0]),
+    .layouts = layouts,
+};
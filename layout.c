@@ -0,0 +1,417 @@
+/*
+ * Layout geometry for delta
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geometry.h"
+#include "layout.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+
+bool delta_view_buffer_reserve(struct ViewBuffer *buffer, uint32_t capacity) {
+  if (buffer->capacity >= capacity)
+    return true;
+  // Grow geometrically so a slowly increasing view count doesn't allocate
+  // on every demand. The contents don't need to be kept, they are always
+  // computed again after growing.
+  uint32_t new_capacity = MAX(buffer->capacity * 2, capacity);
+  uint32_t *fields = malloc((size_t)new_capacity * 4 * sizeof(uint32_t));
+  if (fields == NULL)
+    return false;
+  free(buffer->x);
+  buffer->x = (int32_t *)fields;
+  buffer->y = (int32_t *)fields + new_capacity;
+  buffer->width = fields + 2 * (size_t)new_capacity;
+  buffer->height = fields + 3 * (size_t)new_capacity;
+  buffer->capacity = new_capacity;
+  return true;
+}
+
+void delta_view_buffer_free(struct ViewBuffer *buffer) {
+  // The other fields share the allocation of x
+  free(buffer->x);
+  buffer->x = NULL;
+  buffer->y = NULL;
+  buffer->width = NULL;
+  buffer->height = NULL;
+  buffer->count = 0;
+  buffer->capacity = 0;
+}
+
+bool delta_layout_params_equal(const struct LayoutParams *a,
+                               const struct LayoutParams *b) {
+  return a->layout_style == b->layout_style &&
+         a->main_count == b->main_count && a->main_ratio == b->main_ratio &&
+         a->view_padding == b->view_padding &&
+         a->outer_padding == b->outer_padding;
+}
+
+/*
+ * The layouts below only place the views in the usable area (what is left
+ * inside the outer padding), without any padding. delta_layout_compute then
+ * applies the padding to every view at once.
+ */
+
+/**
+ * Compute a Tiled layout
+ *
+ * The tiled layout has a set of main windows (laid out in a stack),
+ * and another column (also laid out in a stack)
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * */
+static void delta_layout_tile(const struct LayoutParams *params,
+                              uint32_t view_count, uint32_t width,
+                              uint32_t height, struct ViewBuffer *views) {
+  /* Simple tiled layout with no frills.*/
+  unsigned int main_size, // Size (width) of the main column
+      stack_size;         // Size (width) of the stack
+  // If the number of views to be put in the main column is 0, set
+  // the main size to 0 and the stack size to the full width
+  if (params->main_count == 0) {
+    main_size = 0;
+    stack_size = width;
+  } else if (view_count <= params->main_count) {
+    /* If all of the views are to be assigned to the main stack, set the
+     * main size to be the full width, and the stack size to 0 */
+    main_size = width;
+    stack_size = 0;
+  } else {
+    /* Otherwise, set the main size to the the width multiplied by the
+     * main ratio, and the stacksize to be the remainder of the usable area*/
+    main_size = delta_geometry_scale(width, params->main_ratio);
+    stack_size = width - main_size;
+  }
+  // The main views come first, filling the main column from the top, the
+  // remaining views fill the stack after it. Either may be empty.
+  uint32_t main_views = MIN(params->main_count, view_count);
+  uint32_t stack_views = view_count - main_views;
+  delta_geometry_fill(views->x, views->width, main_views, 0, 0, main_size);
+  delta_geometry_fill_split(views->y, views->height, main_views, 0, height);
+  delta_geometry_fill(views->x + main_views, views->width + main_views,
+                      stack_views, main_size, 0, stack_size);
+  delta_geometry_fill_split(views->y + main_views, views->height + main_views,
+                            stack_views, 0, height);
+}
+
+/**
+ * Compute a spiral layout
+ *
+ * This layout halves the size of the of each view, alternating
+ * between width and height
+ *
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * @param diminish whether the spiral should be diminishing (goes to the right
+ * bottom corner)
+ * */
+static void delta_layout_spiral_towards(uint32_t view_count, uint32_t width,
+                                        uint32_t height,
+                                        struct ViewBuffer *views,
+                                        bool diminish) {
+  // The view_x/view_y offsets and view_width/view_height track the area
+  // remaining for the following views
+  unsigned int view_x, view_y, view_width, view_height;
+  view_x = 0;
+  view_y = 0;
+  // View width starts as full width
+  view_width = width;
+  // Same with height
+  view_height = height;
+  for (unsigned int i = 0; i < view_count; i++) {
+    // Offset and size of this view
+    unsigned int x = view_x, y = view_y, w = view_width, h = view_height;
+    if (i == view_count - 1) {
+      // For the last view, just take the full width/height
+    } else if (i % 2 == 0) {
+      // If i is even, the width will be split, an odd pixel is left to the
+      // remaining area
+      w = view_width / 2;
+      view_width -= w;
+      if ((i % 4 == 2) && !diminish) {
+        // View is on the right side
+        x += view_width;
+      } else {
+        // View is on the left side
+        view_x += w;
+      }
+    } else {
+      // If i is odd, the height will be split
+      h = view_height / 2;
+      view_height -= h;
+      if ((i % 4 == 3) && !diminish) {
+        // View is on the up side
+        y += view_height;
+      } else {
+        // View is on the down side
+        view_y += h;
+      }
+    }
+    views->x[i] = x;
+    views->y[i] = y;
+    views->width[i] = w;
+    views->height[i] = h;
+  }
+}
+
+static void delta_layout_spiral(const struct LayoutParams *params,
+                                uint32_t view_count, uint32_t width,
+                                uint32_t height, struct ViewBuffer *views) {
+  delta_layout_spiral_towards(view_count, width, height, views, false);
+}
+
+static void delta_layout_diminishing(const struct LayoutParams *params,
+                                     uint32_t view_count, uint32_t width,
+                                     uint32_t height,
+                                     struct ViewBuffer *views) {
+  delta_layout_spiral_towards(view_count, width, height, views, true);
+}
+
+/**
+ * Compute a column layout
+ *
+ * This layout is just equal sized columns for each view
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * */
+static void delta_layout_column(const struct LayoutParams *params,
+                                uint32_t view_count, uint32_t width,
+                                uint32_t height, struct ViewBuffer *views) {
+  // Equal widths side by side, each with the full usable height
+  delta_geometry_fill_split(views->x, views->width, view_count, 0, width);
+  delta_geometry_fill(views->y, views->height, view_count, 0, 0, height);
+}
+
+/**
+ * Compute a stacked layout
+ *
+ * This layout is just a single stack across the entire usable width
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * */
+static void delta_layout_stack(const struct LayoutParams *params,
+                               uint32_t view_count, uint32_t width,
+                               uint32_t height, struct ViewBuffer *views) {
+  // Equal heights from the top of the stack, each with the full usable width
+  delta_geometry_fill(views->x, views->width, view_count, 0, 0, width);
+  delta_geometry_fill_split(views->y, views->height, view_count, 0, height);
+}
+
+/**
+ * Compute a grid layout
+ *
+ * This layout is a grid of views, with an equal number of rows and columns
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * */
+static void delta_layout_grid(const struct LayoutParams *params,
+                              uint32_t view_count, uint32_t width,
+                              uint32_t height, struct ViewBuffer *views) {
+  // Calculate the number of rows/cols
+  uint32_t grid_size = delta_geometry_isqrt(view_count);
+  if (grid_size * grid_size < view_count) {
+    grid_size++;
+  }
+  unsigned int view_y,   // y-coord offset
+      view_outer_height; // height of the row
+  // Equally divide the width into columns. The first row is always full
+  // (grid_size <= view_count), every other row has the same columns.
+  delta_geometry_fill_split(views->x, views->width, grid_size, 0, width);
+  // Equally divide the height into rows
+  struct GeometrySplit rows = delta_geometry_split(height, grid_size);
+  // Fill the grid one row at a time, starting from the top of the stack
+  for (unsigned int i = 0; i < view_count; i += grid_size) {
+    uint32_t row_count = MIN(grid_size, view_count - i);
+    view_outer_height = delta_geometry_split_next(&rows, &view_y);
+    if (i > 0) {
+      memcpy(views->x + i, views->x, row_count * sizeof(int32_t));
+      memcpy(views->width + i, views->width, row_count * sizeof(uint32_t));
+    }
+    delta_geometry_fill(views->y + i, views->height + i, row_count, view_y, 0,
+                        view_outer_height);
+  }
+}
+
+/**
+ * Compute a monocle layout
+ *
+ * This layout is a single large window
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions
+ * */
+static void delta_layout_monocle(const struct LayoutParams *params,
+                                 uint32_t view_count, uint32_t width,
+                                 uint32_t height, struct ViewBuffer *views) {
+  // Full width and height
+  delta_geometry_fill(views->x, views->width, view_count, 0, 0, width);
+  delta_geometry_fill(views->y, views->height, view_count, 0, 0, height);
+}
+
+static const struct LayoutDescriptor builtin_layouts[LAYOUT_BUILTIN_COUNT] = {
+    [TILE] = {"tile", "[]=",
+              "one large window with additional view stack (like master "
+              "stack)",
+              LAYOUT_USES_MAIN_COUNT | LAYOUT_USES_MAIN_RATIO,
+              delta_layout_tile},
+    [SPIRAL] = {"spiral", "꩜", "views spiraling towards center of screen", 0,
+                delta_layout_spiral},
+    [DIMINISHING] = {"diminishing", "↘",
+                     "views shrinking towards the bottom right corner", 0,
+                     delta_layout_diminishing},
+    [COLUMN] = {"column", "|||", "equal sized columns", 0,
+                delta_layout_column},
+    [STACK] = {"stack", "=", "single stack", 0, delta_layout_stack},
+    [GRID] = {"grid", "#", "square grid of views", 0, delta_layout_grid},
+    [MONOCLE] = {"monocle", "🔍", "single large view", 0,
+                 delta_layout_monocle},
+};
+
+/* The registry, the built-in layouts come first in the order of enum
+ * LayoutStyle */
+static const struct LayoutDescriptor *layouts[LAYOUT_MAX_COUNT] = {
+    [TILE] = &builtin_layouts[TILE],
+    [SPIRAL] = &builtin_layouts[SPIRAL],
+    [DIMINISHING] = &builtin_layouts[DIMINISHING],
+    [COLUMN] = &builtin_layouts[COLUMN],
+    [STACK] = &builtin_layouts[STACK],
+    [GRID] = &builtin_layouts[GRID],
+    [MONOCLE] = &builtin_layouts[MONOCLE],
+};
+static uint32_t layout_count = LAYOUT_BUILTIN_COUNT;
+
+bool delta_layout_register(const struct LayoutDescriptor *descriptor,
+                           uint32_t *style) {
+  uint32_t existing;
+  if (layout_count == LAYOUT_MAX_COUNT ||
+      delta_layout_find(descriptor->name, strlen(descriptor->name),
+                        &existing))
+    return false;
+  layouts[layout_count] = descriptor;
+  *style = layout_count++;
+  return true;
+}
+
+uint32_t delta_layout_count(void) { return layout_count; }
+
+const struct LayoutDescriptor *delta_layout_descriptor(uint32_t style) {
+  return style < layout_count ? layouts[style] : NULL;
+}
+
+bool delta_layout_find(const char *name, size_t length, uint32_t *style) {
+  for (uint32_t i = 0; i < layout_count; i++) {
+    if (strncmp(layouts[i]->name, name, length) == 0 &&
+        layouts[i]->name[length] == '\0') {
+      *style = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool delta_layout_allowed(uint64_t styles, uint32_t style) {
+  return styles == 0 || (style < 64 && (styles >> style & 1) != 0);
+}
+
+void delta_layout_cycle_add(struct LayoutCycle *cycle, uint32_t style) {
+  if (style >= LAYOUT_MAX_COUNT || (cycle->styles >> style & 1) != 0)
+    return;
+  cycle->styles |= 1ull << style;
+  cycle->order[cycle->length++] = style;
+}
+
+bool delta_layout_cycle_equal(const struct LayoutCycle *a,
+                              const struct LayoutCycle *b) {
+  return a->styles == b->styles && a->length == b->length &&
+         memcmp(a->order, b->order, a->length) == 0;
+}
+
+bool delta_layout_params_equivalent(const struct LayoutParams *a,
+                                    const struct LayoutParams *b) {
+  if (a->layout_style != b->layout_style ||
+      a->view_padding != b->view_padding ||
+      a->outer_padding != b->outer_padding)
+    return false;
+  const struct LayoutDescriptor *layout =
+      delta_layout_descriptor(a->layout_style);
+  uint32_t uses = layout != NULL ? layout->parameters : ~0u;
+  return (!(uses & LAYOUT_USES_MAIN_COUNT) || a->main_count == b->main_count) &&
+         (!(uses & LAYOUT_USES_MAIN_RATIO) || a->main_ratio == b->main_ratio);
+}
+
+const char *delta_layout_name(uint32_t layout_style) {
+  const struct LayoutDescriptor *layout = delta_layout_descriptor(layout_style);
+  return layout != NULL ? layout->symbol : "?";
+}
+
+bool delta_layout_compute(const struct LayoutParams *params,
+                          uint32_t view_count, uint32_t width,
+                          uint32_t height, struct ViewBuffer *buffer) {
+  if (!delta_view_buffer_reserve(buffer, view_count))
+    return false;
+  buffer->count = view_count;
+  // Nothing to lay out (and the layouts would divide by zero)
+  if (view_count == 0)
+    return true;
+
+  // The usable area is what is left inside the outer padding. Views are
+  // pushed with int32_t offsets, so areas any larger than that are no use
+  // (and keeping within it lets the padding be applied without overflow).
+  width = MIN(delta_geometry_shrink(width, params->outer_padding), INT32_MAX);
+  height =
+      MIN(delta_geometry_shrink(height, params->outer_padding), INT32_MAX);
+  // Unknown layouts (e.g. of a plugin that isn't loaded) fall back to tile
+  const struct LayoutDescriptor *layout =
+      delta_layout_descriptor(params->layout_style);
+  if (layout == NULL)
+    layout = layouts[TILE];
+  layout->compute(params, view_count, width, height, buffer);
+
+  // Every view gets the same padding around it
+  delta_geometry_pad(buffer->x, buffer->width, view_count,
+                     params->view_padding, params->outer_padding);
+  delta_geometry_pad(buffer->y, buffer->height, view_count,
+                     params->view_padding, params->outer_padding);
+  return true;
+}
@@ -0,0 +1,217 @@
+/*
+ * Layout geometry for delta
+ *
+ * The functions here only compute where views go, they never talk to the
+ * compositor, so they can be reused, cached and benchmarked on their own.
+ *
+ * Every layout is described by a LayoutDescriptor in a registry, which holds
+ * the built-in layouts and those loaded from plugins. This header is all a
+ * plugin needs, see struct LayoutPlugin.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_LAYOUT_H
+#define DELTA_LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of built-in layouts */
+#define LAYOUT_BUILTIN_COUNT 7
+
+/* Most layouts the registry holds, built-in ones included */
+#define LAYOUT_MAX_COUNT 64
+
+/* Index of each built-in layout in the registry, loaded layouts follow */
+enum LayoutStyle {
+  TILE,        // Normal Tiled Layout
+  SPIRAL,      // Fibonacci Spiral
+  DIMINISHING, // Dimminishing Spiral
+  COLUMN,      // Equal sized columns
+  STACK,       // Equal sized rows
+  GRID,        // Equal sized rows and columns
+  MONOCLE,     // Single large window
+};
+
+/* Fixed point ratio of 1, ratios are in millionths so that the decimal
+ * ratios users type are represented exactly
+ */
+#define LAYOUT_RATIO_ONE 1000000
+
+/* Everything (apart from the demand itself) a layout depends on */
+struct LayoutParams {
+  uint32_t layout_style; // Index in the registry, see enum LayoutStyle
+  uint32_t main_count;
+  uint32_t main_ratio; // Fixed point, see LAYOUT_RATIO_ONE
+  uint32_t view_padding;
+  uint32_t outer_padding;
+};
+
+/* Number of tags in river, each has its own layout parameters */
+#define TAG_COUNT 32
+
+/* Reusable buffer of view dimensions, exactly as pushed to river
+ *
+ * The dimensions are kept in one array per field rather than one struct per
+ * view, so that the steps shared by the layouts go through each field
+ * several views at a time (see geometry.h). The arrays share one allocation,
+ * which only ever grows (geometrically), so once the buffer has seen the
+ * largest view count computing a layout into it does not allocate.
+ */
+struct ViewBuffer {
+  int32_t *x;
+  int32_t *y;
+  uint32_t *width;
+  uint32_t *height;
+  uint32_t count;    // Number of views in the current layout
+  uint32_t capacity; // Number of views the buffer can hold
+};
+
+/**
+ * Make sure the buffer can hold at least the given number of views
+ *
+ * @param buffer buffer to grow
+ * @param capacity number of views needed
+ * @return false if the allocation failed (the buffer is left untouched)
+ * */
+bool delta_view_buffer_reserve(struct ViewBuffer *buffer, uint32_t capacity);
+
+/* Release the memory held by a buffer */
+void delta_view_buffer_free(struct ViewBuffer *buffer);
+
+/**
+ * Place the views of a layout
+ *
+ * Views are placed in the usable area (inside the outer padding) without
+ * any padding, which is applied afterwards for every layout alike. Only the
+ * first view_count entries of each array of the buffer are written, and
+ * every offset and size must stay within the usable area. Layouts of
+ * different outputs may be computed on several threads at once.
+ *
+ * @param params parameters of the output
+ * @param view_count number of views in the layout, never 0
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param views buffer receiving view_count view dimensions, in stack order
+ * */
+typedef void (*LayoutFunction)(const struct LayoutParams *params,
+                               uint32_t view_count, uint32_t width,
+                               uint32_t height, struct ViewBuffer *views);
+
+/* Parameters a layout depends on, besides the style and the paddings */
+#define LAYOUT_USES_MAIN_COUNT (1u << 0)
+#define LAYOUT_USES_MAIN_RATIO (1u << 1)
+
+struct LayoutDescriptor {
+  const char *name;        // Name used by set_layout, e.g. "tile"
+  const char *symbol;      // Shown by river, e.g. "[]="
+  const char *description; // One line for the help text
+  uint32_t parameters;     // LAYOUT_USES_* flags
+  LayoutFunction compute;
+};
+
+/* Version of the plugin interface, bumped whenever any of the structs above
+ * change */
+#define LAYOUT_PLUGIN_VERSION 1
+
+/* Name of the struct LayoutPlugin a plugin exports */
+#define LAYOUT_PLUGIN_SYMBOL "delta_layout_plugin"
+
+/* What a plugin (a shared object) exports as delta_layout_plugin
+ *
+ * The descriptors and their functions have to stay valid for as long as
+ * delta runs, plugins are never unloaded. Plugins can use the inline
+ * helpers of geometry.h, but no other function of delta.
+ */
+struct LayoutPlugin {
+  uint32_t version; // LAYOUT_PLUGIN_VERSION
+  uint32_t count;   // Number of layouts
+  const struct LayoutDescriptor *layouts;
+};
+
+/**
+ * Add a layout to the registry
+ *
+ * @param descriptor the layout, has to stay valid
+ * @param style set to the index of the layout
+ * @return false if the registry is full, or a layout of the same name exists
+ * */
+bool delta_layout_register(const struct LayoutDescriptor *descriptor,
+                           uint32_t *style);
+
+/* Number of layouts in the registry */
+uint32_t delta_layout_count(void);
+
+/* Descriptor of a layout, NULL if there is no such layout */
+const struct LayoutDescriptor *delta_layout_descriptor(uint32_t style);
+
+/**
+ * Find a layout by name
+ *
+ * @param name name of the layout, not necessarily terminated
+ * @param length length of the name
+ * @param style set to the index of the layout
+ * @return false if there is no such layout
+ * */
+bool delta_layout_find(const char *name, size_t length, uint32_t *style);
+
+/* Whether a layout is in a set of layouts, which has a bit for each index in
+ * the registry (LAYOUT_MAX_COUNT fits), 0 being the set of every layout */
+bool delta_layout_allowed(uint64_t styles, uint32_t style);
+
+/* Layouts that may be picked, in the order swap_layout goes through them */
+struct LayoutCycle {
+  uint64_t styles;                 // See delta_layout_allowed
+  uint8_t order[LAYOUT_MAX_COUNT]; // Every layout in styles, in order
+  uint32_t length; // 0 for every layout, in the order of the registry
+};
+
+/* Add a layout at the end of a cycle, unless it already is in it */
+void delta_layout_cycle_add(struct LayoutCycle *cycle, uint32_t style);
+
+/* Whether two cycles hold the same layouts in the same order */
+bool delta_layout_cycle_equal(const struct LayoutCycle *a,
+                              const struct LayoutCycle *b);
+
+/* Compare the parameters field by field (the struct may contain padding) */
+bool delta_layout_params_equal(const struct LayoutParams *a,
+                               const struct LayoutParams *b);
+
+/* Whether the parameters give the same layout: the styles are the same, and
+ * so is every parameter the style depends on */
+bool delta_layout_params_equivalent(const struct LayoutParams *a,
+                                    const struct LayoutParams *b);
+
+/* Name of the layout style, as shown by river (e.g. "[]=" for tile) */
+const char *delta_layout_name(uint32_t layout_style);
+
+/**
+ * Compute the dimensions of every view for a layout demand
+ *
+ * @param params layout style and parameters of the output
+ * @param view_count number of views in the layout
+ * @param width width of the usable area
+ * @param height height of the usable area
+ * @param buffer buffer receiving the view dimensions, in stack order
+ * @return false if the buffer could not be grown to hold view_count views
+ * */
+bool delta_layout_compute(const struct LayoutParams *params,
+                          uint32_t view_count, uint32_t width,
+                          uint32_t height, struct ViewBuffer *buffer);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * epoll based event loop of delta
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "loop.h"
+
+/* Maximum number of events handled per epoll_wait */
+#define LOOP_MAX_EVENTS 16
+
+enum LoopSourceType {
+  LOOP_FD,
+  LOOP_TIMER,
+  LOOP_SIGNAL,
+};
+
+struct LoopSource {
+  enum LoopSourceType type;
+  int fd;
+  LoopCallback callback;
+  void *data;
+  struct LoopSource *next_removed; // Link in the list of removed sources
+};
+
+struct SignalHandler {
+  LoopCallback callback;
+  void *data;
+};
+
+static int epoll_fd = -1;
+
+/* Removed sources are only freed after dispatching, as epoll may still have
+ * returned events for them
+ */
+static struct LoopSource *removed_sources = NULL;
+
+/* All handled signals share a single signalfd */
+static struct LoopSource *signal_source = NULL;
+static sigset_t signal_mask;
+static struct SignalHandler signal_handlers[NSIG];
+
+bool delta_loop_init(void) {
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  sigemptyset(&signal_mask);
+  return epoll_fd != -1;
+}
+
+static void delta_loop_free_removed(void) {
+  while (removed_sources != NULL) {
+    struct LoopSource *source = removed_sources;
+    removed_sources = source->next_removed;
+    free(source);
+  }
+}
+
+void delta_loop_finish(void) {
+  if (signal_source != NULL)
+    delta_loop_remove(signal_source);
+  signal_source = NULL;
+  delta_loop_free_removed();
+  if (epoll_fd != -1)
+    close(epoll_fd);
+  epoll_fd = -1;
+}
+
+static struct LoopSource *delta_loop_add(enum LoopSourceType type, int fd,
+                                         uint32_t events,
+                                         LoopCallback callback, void *data) {
+  struct LoopSource *source = calloc(1, sizeof(struct LoopSource));
+  if (source == NULL)
+    return NULL;
+  source->type = type;
+  source->fd = fd;
+  source->callback = callback;
+  source->data = data;
+
+  struct epoll_event event = {.events = events, .data.ptr = source};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+    free(source);
+    return NULL;
+  }
+  return source;
+}
+
+struct LoopSource *delta_loop_add_fd(int fd, uint32_t events,
+                                     LoopCallback callback, void *data) {
+  return delta_loop_add(LOOP_FD, fd, events, callback, data);
+}
+
+bool delta_loop_update_fd(struct LoopSource *source, uint32_t events) {
+  struct epoll_event event = {.events = events, .data.ptr = source};
+  return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, source->fd, &event) == 0;
+}
+
+struct LoopSource *delta_loop_add_timer(LoopCallback callback, void *data) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd == -1)
+    return NULL;
+  struct LoopSource *source =
+      delta_loop_add(LOOP_TIMER, fd, EPOLLIN, callback, data);
+  if (source == NULL)
+    close(fd);
+  return source;
+}
+
+bool delta_loop_arm_timer(struct LoopSource *source, uint64_t delay_ns,
+                          uint64_t interval_ns) {
+  struct itimerspec spec = {
+      .it_value = {.tv_sec = delay_ns / 1000000000,
+                   .tv_nsec = delay_ns % 1000000000},
+      .it_interval = {.tv_sec = interval_ns / 1000000000,
+                      .tv_nsec = interval_ns % 1000000000},
+  };
+  return timerfd_settime(source->fd, 0, &spec, NULL) == 0;
+}
+
+/* Read every pending signal and run its handler */
+static void delta_loop_handle_signals(void *data, uint32_t events) {
+  struct signalfd_siginfo info;
+  while (read(signal_source->fd, &info, sizeof(info)) == sizeof(info)) {
+    if (info.ssi_signo >= NSIG)
+      continue;
+    struct SignalHandler *handler = &signal_handlers[info.ssi_signo];
+    if (handler->callback != NULL)
+      handler->callback(handler->data, info.ssi_signo);
+  }
+}
+
+bool delta_loop_add_signal(int signal, LoopCallback callback, void *data) {
+  if (signal <= 0 || signal >= NSIG)
+    return false;
+  sigaddset(&signal_mask, signal);
+  // The signal has to be blocked, or it would still be delivered the usual
+  // way (most likely killing delta)
+  if (sigprocmask(SIG_BLOCK, &signal_mask, NULL) == -1)
+    return false;
+  int fd = signalfd(signal_source != NULL ? signal_source->fd : -1,
+                    &signal_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd == -1)
+    return false;
+  if (signal_source == NULL) {
+    signal_source = delta_loop_add(LOOP_SIGNAL, fd, EPOLLIN,
+                                   delta_loop_handle_signals, NULL);
+    if (signal_source == NULL) {
+      close(fd);
+      return false;
+    }
+  }
+  signal_handlers[signal].callback = callback;
+  signal_handlers[signal].data = data;
+  return true;
+}
+
+void delta_loop_remove(struct LoopSource *source) {
+  if (source == NULL || source->callback == NULL)
+    return;
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+  // Timers and signals own their fd, fd sources belong to the caller
+  if (source->type != LOOP_FD)
+    close(source->fd);
+  source->callback = NULL;
+  source->next_removed = removed_sources;
+  removed_sources = source;
+}
+
+int delta_loop_dispatch(int timeout_ms) {
+  struct epoll_event events[LOOP_MAX_EVENTS];
+  int count = epoll_wait(epoll_fd, events, LOOP_MAX_EVENTS, timeout_ms);
+  if (count == -1)
+    return errno == EINTR ? 0 : -1;
+
+  for (int i = 0; i < count; i++) {
+    struct LoopSource *source = events[i].data.ptr;
+    // The source may have been removed by an earlier callback
+    if (source->callback == NULL)
+      continue;
+    if (source->type == LOOP_TIMER) {
+      uint64_t expirations;
+      if (read(source->fd, &expirations, sizeof(expirations)) !=
+          sizeof(expirations))
+        continue;
+      source->callback(source->data, expirations);
+    } else {
+      source->callback(source->data, events[i].events);
+    }
+  }
+  delta_loop_free_removed();
+  return count;
+}
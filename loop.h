@@ -0,0 +1,97 @@
+/*
+ * epoll based event loop of delta
+ *
+ * Everything delta waits on (the Wayland connection, signals, timers, and
+ * whatever else gets added) is a source of this single loop, so no extra
+ * threads are needed.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_LOOP_H
+#define DELTA_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Called when a source is ready
+ *
+ * @param data pointer given when adding the source
+ * @param events epoll events of a fd source, the number of expirations of a
+ * timer, or the signal number of a signal
+ * */
+typedef void (*LoopCallback)(void *data, uint32_t events);
+
+struct LoopSource;
+
+/* Create the loop, returns false on error */
+bool delta_loop_init(void);
+
+/* Remove all sources and close the loop */
+void delta_loop_finish(void);
+
+/**
+ * Watch a file descriptor
+ *
+ * @param fd file descriptor, still owned by the caller
+ * @param events epoll events to wait for (EPOLLIN, EPOLLOUT, ...)
+ * @param callback called with the events that occurred
+ * @param data passed to the callback
+ * @return the source, or NULL on error
+ * */
+struct LoopSource *delta_loop_add_fd(int fd, uint32_t events,
+                                     LoopCallback callback, void *data);
+
+/* Change the events a fd source waits for, returns false on error */
+bool delta_loop_update_fd(struct LoopSource *source, uint32_t events);
+
+/* Add a (disarmed) timer, returns NULL on error */
+struct LoopSource *delta_loop_add_timer(LoopCallback callback, void *data);
+
+/**
+ * Arm or disarm a timer
+ *
+ * @param source timer source
+ * @param delay_ns time until the first expiration, 0 disarms the timer
+ * @param interval_ns time between further expirations, 0 for a single shot
+ * @return false on error
+ * */
+bool delta_loop_arm_timer(struct LoopSource *source, uint64_t delay_ns,
+                          uint64_t interval_ns);
+
+/**
+ * Handle a signal in the loop instead of asynchronously
+ *
+ * The signal is blocked and delivered through a signalfd, so the callback
+ * runs like any other source and can do anything.
+ *
+ * @return false on error
+ * */
+bool delta_loop_add_signal(int signal, LoopCallback callback, void *data);
+
+/* Stop watching a source, this is safe to call from any callback */
+void delta_loop_remove(struct LoopSource *source);
+
+/**
+ * Wait for sources to become ready and run their callbacks
+ *
+ * @param timeout_ms maximum time to wait, -1 to wait forever
+ * @return number of sources dispatched, or -1 on error
+ * */
+int delta_loop_dispatch(int timeout_ms);
+
+#endif
@@ -0,0 +1,559 @@
+/*
+ * Mock river compositor for measuring delta end to end
+ *
+ * Implements just enough of a compositor to drive a layout generator:
+ * river_layout_manager_v3 from river-layout-v3.xml and a number of fake
+ * wl_outputs, served on a private WAYLAND_DISPLAY socket. It fires storms of
+ * layout_demand and user_command events and measures, for every serial, the
+ * time from sending the demand to receiving the matching commit, including
+ * libwayland marshalling and socket I/O on both sides. No real display is
+ * needed.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+#include "river-layout-v3-server.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+
+/* Give up on a round if delta hasn't committed within this time */
+#define ROUND_TIMEOUT_NS 1000000000ull
+
+/* Usable areas handed out to the fake outputs, in turn */
+static const uint32_t output_sizes[][2] = {
+    {1920, 1080}, {2560, 1440}, {3840, 2160}, {1280, 800}};
+
+/* Commands sent during user_command bursts, in turn */
+static const char *commands[] = {
+    "main_ratio +0.01", "main_count +1", "view_padding +1", "swap_layout",
+    "main_ratio -0.01", "main_count -1", "view_padding -1",
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+struct MockOutput {
+  uint32_t index;
+  uint32_t width;
+  uint32_t height;
+  struct wl_resource *layout; // river_layout_v3 of delta in the measured
+                              // namespace, NULL if none
+
+  uint32_t pending_serial; // Serial of the latest demand
+  uint32_t view_count;     // View count of the latest demand
+  uint32_t pushed;         // Views pushed so far for the latest demand
+  bool waiting;            // Whether the latest demand is not committed yet
+};
+
+/* What happened to a single layout demand, indexed by serial */
+struct Demand {
+  uint32_t output;
+  uint32_t view_count;
+  uint64_t sent_ns;
+  uint64_t latency_ns; // 0 if never committed (e.g. superseded)
+};
+
+enum Phase {
+  WAIT_FOR_LAYOUTS, // Waiting for delta to create a layout on every output
+  DEMANDS,          // Sending bursts of layout demands
+  COMMANDS,         // Sending bursts of user commands
+  DONE,
+};
+
+// Scenario, set from the command line
+static uint32_t output_count = 4;
+static uint32_t rounds = 1000;
+static uint32_t burst = 1;
+static uint32_t command_rounds = 100;
+static uint32_t command_burst = 3;
+static uint32_t max_views = 50;
+static const char *measured_namespace = "swapable";
+static const char *taken_namespace = NULL; // As if another client had it
+
+static struct wl_display *display;
+static struct MockOutput *mock_outputs;
+static struct Demand *demands;
+static uint32_t demand_capacity;
+static uint32_t next_serial = 1;
+static uint32_t next_command = 0;
+static enum Phase phase = WAIT_FOR_LAYOUTS;
+static uint32_t round_number = 0;
+static uint64_t round_started_ns;
+
+// Counters
+static uint64_t commits = 0;
+static uint64_t stale_commits = 0;
+static uint64_t timed_out_rounds = 0;
+static uint64_t protocol_errors = 0;
+static uint64_t commands_sent = 0;
+// Layouts in other namespaces, never demanded
+static uint64_t other_layouts = 0;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void layout_handle_destroy(struct wl_client *client,
+                                  struct wl_resource *resource) {
+  wl_resource_destroy(resource);
+}
+
+static void layout_handle_push_view_dimensions(struct wl_client *client,
+                                               struct wl_resource *resource,
+                                               int32_t x, int32_t y,
+                                               uint32_t width, uint32_t height,
+                                               uint32_t serial) {
+  struct MockOutput *output = wl_resource_get_user_data(resource);
+  // Like river, dimensions for anything but the latest demand are ignored
+  if (resource == output->layout && serial == output->pending_serial)
+    output->pushed++;
+}
+
+static void layout_handle_commit(struct wl_client *client,
+                                 struct wl_resource *resource,
+                                 const char *layout_name, uint32_t serial) {
+  uint64_t now = now_ns();
+  struct MockOutput *output = wl_resource_get_user_data(resource);
+  if (resource != output->layout) {
+    // Layouts of other namespaces are never sent a demand
+    protocol_errors++;
+    wl_resource_post_error(resource, RIVER_LAYOUT_V3_ERROR_ALREADY_COMMITTED,
+                           "no layout demand was sent to this layout");
+    return;
+  }
+  if (serial != output->pending_serial) {
+    stale_commits++;
+    return;
+  }
+  if (!output->waiting) {
+    protocol_errors++;
+    wl_resource_post_error(resource, RIVER_LAYOUT_V3_ERROR_ALREADY_COMMITTED,
+                           "layout demand %u already committed", serial);
+    return;
+  }
+  if (output->pushed != output->view_count) {
+    protocol_errors++;
+    wl_resource_post_error(resource, RIVER_LAYOUT_V3_ERROR_COUNT_MISMATCH,
+                           "pushed %u views for a demand of %u views",
+                           output->pushed, output->view_count);
+    return;
+  }
+  output->waiting = false;
+  demands[serial].latency_ns = now - demands[serial].sent_ns;
+  commits++;
+}
+
+static const struct river_layout_v3_interface layout_implementation = {
+    .destroy = layout_handle_destroy,
+    .push_view_dimensions = layout_handle_push_view_dimensions,
+    .commit = layout_handle_commit,
+};
+
+static void layout_handle_resource_destroy(struct wl_resource *resource) {
+  struct MockOutput *output = wl_resource_get_user_data(resource);
+  if (output->layout == resource) {
+    output->layout = NULL;
+    output->waiting = false;
+  }
+}
+
+static void manager_handle_destroy(struct wl_client *client,
+                                   struct wl_resource *resource) {
+  wl_resource_destroy(resource);
+}
+
+static void manager_handle_get_layout(struct wl_client *client,
+                                      struct wl_resource *resource,
+                                      uint32_t id,
+                                      struct wl_resource *output_resource,
+                                      const char *namespace) {
+  struct MockOutput *output = wl_resource_get_user_data(output_resource);
+  struct wl_resource *layout = wl_resource_create(
+      client, &river_layout_v3_interface, wl_resource_get_version(resource),
+      id);
+  if (layout == NULL) {
+    wl_client_post_no_memory(client);
+    return;
+  }
+  wl_resource_set_implementation(layout, &layout_implementation, output,
+                                 layout_handle_resource_destroy);
+  if (taken_namespace != NULL && strcmp(namespace, taken_namespace) == 0) {
+    river_layout_v3_send_namespace_in_use(layout);
+    return;
+  }
+  // A layout generator may serve several namespaces, only one is measured
+  if (strcmp(namespace, measured_namespace) != 0) {
+    other_layouts++;
+    return;
+  }
+  if (output->layout != NULL) {
+    river_layout_v3_send_namespace_in_use(layout);
+    return;
+  }
+  output->layout = layout;
+}
+
+static const struct river_layout_manager_v3_interface manager_implementation = {
+    .destroy = manager_handle_destroy,
+    .get_layout = manager_handle_get_layout,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+                         uint32_t version, uint32_t id) {
+  struct wl_resource *resource = wl_resource_create(
+      client, &river_layout_manager_v3_interface, version, id);
+  if (resource == NULL) {
+    wl_client_post_no_memory(client);
+    return;
+  }
+  wl_resource_set_implementation(resource, &manager_implementation, NULL,
+                                 NULL);
+}
+
+static void output_handle_release(struct wl_client *client,
+                                  struct wl_resource *resource) {
+  wl_resource_destroy(resource);
+}
+
+static const struct wl_output_interface output_implementation = {
+    .release = output_handle_release,
+};
+
+static void output_bind(struct wl_client *client, void *data,
+                        uint32_t version, uint32_t id) {
+  struct MockOutput *output = data;
+  struct wl_resource *resource =
+      wl_resource_create(client, &wl_output_interface, version, id);
+  if (resource == NULL) {
+    wl_client_post_no_memory(client);
+    return;
+  }
+  wl_resource_set_implementation(resource, &output_implementation, output,
+                                 NULL);
+
+  char name[32];
+  snprintf(name, sizeof(name), "MOCK-%u", output->index + 1);
+  wl_output_send_geometry(resource, 0, 0, 0, 0, WL_OUTPUT_SUBPIXEL_UNKNOWN,
+                          "delta", "mock-river", WL_OUTPUT_TRANSFORM_NORMAL);
+  wl_output_send_mode(resource, WL_OUTPUT_MODE_CURRENT, output->width,
+                      output->height, 60000);
+  if (version >= WL_OUTPUT_NAME_SINCE_VERSION)
+    wl_output_send_name(resource, name);
+  if (version >= WL_OUTPUT_DONE_SINCE_VERSION)
+    wl_output_send_done(resource);
+}
+
+/* Send a layout demand to an output, superseding any pending one */
+static void send_demand(struct MockOutput *output, uint32_t view_count) {
+  if (next_serial >= demand_capacity)
+    return;
+  uint32_t serial = next_serial++;
+  output->pending_serial = serial;
+  output->view_count = view_count;
+  output->pushed = 0;
+  output->waiting = true;
+  demands[serial].output = output->index;
+  demands[serial].view_count = view_count;
+  demands[serial].sent_ns = now_ns();
+  river_layout_v3_send_layout_demand(output->layout, view_count, output->width,
+                                     output->height, 1, serial);
+}
+
+static void send_commands(struct MockOutput *output) {
+  for (uint32_t i = 0; i < command_burst; i++) {
+    // The tags are sent first, like river does
+    if (wl_resource_get_version(output->layout) >=
+        RIVER_LAYOUT_V3_USER_COMMAND_TAGS_SINCE_VERSION)
+      river_layout_v3_send_user_command_tags(output->layout, 1);
+    river_layout_v3_send_user_command(
+        output->layout, commands[next_command++ % ARRAY_LENGTH(commands)]);
+    commands_sent++;
+  }
+}
+
+/* Start the next round of the scenario once the previous one is done */
+static void advance(void) {
+  bool all_layouts = true, all_committed = true;
+  for (uint32_t i = 0; i < output_count; i++) {
+    all_layouts = all_layouts && mock_outputs[i].layout != NULL;
+    all_committed = all_committed && !mock_outputs[i].waiting;
+  }
+
+  if (phase == WAIT_FOR_LAYOUTS) {
+    if (!all_layouts)
+      return;
+    phase = DEMANDS;
+    round_number = 0;
+  } else if (!all_committed) {
+    if (now_ns() - round_started_ns < ROUND_TIMEOUT_NS)
+      return;
+    timed_out_rounds++;
+  }
+  if (!all_layouts) {
+    fputs("ERROR: delta destroyed a layout\n", stderr);
+    phase = DONE;
+    return;
+  }
+
+  if (phase == DEMANDS && round_number == rounds) {
+    phase = COMMANDS;
+    round_number = 0;
+  }
+  if (phase == COMMANDS && round_number == command_rounds) {
+    phase = DONE;
+    return;
+  }
+
+  for (uint32_t i = 0; i < output_count; i++) {
+    struct MockOutput *output = &mock_outputs[i];
+    // Sweep the view count, differently on every output
+    uint32_t view_count = 1 + (round_number + i) % max_views;
+    if (phase == DEMANDS) {
+      for (uint32_t j = 0; j < burst; j++)
+        send_demand(output, view_count + j % 2);
+    } else {
+      send_commands(output);
+      send_demand(output, view_count);
+    }
+  }
+  round_number++;
+  round_started_ns = now_ns();
+}
+
+static int compare_uint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void report(FILE *csv, uint64_t elapsed_ns) {
+  uint64_t *latencies = malloc(next_serial * sizeof(uint64_t));
+  uint64_t count = 0, total = 0;
+  if (csv != NULL)
+    fputs("serial,output,view_count,sent_ns,latency_ns\n", csv);
+  for (uint32_t serial = 1; serial < next_serial; serial++) {
+    struct Demand *demand = &demands[serial];
+    if (csv != NULL) {
+      fprintf(csv, "%u,%u,%u,%lu,", serial, demand->output,
+              demand->view_count,
+              (unsigned long)(demand->sent_ns - demands[1].sent_ns));
+      if (demand->latency_ns != 0)
+        fprintf(csv, "%lu", (unsigned long)demand->latency_ns);
+      fputc('\n', csv);
+    }
+    if (demand->latency_ns != 0 && latencies != NULL) {
+      latencies[count++] = demand->latency_ns;
+      total += demand->latency_ns;
+    }
+  }
+
+  printf("demands sent:      %u\n", next_serial - 1);
+  printf("commands sent:     %lu\n", (unsigned long)commands_sent);
+  printf("commits:           %lu\n", (unsigned long)commits);
+  printf("superseded:        %lu\n",
+         (unsigned long)(next_serial - 1 - commits));
+  printf("stale commits:     %lu\n", (unsigned long)stale_commits);
+  printf("timed out rounds:  %lu\n", (unsigned long)timed_out_rounds);
+  printf("protocol errors:   %lu\n", (unsigned long)protocol_errors);
+  printf("other layouts:     %lu\n", (unsigned long)other_layouts);
+  printf("elapsed:           %.3f s\n", elapsed_ns / 1e9);
+  printf("throughput:        %.0f commits/s\n", commits / (elapsed_ns / 1e9));
+  if (count > 0) {
+    qsort(latencies, count, sizeof(uint64_t), compare_uint64);
+    printf("latency mean:      %.1f us\n", total / 1e3 / count);
+    printf("latency p50:       %.1f us\n", latencies[count / 2] / 1e3);
+    printf("latency p90:       %.1f us\n", latencies[count * 90 / 100] / 1e3);
+    printf("latency p99:       %.1f us\n", latencies[count * 99 / 100] / 1e3);
+    printf("latency max:       %.1f us\n", latencies[count - 1] / 1e3);
+  }
+  free(latencies);
+}
+
+static pid_t spawn_delta(const char *socket, char **argv) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    setenv("WAYLAND_DISPLAY", socket, 1);
+    execv(argv[0], argv);
+    fprintf(stderr, "ERROR: Could not run %s\n", argv[0]);
+    _exit(EXIT_FAILURE);
+  }
+  return pid;
+}
+
+static void mock_print_help(void) {
+  puts("Mock river compositor for benchmarking delta end to end\n"
+       "\n"
+       "Usage: mock-river [options] [-- <delta> [delta options]]\n"
+       "\t-h,--help: Print this help message and exit\n"
+       "\t-outputs <count>: Number of fake outputs (default 4)\n"
+       "\t-rounds <count>: Rounds of layout demands (default 1000)\n"
+       "\t-burst <count>: Demands sent to each output per round, all but the "
+       "last\n\t\tare superseded (default 1)\n"
+       "\t-command-rounds <count>: Rounds of user commands (default 100)\n"
+       "\t-command-burst <count>: Commands sent to each output per command "
+       "round,\n\t\tfollowed by a single demand (default 3)\n"
+       "\t-max-views <count>: View counts sweep from 1 to this (default 50)\n"
+       "\t-csv <file>: Write the latency of every serial to a CSV file\n"
+       "\t-namespace <name>: Namespace whose layouts are measured, layouts "
+       "in\n\t\tother namespaces are accepted but idle (default swapable)\n"
+       "\t-taken <name>: Namespace answered with namespace_in_use, as if "
+       "another\n\t\tclient had it\n"
+       "\n"
+       "If a delta command is given, it is started on the private socket and\n"
+       "stopped afterwards, otherwise the socket name is printed and a layout\n"
+       "generator has to be started by hand.");
+}
+
+int main(int argc, char *argv[]) {
+  const char *csv_path = NULL;
+  char **delta_argv = NULL;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-h") == 0 || strcmp(argv[arg], "--help") == 0) {
+      mock_print_help();
+      return EXIT_SUCCESS;
+    }
+    if (strcmp(argv[arg], "--") == 0) {
+      if (arg + 1 < argc)
+        delta_argv = &argv[arg + 1];
+      break;
+    }
+    if (arg == argc - 1) {
+      fputs("ERROR: Argument with no value. All arguments must have values.\n",
+            stderr);
+      return EXIT_FAILURE;
+    }
+    const char *value = argv[++arg];
+    if (strcmp(argv[arg - 1], "-outputs") == 0)
+      output_count = MAX(atoi(value), 1);
+    else if (strcmp(argv[arg - 1], "-rounds") == 0)
+      rounds = MAX(atoi(value), 0);
+    else if (strcmp(argv[arg - 1], "-burst") == 0)
+      burst = MAX(atoi(value), 1);
+    else if (strcmp(argv[arg - 1], "-command-rounds") == 0)
+      command_rounds = MAX(atoi(value), 0);
+    else if (strcmp(argv[arg - 1], "-command-burst") == 0)
+      command_burst = MAX(atoi(value), 0);
+    else if (strcmp(argv[arg - 1], "-max-views") == 0)
+      max_views = MAX(atoi(value), 1);
+    else if (strcmp(argv[arg - 1], "-csv") == 0)
+      csv_path = value;
+    else if (strcmp(argv[arg - 1], "-namespace") == 0)
+      measured_namespace = value;
+    else if (strcmp(argv[arg - 1], "-taken") == 0)
+      taken_namespace = value;
+    else {
+      fprintf(stderr, "ERROR: Unknown argument: %s\n", argv[arg - 1]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // libwayland puts its socket in XDG_RUNTIME_DIR, which a headless
+  // environment may not have
+  char runtime_dir[] = "/tmp/mock-river-XXXXXX";
+  bool own_runtime_dir = false;
+  if (getenv("XDG_RUNTIME_DIR") == NULL) {
+    if (mkdtemp(runtime_dir) == NULL) {
+      fputs("ERROR: Could not create a runtime directory\n", stderr);
+      return EXIT_FAILURE;
+    }
+    setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+    own_runtime_dir = true;
+  }
+
+  demand_capacity =
+      1 + output_count * (rounds * burst + command_rounds) + output_count;
+  mock_outputs = calloc(output_count, sizeof(struct MockOutput));
+  demands = calloc(demand_capacity, sizeof(struct Demand));
+  display = wl_display_create();
+  if (mock_outputs == NULL || demands == NULL || display == NULL) {
+    fputs("Failed to allocate.\n", stderr);
+    return EXIT_FAILURE;
+  }
+  const char *socket = wl_display_add_socket_auto(display);
+  if (socket == NULL) {
+    fputs("ERROR: Could not create a Wayland socket\n", stderr);
+    return EXIT_FAILURE;
+  }
+
+  wl_global_create(display, &river_layout_manager_v3_interface, 2, NULL,
+                   manager_bind);
+  for (uint32_t i = 0; i < output_count; i++) {
+    mock_outputs[i].index = i;
+    mock_outputs[i].width = output_sizes[i % ARRAY_LENGTH(output_sizes)][0];
+    mock_outputs[i].height = output_sizes[i % ARRAY_LENGTH(output_sizes)][1];
+    wl_global_create(display, &wl_output_interface, 4, &mock_outputs[i],
+                     output_bind);
+  }
+
+  pid_t delta = -1;
+  if (delta_argv != NULL)
+    delta = spawn_delta(socket, delta_argv);
+  else
+    fprintf(stderr, "Listening on WAYLAND_DISPLAY=%s\n", socket);
+
+  struct wl_event_loop *event_loop = wl_display_get_event_loop(display);
+  uint64_t started = 0;
+  while (phase != DONE) {
+    if (delta > 0 && waitpid(delta, NULL, WNOHANG) == delta) {
+      fputs("ERROR: delta exited\n", stderr);
+      delta = -1;
+      break;
+    }
+    if (phase == WAIT_FOR_LAYOUTS)
+      started = now_ns();
+    advance();
+    // Flush right away so the time to the first byte on the socket is
+    // included in the measured latency
+    wl_display_flush_clients(display);
+    wl_event_loop_dispatch(event_loop, 100);
+  }
+  uint64_t elapsed = now_ns() - started;
+
+  FILE *csv = NULL;
+  if (csv_path != NULL && (csv = fopen(csv_path, "w")) == NULL)
+    fprintf(stderr, "ERROR: Could not open %s\n", csv_path);
+  if (phase == DONE)
+    report(csv, elapsed);
+  if (csv != NULL)
+    fclose(csv);
+
+  if (delta > 0) {
+    kill(delta, SIGTERM);
+    waitpid(delta, NULL, 0);
+  }
+  wl_display_destroy(display);
+  if (own_runtime_dir)
+    rmdir(runtime_dir);
+  free(demands);
+  free(mock_outputs);
+  return phase == DONE && protocol_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
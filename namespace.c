@@ -0,0 +1,132 @@
+/*
+ * Layout namespaces served by delta
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "layout.h"
+#include "namespace.h"
+
+/* Find a layout named by part of an option, printing it if there is none */
+static bool delta_namespace_find_layout(const char *spec, const char *name,
+                                        size_t length, uint32_t *style) {
+  if (delta_layout_find(name, length, style))
+    return true;
+  fprintf(stderr, "ERROR: Unknown layout in namespace %s: '%.*s'\n", spec,
+          (int)length, name);
+  return false;
+}
+
+bool delta_namespace_parse(const char *spec,
+                           const struct LayoutParams *defaults,
+                           const struct LayoutCycle *layouts,
+                           struct Namespace *namespace) {
+  const char *options = strchr(spec, ':');
+  size_t name_length =
+      options != NULL ? (size_t)(options - spec) : strlen(spec);
+  if (name_length == 0 || name_length >= NAMESPACE_NAME_LENGTH) {
+    fprintf(stderr, "ERROR: Invalid namespace name: '%.*s'\n",
+            (int)name_length, spec);
+    return false;
+  }
+  for (size_t i = 0; i < name_length; i++) {
+    if (isspace((unsigned char)spec[i])) {
+      fprintf(stderr, "ERROR: Invalid namespace name: '%.*s'\n",
+              (int)name_length, spec);
+      return false;
+    }
+  }
+
+  *namespace = (struct Namespace){.defaults = *defaults, .layouts = *layouts};
+  memcpy(namespace->name, spec, name_length);
+  bool style_given = false;
+
+  for (const char *option = options; option != NULL && *option != '\0';) {
+    option++;
+    const char *end = strchr(option, ',');
+    if (end == NULL)
+      end = option + strlen(option);
+    const char *value = memchr(option, '=', end - option);
+    if (value == NULL) {
+      fprintf(stderr, "ERROR: Namespace option without a value: '%.*s'\n",
+              (int)(end - option), option);
+      return false;
+    }
+    size_t key_length = value - option;
+    size_t value_length = end - ++value;
+
+    uint32_t number = 0, ratio = 0;
+    bool numeric = delta_command_number(value, value_length, &number);
+    bool fraction = delta_command_ratio(value, value_length, &ratio);
+    if (key_length == 6 && strncmp(option, "layout", 6) == 0) {
+      if (!delta_namespace_find_layout(spec, value, value_length,
+                                       &namespace->defaults.layout_style))
+        return false;
+      style_given = true;
+    } else if (key_length == 7 && strncmp(option, "layouts", 7) == 0) {
+      namespace->layouts = (struct LayoutCycle){0};
+      for (const char *name = value;;) {
+        const char *plus = memchr(name, '+', end - name);
+        const char *name_end = plus != NULL ? plus : end;
+        uint32_t style;
+        if (!delta_namespace_find_layout(spec, name, name_end - name, &style))
+          return false;
+        delta_layout_cycle_add(&namespace->layouts, style);
+        if (plus == NULL)
+          break;
+        name = plus + 1;
+      }
+    } else if (numeric && key_length == 10 &&
+               strncmp(option, "main-count", 10) == 0) {
+      namespace->defaults.main_count = number;
+    } else if (fraction && key_length == 10 &&
+               strncmp(option, "main-ratio", 10) == 0 &&
+               ratio <= LAYOUT_RATIO_ONE) {
+      namespace->defaults.main_ratio = ratio;
+    } else if (numeric && key_length == 12 &&
+               strncmp(option, "view-padding", 12) == 0) {
+      namespace->defaults.view_padding = number;
+    } else if (numeric && key_length == 13 &&
+               strncmp(option, "outer-padding", 13) == 0) {
+      namespace->defaults.outer_padding = number;
+    } else {
+      fprintf(stderr, "ERROR: Invalid namespace option: '%.*s'\n",
+              (int)(end - option), option);
+      return false;
+    }
+    option = end;
+  }
+
+  if (delta_layout_allowed(namespace->layouts.styles,
+                           namespace->defaults.layout_style))
+    return true;
+  if (style_given) {
+    fprintf(stderr, "ERROR: The layout of namespace %s isn't allowed in it\n",
+            namespace->name);
+    return false;
+  }
+  // Only reached with some layouts allowed, start with the first of them
+  namespace->defaults.layout_style = namespace->layouts.order[0];
+  return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Layout namespaces served by delta
+ *
+ * River picks the layout generator of an output by the namespace it is
+ * asked for, e.g. with `riverctl default-layout swapable`. A single delta
+ * can serve several namespaces, each with its own default parameters and
+ * set of layouts, so that differently configured layouts don't need a delta
+ * (and a Wayland connection) each. Every output gets a layout object in
+ * every namespace, and the parameters of each are kept separately.
+ *
+ * A namespace is given as its name, optionally followed by a colon and a
+ * comma separated list of options:
+ *
+ *   presenter:layouts=monocle+grid,outer-padding=0
+ *
+ *   layout=<layout>         Layout of new outputs (the first allowed one if
+ *                           not given)
+ *   layouts=<layout>+...    Layouts set_layout, swap_layout and
+ *                           toggle_monocle may pick, swap_layout going
+ *                           through them in this order (by default those of
+ *                           the config file, or all of them)
+ *   main-count=<count>, main-ratio=<ratio>, view-padding=<padding>,
+ *   outer-padding=<padding> Defaults of new outputs and of reset
+ *                           Counts and paddings are whole numbers, ratios
+ *                           go from 0 to 1 with at most six decimals
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_NAMESPACE_H
+#define DELTA_NAMESPACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "layout.h"
+
+/* Namespace served when none is given */
+#define DEFAULT_NAMESPACE "swapable"
+
+/* Most namespaces served at once */
+#define NAMESPACE_MAX_COUNT 8
+
+/* Longest namespace name, including the terminator */
+#define NAMESPACE_NAME_LENGTH 32
+
+struct Namespace {
+  char name[NAMESPACE_NAME_LENGTH];
+  struct LayoutParams defaults; // Parameters of new outputs, and of reset
+  struct LayoutCycle layouts;   // Layouts commands may pick
+  bool in_use; // Taken by another client, so no longer asked for
+};
+
+/**
+ * Parse a namespace given on the command line
+ *
+ * Layouts are looked up when parsing, so plugins and programs have to be
+ * loaded before.
+ *
+ * @param spec name and options, see above
+ * @param defaults parameters of options that aren't given
+ * @param layouts layouts if the option isn't given
+ * @param namespace filled in
+ * @return false if the namespace is invalid, which is printed
+ * */
+bool delta_namespace_parse(const char *spec,
+                           const struct LayoutParams *defaults,
+                           const struct LayoutCycle *layouts,
+                           struct Namespace *namespace);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Loading of layouts from plugins
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "layout.h"
+#include "plugin.h"
+
+/* Names have to be a single word to be usable with set_layout */
+static bool delta_plugin_valid_name(const char *name) {
+  if (name == NULL || name[0] == '\0')
+    return false;
+  for (const char *c = name; *c != '\0'; c++) {
+    if (isspace((unsigned char)*c) || *c == ';')
+      return false;
+  }
+  return true;
+}
+
+bool delta_plugin_load(const char *path) {
+  // Without a '/', dlopen would search the library path instead
+  if (strchr(path, '/') == NULL) {
+    fprintf(stderr, "ERROR: Layout plugin path %s has no '/'\n", path);
+    return false;
+  }
+  void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    fprintf(stderr, "ERROR: Could not load layout plugin: %s\n", dlerror());
+    return false;
+  }
+  const struct LayoutPlugin *plugin = dlsym(handle, LAYOUT_PLUGIN_SYMBOL);
+  if (plugin == NULL) {
+    fprintf(stderr, "ERROR: %s is not a layout plugin (no %s)\n", path,
+            LAYOUT_PLUGIN_SYMBOL);
+    dlclose(handle);
+    return false;
+  }
+  if (plugin->version != LAYOUT_PLUGIN_VERSION) {
+    fprintf(stderr,
+            "ERROR: Layout plugin %s is for version %u of the interface, "
+            "delta uses version %u\n",
+            path, plugin->version, LAYOUT_PLUGIN_VERSION);
+    dlclose(handle);
+    return false;
+  }
+
+  uint32_t registered = 0;
+  for (uint32_t i = 0; i < plugin->count; i++) {
+    const struct LayoutDescriptor *layout = &plugin->layouts[i];
+    uint32_t style;
+    if (!delta_plugin_valid_name(layout->name) || layout->symbol == NULL ||
+        layout->compute == NULL) {
+      fprintf(stderr, "ERROR: Layout %u of plugin %s is invalid\n", i, path);
+    } else if (!delta_layout_register(layout, &style)) {
+      fprintf(stderr,
+              "ERROR: Could not add layout %s of plugin %s, the name is taken "
+              "or there are too many layouts\n",
+              layout->name, path);
+    } else {
+      registered++;
+    }
+  }
+
+  // The registry points into the plugin from now on, so it stays loaded
+  if (registered == 0) {
+    dlclose(handle);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * Loading of layouts from plugins
+ *
+ * A plugin is a shared object exporting a struct LayoutPlugin (see
+ * layout.h) named delta_layout_plugin. Its layouts are added to the
+ * registry, after the built-in ones and those of plugins loaded before, and
+ * can then be used like any other layout.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_PLUGIN_H
+#define DELTA_PLUGIN_H
+
+#include <stdbool.h>
+
+/**
+ * Load a plugin and register its layouts
+ *
+ * Layouts whose name is already taken are skipped. Plugins are never
+ * unloaded.
+ *
+ * @param path path of the shared object, containing at least one '/'
+ * @return false if no layout could be registered, problems are printed
+ * */
+bool delta_plugin_load(const char *path);
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Fixed pool of worker threads computing layouts
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+#define MIN(a, b) (a < b ? a : b)
+
+static pthread_t workers[POOL_MAX_WORKERS];
+static uint32_t worker_count = 0;
+static atomic_bool stopping = false;
+
+/* Posted once for every worker that should look for jobs */
+static sem_t wake;
+/* Posted by the workers for every job they finish */
+static sem_t finished_jobs;
+
+/* The current batch. run, data and completed only change between batches,
+ * and are published to the workers by the store to cursor starting a batch.
+ */
+static PoolCallback batch_run;
+static void *batch_data;
+/* Index of the next job to claim in the low 32 bits, and number of jobs in
+ * the high 32 bits, so that claiming a job can't race with a new batch */
+static _Atomic uint64_t cursor = 0;
+
+/* The queue of finished jobs: the index (plus one) of each job in the order
+ * they finished, 0 for a slot that isn't filled yet. finished_count is the
+ * next slot to fill. */
+static _Atomic uint32_t *completed = NULL;
+static uint32_t completed_capacity = 0;
+static _Atomic uint32_t finished_count = 0;
+
+/* Claim the next job of the current batch, false if all are taken */
+static bool delta_pool_claim(uint32_t *index) {
+  uint64_t current = atomic_load_explicit(&cursor, memory_order_acquire);
+  do {
+    uint32_t next = (uint32_t)current, count = (uint32_t)(current >> 32);
+    if (next >= count)
+      return false;
+    *index = next;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &cursor, &current, current + 1, memory_order_acq_rel,
+      memory_order_acquire));
+  return true;
+}
+
+/* Queue a job that has run */
+static void delta_pool_complete(uint32_t index) {
+  uint32_t slot =
+      atomic_fetch_add_explicit(&finished_count, 1, memory_order_relaxed);
+  atomic_store_explicit(&completed[slot], index + 1, memory_order_release);
+}
+
+static void *delta_pool_worker(void *arg) {
+  for (;;) {
+    while (sem_wait(&wake) == -1 && errno == EINTR)
+      ;
+    if (atomic_load(&stopping))
+      return NULL;
+    // Wake ups left over from earlier batches find nothing to claim
+    uint32_t index;
+    while (delta_pool_claim(&index)) {
+      batch_run(batch_data, index);
+      delta_pool_complete(index);
+      sem_post(&finished_jobs);
+    }
+  }
+}
+
+bool delta_pool_init(uint32_t count) {
+  count = MIN(count, POOL_MAX_WORKERS);
+  if (count == 0)
+    return true;
+  if (sem_init(&wake, 0, 0) == -1 || sem_init(&finished_jobs, 0, 0) == -1) {
+    fprintf(stderr, "ERROR: Could not create semaphores: %s\n",
+            strerror(errno));
+    return false;
+  }
+
+  // Signals are handled by the loop, the workers never take any
+  sigset_t all, previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  atomic_store(&stopping, false);
+  for (; worker_count < count; worker_count++) {
+    int error = pthread_create(&workers[worker_count], NULL,
+                               delta_pool_worker, NULL);
+    if (error != 0) {
+      fprintf(stderr, "ERROR: Could not start worker thread: %s\n",
+              strerror(error));
+      break;
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+  if (worker_count < count) {
+    delta_pool_finish();
+    return false;
+  }
+  return true;
+}
+
+void delta_pool_finish(void) {
+  if (worker_count == 0)
+    return;
+  atomic_store(&stopping, true);
+  for (uint32_t i = 0; i < worker_count; i++)
+    sem_post(&wake);
+  for (uint32_t i = 0; i < worker_count; i++)
+    pthread_join(workers[i], NULL);
+  worker_count = 0;
+  sem_destroy(&wake);
+  sem_destroy(&finished_jobs);
+  free(completed);
+  completed = NULL;
+  completed_capacity = 0;
+}
+
+uint32_t delta_pool_worker_count(void) { return worker_count; }
+
+bool delta_pool_run(uint32_t count, PoolCallback run, PoolCallback done,
+                    void *data) {
+  // Nothing to share, skip waking anyone
+  if (worker_count == 0 || count <= 1) {
+    for (uint32_t i = 0; i < count; i++) {
+      run(data, i);
+      done(data, i);
+    }
+    return true;
+  }
+
+  if (count > completed_capacity) {
+    _Atomic uint32_t *queue = malloc(count * sizeof(*queue));
+    if (queue == NULL)
+      return false;
+    free(completed);
+    completed = queue;
+    completed_capacity = count;
+  }
+  for (uint32_t i = 0; i < count; i++)
+    atomic_store_explicit(&completed[i], 0, memory_order_relaxed);
+  atomic_store_explicit(&finished_count, 0, memory_order_relaxed);
+  batch_run = run;
+  batch_data = data;
+  atomic_store_explicit(&cursor, (uint64_t)count << 32, memory_order_release);
+  // This thread takes jobs as well
+  for (uint32_t i = 0; i < MIN(worker_count, count - 1); i++)
+    sem_post(&wake);
+
+  for (uint32_t head = 0; head < count;) {
+    uint32_t finished =
+        atomic_load_explicit(&completed[head], memory_order_acquire);
+    uint32_t index;
+    if (finished != 0) {
+      done(data, finished - 1);
+      head++;
+    } else if (delta_pool_claim(&index)) {
+      run(data, index);
+      delta_pool_complete(index);
+    } else {
+      // The job is still running on a worker, which posts once it is queued
+      while (sem_wait(&finished_jobs) == -1 && errno == EINTR)
+        ;
+    }
+  }
+  // Forget the posts of jobs that were already seen finished above
+  while (sem_trywait(&finished_jobs) == 0)
+    ;
+  return true;
+}
@@ -0,0 +1,76 @@
+/*
+ * Fixed pool of worker threads computing layouts
+ *
+ * When several outputs demand a layout at once (e.g. on a tag switch), their
+ * layouts don't depend on each other, so they are computed in parallel. The
+ * thread handling Wayland hands out a batch of jobs and works on them too,
+ * and gets the finished jobs back one by one, in the order they finish,
+ * through a lock-free queue. Everything touching Wayland stays on that
+ * thread, so the layouts are still pushed and committed in order.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_POOL_H
+#define DELTA_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most worker threads the pool starts */
+#define POOL_MAX_WORKERS 16
+
+/**
+ * Called for every job of a batch
+ *
+ * @param data pointer given with the batch
+ * @param index index of the job in the batch
+ * */
+typedef void (*PoolCallback)(void *data, uint32_t index);
+
+/**
+ * Start the worker threads
+ *
+ * @param workers number of threads, at most POOL_MAX_WORKERS. With 0 every
+ * job simply runs on the calling thread.
+ * @return false on error, the pool then has no workers
+ * */
+bool delta_pool_init(uint32_t workers);
+
+/* Stop and join the worker threads */
+void delta_pool_finish(void);
+
+/* Number of worker threads running */
+uint32_t delta_pool_worker_count(void);
+
+/**
+ * Run a batch of jobs, and wait for all of them
+ *
+ * Jobs run on the workers and on the calling thread. done is called on the
+ * calling thread for each job once it has run, in the order they finish,
+ * and never at the same time as another call to done.
+ *
+ * @param count number of jobs
+ * @param run runs a job, on any thread, at the same time as other jobs
+ * @param done called on the calling thread for each finished job
+ * @param data passed to run and done
+ * @return false if the batch could not be handed to the workers, no job has
+ * run then
+ * */
+bool delta_pool_run(uint32_t count, PoolCallback run, PoolCallback done,
+                    void *data);
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Static probes along the handling of layout demands
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE // gettid
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "probe.h"
+
+struct ProbeEvent {
+  uint64_t timestamp_ns;
+  uint32_t thread;
+  uint8_t point;
+  char phase;
+  uint32_t values[3];
+};
+
+/* Names of the points, and of the values recorded by each (NULL if unused) */
+static const struct {
+  const char *name;
+  const char *values[3];
+} probe_points[] = {
+    [PROBE_DEMAND] = {"layout_demand", {"output", "view_count", "serial"}},
+    [PROBE_COMPUTE] = {"compute", {"view_count", "style", NULL}},
+    [PROBE_PUSH] = {"push_views", {"view_count", "serial", NULL}},
+    [PROBE_COMMIT] = {"commit", {"serial", NULL, NULL}},
+    [PROBE_COMMAND] = {"user_command", {"output", "tags", NULL}},
+    [PROBE_FLUSH] = {"flush", {NULL, NULL, NULL}},
+};
+
+bool delta_probe_recording = false;
+
+static struct ProbeEvent *ring = NULL;
+static atomic_uint_fast64_t next_event = 0; // Total events recorded
+
+/* Id of the calling thread, looked up once */
+static _Thread_local uint32_t thread_id = 0;
+
+void delta_probe_record(enum ProbePoint point, char phase, uint32_t a,
+                        uint32_t b, uint32_t c) {
+  if (thread_id == 0)
+    thread_id = gettid();
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  uint64_t index =
+      atomic_fetch_add_explicit(&next_event, 1, memory_order_relaxed);
+  ring[index % PROBE_RING_SIZE] = (struct ProbeEvent){
+      .timestamp_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec,
+      .thread = thread_id,
+      .point = point,
+      .phase = phase,
+      .values = {a, b, c},
+  };
+}
+
+bool delta_probe_start(void) {
+  if (ring == NULL)
+    ring = calloc(PROBE_RING_SIZE, sizeof(struct ProbeEvent));
+  if (ring == NULL)
+    return false;
+  delta_probe_recording = true;
+  return true;
+}
+
+bool delta_probe_export(const char *path) {
+  if (ring == NULL) {
+    fputs("ERROR: Probes aren't recorded\n", stderr);
+    return false;
+  }
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "ERROR: Could not write probes to %s: %s\n", path,
+            strerror(errno));
+    return false;
+  }
+
+  uint64_t end = atomic_load_explicit(&next_event, memory_order_relaxed);
+  uint64_t start = end > PROBE_RING_SIZE ? end - PROBE_RING_SIZE : 0;
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+  for (uint64_t i = start; i < end; i++) {
+    const struct ProbeEvent *event = &ring[i % PROBE_RING_SIZE];
+    // Timestamps are in microseconds
+    fprintf(file,
+            "{\"name\":\"%s\",\"cat\":\"delta\",\"ph\":\"%c\","
+            "\"ts\":%lu.%03u,\"pid\":%d,\"tid\":%u",
+            probe_points[event->point].name, event->phase,
+            (unsigned long)(event->timestamp_ns / 1000),
+            (unsigned)(event->timestamp_ns % 1000), getpid(), event->thread);
+    if (event->phase == PROBE_PHASE_mark)
+      fputs(",\"s\":\"t\"", file);
+    // Spans have their values on the begin event
+    if (event->phase != PROBE_PHASE_end) {
+      fputs(",\"args\":{", file);
+      for (uint32_t j = 0; j < 3; j++) {
+        const char *name = probe_points[event->point].values[j];
+        if (name != NULL)
+          fprintf(file, "%s\"%s\":%u", j > 0 ? "," : "", name,
+                  event->values[j]);
+      }
+      fputc('}', file);
+    }
+    fputs(i + 1 < end ? "},\n" : "}\n", file);
+  }
+  fputs("]}\n", file);
+
+  if (fclose(file) != 0) {
+    fprintf(stderr, "ERROR: Could not write probes to %s: %s\n", path,
+            strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void delta_probe_stop(void) {
+  delta_probe_recording = false;
+  free(ring);
+  ring = NULL;
+  atomic_store(&next_event, 0);
+}
@@ -0,0 +1,122 @@
+/*
+ * Static probes along the handling of layout demands
+ *
+ * The points where a layout demand arrives, its layout is computed, pushed
+ * and committed, a user command is parsed and requests are flushed to the
+ * compositor are marked with DELTA_PROBE. Each of them is:
+ *
+ * - a USDT probe (provider delta, named <point>_<phase>, e.g.
+ *   compute_begin) when delta is built with <sys/sdt.h> available, which
+ *   perf and bpftrace can attach to. A probe nobody attached to is a nop.
+ * - an event in an in-memory ring buffer once delta_probe_start was called,
+ *   keeping the latest PROBE_RING_SIZE events. delta_probe_export writes
+ *   them as Chrome trace JSON, which chrome://tracing and Perfetto open.
+ *
+ * Without either, a probe costs a load and a predicted branch.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_PROBE_H
+#define DELTA_PROBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DELTA_USDT(name, a, b, c) DTRACE_PROBE3(delta, name, a, b, c)
+#endif
+#endif
+#ifndef DELTA_USDT
+#define DELTA_USDT(name, a, b, c)
+#endif
+
+/* Events kept in the ring buffer, older ones are overwritten */
+#define PROBE_RING_SIZE 65536
+
+/* Where probes are placed, the values recorded by each are listed with
+ * delta_probe_record */
+enum ProbePoint {
+  PROBE_DEMAND,  // A layout demand arrived
+  PROBE_COMPUTE, // Computing a layout, on any thread
+  PROBE_PUSH,    // Pushing the views of a layout
+  PROBE_COMMIT,  // Committed a layout
+  PROBE_COMMAND, // Parsing and applying a user command
+  PROBE_FLUSH,   // Flushing requests to the compositor
+};
+
+#define PROBE_POINT_demand PROBE_DEMAND
+#define PROBE_POINT_compute PROBE_COMPUTE
+#define PROBE_POINT_push PROBE_PUSH
+#define PROBE_POINT_commit PROBE_COMMIT
+#define PROBE_POINT_command PROBE_COMMAND
+#define PROBE_POINT_flush PROBE_FLUSH
+
+/* Phases of a probe, as in the Chrome trace format */
+#define PROBE_PHASE_begin 'B' // Start of a span, ended by the same point
+#define PROBE_PHASE_end 'E'
+#define PROBE_PHASE_mark 'i' // Something that happened at once
+
+/* Whether the ring buffer is recording, only read through DELTA_PROBE */
+extern bool delta_probe_recording;
+
+/**
+ * Fire a probe
+ *
+ * @param point one of demand, compute, push, commit, command, flush
+ * @param phase begin, end or mark
+ * @param a, b, c values recorded with the event, see delta_probe_record
+ * */
+#define DELTA_PROBE(point, phase, a, b, c)                                     \
+  do {                                                                         \
+    DELTA_USDT(point##_##phase, a, b, c);                                      \
+    if (__builtin_expect(delta_probe_recording, 0))                            \
+      delta_probe_record(PROBE_POINT_##point, PROBE_PHASE_##phase, a, b, c);   \
+  } while (0)
+
+/**
+ * Add an event to the ring buffer, thread safe
+ *
+ * The values are, by point:
+ *   demand: output id, view count, serial
+ *   compute: view count, layout style, 0
+ *   push: view count, serial, 0
+ *   commit: serial, 0, 0
+ *   command: output id, tags, 0
+ *   flush: 0, 0, 0
+ * */
+void delta_probe_record(enum ProbePoint point, char phase, uint32_t a,
+                        uint32_t b, uint32_t c);
+
+/* Start recording to the ring buffer, false if it couldn't be allocated */
+bool delta_probe_start(void);
+
+/**
+ * Write the events in the ring buffer, oldest first, as Chrome trace JSON
+ *
+ * Must not be called while layouts are computed on the worker pool.
+ *
+ * @param path file to write, replaced
+ * @return false on error, which is printed
+ * */
+bool delta_probe_export(const char *path);
+
+/* Stop recording and free the ring buffer */
+void delta_probe_stop(void);
+
+#endif
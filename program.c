@@ -0,0 +1,1149 @@
+/*
+ * Compiler and interpreter of layout programs, see program.h
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "geometry.h"
+#include "layout.h"
+#include "program.h"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+#define CLAMP(a, b, c) (MIN(MAX(b, c), MAX(MIN(b, c), a)))
+
+/* Largest program file read */
+#define PROGRAM_MAX_SOURCE 65536
+
+/* Longest name and symbol, including the terminator */
+#define PROGRAM_NAME_LENGTH 32
+
+/* Most variables, the built-in ones included */
+#define PROGRAM_MAX_VARIABLES 64
+
+/* Most view statements */
+#define PROGRAM_MAX_RULES 16
+
+/* Deepest the evaluation stack of an expression gets */
+#define PROGRAM_MAX_STACK 32
+
+/* Deepest nesting of parentheses, operators and calls while parsing */
+#define PROGRAM_MAX_NESTING 64
+
+/* Views evaluated together, at most 64 so that each has a bit in a
+ * uint64_t */
+#define PROGRAM_CHUNK 64
+
+/* Most instructions of a program */
+#define PROGRAM_MAX_INSTRUCTIONS 65536
+
+enum ProgramOp {
+  OP_RETURN, // Ends an expression, its value is on top of the stack
+  OP_PUSH,   // Push the operand
+  OP_NEGATE,
+  OP_NOT,
+  OP_SQRT,
+  OP_SELECT, // The second or third value from the top, depending on the first
+  OP_OFFSET,
+  OP_PART,
+  // The operators below take two values, the second one is the operand of
+  // the instruction
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_MODULO,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_AND,
+  OP_OR,
+  OP_MIN,
+  OP_MAX,
+  OP_SCALE,
+};
+
+/* Where the operand of an instruction comes from */
+enum ProgramOperand {
+  OPERAND_STACK,    // Popped from the stack
+  OPERAND_CONSTANT, // The argument
+  OPERAND_VARIABLE, // The variable numbered by the argument
+};
+
+struct ProgramInstruction {
+  uint16_t op;      // enum ProgramOp
+  uint16_t operand; // enum ProgramOperand
+  uint32_t argument;
+};
+
+/* The variables every program has, lets are numbered after them */
+enum ProgramVariable {
+  VARIABLE_COUNT,
+  VARIABLE_INDEX,
+  VARIABLE_WIDTH,
+  VARIABLE_HEIGHT,
+  VARIABLE_MAIN_COUNT,
+  VARIABLE_MAIN_RATIO,
+  VARIABLE_BUILTIN_COUNT,
+};
+
+static const char *const builtin_variables[VARIABLE_BUILTIN_COUNT] = {
+    [VARIABLE_COUNT] = "count",
+    [VARIABLE_INDEX] = "index",
+    [VARIABLE_WIDTH] = "width",
+    [VARIABLE_HEIGHT] = "height",
+    [VARIABLE_MAIN_COUNT] = "main_count",
+    [VARIABLE_MAIN_RATIO] = "main_ratio",
+};
+
+struct ProgramFunction {
+  const char *name;
+  uint32_t arity;
+  enum ProgramOp op;
+};
+
+static const struct ProgramFunction functions[] = {
+    {"min", 2, OP_MIN},       {"max", 2, OP_MAX},
+    {"sqrt", 1, OP_SQRT},     {"scale", 2, OP_SCALE},
+    {"offset", 3, OP_OFFSET}, {"part", 3, OP_PART},
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+/* The parts of a view statement, in the order they are written */
+enum ProgramPart {
+  PART_CONDITION,
+  PART_X,
+  PART_Y,
+  PART_WIDTH,
+  PART_HEIGHT,
+  PART_COUNT,
+};
+
+struct ProgramRule {
+  // Start of the code of each part, the condition of a view statement
+  // without one is just a 1
+  uint32_t parts[PART_COUNT];
+  // Bit of every part that depends on the index, the others are only
+  // evaluated once per demand
+  uint32_t varying;
+};
+
+struct LayoutProgram {
+  // First, so that the registry entry leads back to the program
+  struct LayoutDescriptor descriptor;
+  char name[PROGRAM_NAME_LENGTH];
+  char symbol[PROGRAM_NAME_LENGTH];
+  uint32_t let_count;
+  uint32_t lets[PROGRAM_MAX_VARIABLES]; // Start of the code of each let
+  uint32_t rule_count;
+  struct ProgramRule rules[PROGRAM_MAX_RULES];
+  uint32_t instruction_count;
+  struct ProgramInstruction code[];
+};
+
+/* Values wrap around instead of overflowing, so that no program is undefined
+ * behavior */
+static inline int64_t wrap(uint64_t value) { return (int64_t)value; }
+
+/* Whether both values fit a 32 bit division, which is a lot faster than a
+ * 64 bit one on many CPUs, and is what sizes and counts need */
+static inline bool delta_program_small(int64_t a, int64_t b) {
+  return ((uint64_t)a | (uint64_t)b) <= UINT32_MAX;
+}
+
+static int64_t delta_program_divide(int64_t a, int64_t b) {
+  if (b == 0)
+    return 0;
+  if (delta_program_small(a, b))
+    return (uint32_t)a / (uint32_t)b;
+  if (b == -1)
+    return wrap(0 - (uint64_t)a);
+  return a / b;
+}
+
+static int64_t delta_program_modulo(int64_t a, int64_t b) {
+  if (b == 0 || b == -1)
+    return 0;
+  if (delta_program_small(a, b))
+    return (uint32_t)a % (uint32_t)b;
+  return a % b;
+}
+
+static int64_t delta_program_sqrt(int64_t a) {
+  return delta_geometry_isqrt(CLAMP(a, 0, (int64_t)UINT32_MAX));
+}
+
+/* A size split into count parts, as struct GeometrySplit does */
+struct ProgramSplit {
+  int64_t size, count;
+  int64_t part, remainder; // Size of the smaller parts, number of larger ones
+};
+
+static void delta_program_split(struct ProgramSplit *split, int64_t size,
+                                int64_t count) {
+  split->size = size;
+  split->count = count;
+  if (size <= 0 || count <= 0) {
+    split->part = 0;
+    split->remainder = 0;
+  } else if (delta_program_small(size, count)) {
+    split->part = (uint32_t)size / (uint32_t)count;
+    split->remainder = (uint32_t)size % (uint32_t)count;
+  } else {
+    split->part = size / count;
+    split->remainder = size % count;
+  }
+}
+
+/* Start (or size, if offset is false) of part k of a split, 0 for a part
+ * that doesn't exist */
+static inline int64_t delta_program_split_part(const struct ProgramSplit *split,
+                                               int64_t k, bool offset) {
+  if (k < 0 || k > split->count || (!offset && k == split->count))
+    return 0;
+  if (offset)
+    return k * split->part + MIN(k, split->remainder);
+  return split->part + (k < split->remainder);
+}
+
+/* Loop over the views of a chunk, l being the index within the chunk */
+#define EACH_LANE for (uint32_t l = 0; l < lanes; l++)
+
+/* Apply an operator taking two values to every view of a chunk, a receives
+ * the results */
+static void delta_program_apply(enum ProgramOp op, int64_t *a,
+                                const int64_t *b, uint32_t lanes) {
+  switch (op) {
+  case OP_ADD:
+    EACH_LANE a[l] = wrap((uint64_t)a[l] + (uint64_t)b[l]);
+    break;
+  case OP_SUBTRACT:
+    EACH_LANE a[l] = wrap((uint64_t)a[l] - (uint64_t)b[l]);
+    break;
+  case OP_MULTIPLY:
+    EACH_LANE a[l] = wrap((uint64_t)a[l] * (uint64_t)b[l]);
+    break;
+  case OP_DIVIDE:
+    EACH_LANE a[l] = delta_program_divide(a[l], b[l]);
+    break;
+  case OP_MODULO:
+    EACH_LANE a[l] = delta_program_modulo(a[l], b[l]);
+    break;
+  case OP_LESS:
+    EACH_LANE a[l] = a[l] < b[l];
+    break;
+  case OP_LESS_EQUAL:
+    EACH_LANE a[l] = a[l] <= b[l];
+    break;
+  case OP_GREATER:
+    EACH_LANE a[l] = a[l] > b[l];
+    break;
+  case OP_GREATER_EQUAL:
+    EACH_LANE a[l] = a[l] >= b[l];
+    break;
+  case OP_EQUAL:
+    EACH_LANE a[l] = a[l] == b[l];
+    break;
+  case OP_NOT_EQUAL:
+    EACH_LANE a[l] = a[l] != b[l];
+    break;
+  case OP_AND:
+    EACH_LANE a[l] = a[l] && b[l];
+    break;
+  case OP_OR:
+    EACH_LANE a[l] = a[l] || b[l];
+    break;
+  case OP_MIN:
+    EACH_LANE a[l] = MIN(a[l], b[l]);
+    break;
+  case OP_MAX:
+    EACH_LANE a[l] = MAX(a[l], b[l]);
+    break;
+  case OP_SCALE:
+    EACH_LANE a[l] = delta_program_divide(
+        wrap((uint64_t)a[l] * (uint64_t)b[l]), LAYOUT_RATIO_ONE);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Value of the operand of an instruction for every view of a chunk */
+static void delta_program_operand(const struct ProgramInstruction *code,
+                                  const int64_t *variables, uint32_t first,
+                                  uint32_t lanes, int64_t *values) {
+  if (code->operand == OPERAND_VARIABLE &&
+      code->argument == VARIABLE_INDEX) {
+    EACH_LANE values[l] = (int64_t)first + l;
+    return;
+  }
+  int64_t value = code->operand == OPERAND_CONSTANT
+                      ? (int64_t)code->argument
+                      : variables[code->argument];
+  EACH_LANE values[l] = value;
+}
+
+/**
+ * Evaluate an expression for a chunk of views
+ *
+ * Every instruction runs for all views of the chunk before the next one, so
+ * that decoding the instructions costs the same for one view as for a whole
+ * chunk, and the loops over the views can be vectorized.
+ *
+ * @param code the first instruction of the expression
+ * @param variables values of the variables, but the index
+ * @param first index of the first view of the chunk
+ * @param lanes number of views in the chunk, at most PROGRAM_CHUNK
+ * @param result receives the value for every view
+ * */
+static void delta_program_eval(const struct ProgramInstruction *code,
+                               const int64_t *variables, uint32_t first,
+                               uint32_t lanes, int64_t *result) {
+  // The compiler made sure the stack is deep enough
+  int64_t stack[PROGRAM_MAX_STACK][PROGRAM_CHUNK];
+  int64_t operand[PROGRAM_CHUNK];
+  uint32_t count = 0; // Number of values on the stack
+  struct ProgramSplit split;
+  for (;; code++) {
+    enum ProgramOp op = code->op;
+    int64_t *a, *b, *c;
+    if (op >= OP_ADD) {
+      b = operand;
+      if (code->operand == OPERAND_STACK)
+        b = stack[--count];
+      else
+        delta_program_operand(code, variables, first, lanes, operand);
+      delta_program_apply(op, stack[count - 1], b, lanes);
+      continue;
+    }
+
+    switch (op) {
+    case OP_RETURN:
+      memcpy(result, stack[count - 1], lanes * sizeof(int64_t));
+      return;
+    case OP_PUSH:
+      delta_program_operand(code, variables, first, lanes, stack[count++]);
+      break;
+    case OP_NEGATE:
+      a = stack[count - 1];
+      EACH_LANE a[l] = wrap(0 - (uint64_t)a[l]);
+      break;
+    case OP_NOT:
+      a = stack[count - 1];
+      EACH_LANE a[l] = !a[l];
+      break;
+    case OP_SQRT:
+      a = stack[count - 1];
+      EACH_LANE a[l] = delta_program_sqrt(a[l]);
+      break;
+    case OP_SELECT:
+      c = stack[--count];
+      b = stack[--count];
+      a = stack[count - 1];
+      EACH_LANE a[l] = a[l] ? b[l] : c[l];
+      break;
+    case OP_OFFSET:
+    case OP_PART:
+      c = stack[--count];
+      b = stack[--count];
+      a = stack[count - 1];
+      // The same split is usually taken for every view, only computing it
+      // again when it changes saves two divisions per view
+      delta_program_split(&split, a[0], b[0]);
+      EACH_LANE {
+        if (a[l] != split.size || b[l] != split.count)
+          delta_program_split(&split, a[l], b[l]);
+        a[l] = delta_program_split_part(&split, c[l], op == OP_OFFSET);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/**
+ * Evaluate a part of a view statement for a chunk of views
+ *
+ * @param program the program
+ * @param rule the view statement
+ * @param part the part
+ * @param fixed values of the parts that don't depend on the index
+ * @param variables values of the variables, but the index
+ * @param first index of the first view of the chunk
+ * @param lanes number of views in the chunk
+ * @param values receives the value for every view
+ * */
+static void delta_program_part(const struct LayoutProgram *program,
+                               uint32_t rule, enum ProgramPart part,
+                               int64_t fixed[PROGRAM_MAX_RULES][PART_COUNT],
+                               const int64_t *variables, uint32_t first,
+                               uint32_t lanes, int64_t *values) {
+  const struct ProgramRule *r = &program->rules[rule];
+  if (r->varying & (1u << part))
+    delta_program_eval(&program->code[r->parts[part]], variables, first,
+                       lanes, values);
+  else
+    EACH_LANE values[l] = fixed[rule][part];
+}
+
+/* Every program is registered with this function, the style tells which
+ * program the demand is for */
+static void delta_program_compute(const struct LayoutParams *params,
+                                  uint32_t view_count, uint32_t width,
+                                  uint32_t height, struct ViewBuffer *views) {
+  const struct LayoutProgram *program =
+      (const struct LayoutProgram *)delta_layout_descriptor(
+          params->layout_style);
+
+  int64_t variables[PROGRAM_MAX_VARIABLES];
+  variables[VARIABLE_COUNT] = view_count;
+  variables[VARIABLE_INDEX] = 0;
+  variables[VARIABLE_WIDTH] = width;
+  variables[VARIABLE_HEIGHT] = height;
+  variables[VARIABLE_MAIN_COUNT] = params->main_count;
+  variables[VARIABLE_MAIN_RATIO] = params->main_ratio;
+  for (uint32_t i = 0; i < program->let_count; i++)
+    delta_program_eval(&program->code[program->lets[i]], variables, 0, 1,
+                       &variables[VARIABLE_BUILTIN_COUNT + i]);
+
+  int64_t fixed[PROGRAM_MAX_RULES][PART_COUNT];
+  for (uint32_t r = 0; r < program->rule_count; r++) {
+    const struct ProgramRule *rule = &program->rules[r];
+    for (uint32_t part = 0; part < PART_COUNT; part++) {
+      if (!(rule->varying & (1u << part)))
+        delta_program_eval(&program->code[rule->parts[part]], variables, 0,
+                           1, &fixed[r][part]);
+    }
+  }
+
+  for (uint32_t first = 0; first < view_count; first += PROGRAM_CHUNK) {
+    uint32_t lanes = MIN(view_count - first, PROGRAM_CHUNK);
+    // Views of the chunk no view statement applied to yet, one bit each
+    uint64_t all = lanes == 64 ? UINT64_MAX : (UINT64_C(1) << lanes) - 1;
+    uint64_t left = all;
+    // Views no statement applies to take up the whole area
+    int64_t values[PART_COUNT][PROGRAM_CHUNK];
+    EACH_LANE {
+      values[PART_X][l] = 0;
+      values[PART_Y][l] = 0;
+      values[PART_WIDTH][l] = width;
+      values[PART_HEIGHT][l] = height;
+    }
+
+    for (uint32_t r = 0; r < program->rule_count && left != 0; r++) {
+      int64_t part_values[PROGRAM_CHUNK];
+      delta_program_part(program, r, PART_CONDITION, fixed, variables, first,
+                         lanes, part_values);
+      uint64_t matched = 0;
+      EACH_LANE matched |= (uint64_t)(part_values[l] != 0) << l;
+      matched &= left;
+      if (matched == 0)
+        continue;
+      left &= ~matched;
+      for (uint32_t part = PART_X; part < PART_COUNT; part++) {
+        // Usually one statement applies to all views of a chunk
+        if (matched == all) {
+          delta_program_part(program, r, part, fixed, variables, first,
+                             lanes, values[part]);
+          continue;
+        }
+        delta_program_part(program, r, part, fixed, variables, first, lanes,
+                           part_values);
+        EACH_LANE {
+          if (matched & (UINT64_C(1) << l))
+            values[part][l] = part_values[l];
+        }
+      }
+    }
+
+    EACH_LANE {
+      int64_t x = MIN(MAX(values[PART_X][l], 0), (int64_t)width);
+      int64_t y = MIN(MAX(values[PART_Y][l], 0), (int64_t)height);
+      views->x[first + l] = x;
+      views->y[first + l] = y;
+      views->width[first + l] = MIN(MAX(values[PART_WIDTH][l], 0), width - x);
+      views->height[first + l] =
+          MIN(MAX(values[PART_HEIGHT][l], 0), height - y);
+    }
+  }
+}
+
+enum ProgramTokenKind {
+  TOKEN_END,
+  TOKEN_NUMBER,
+  TOKEN_NAME,     // Of a variable, function or statement
+  TOKEN_OPERATOR, // Including parentheses, commas and colons
+  TOKEN_INVALID,
+};
+
+struct ProgramCompiler {
+  const char *source; // Where the program comes from, for errors
+  const char *text, *end;
+  const char *position; // Where the next token starts, at the earliest
+  uint32_t line;
+  const char *line_start;
+
+  // The current token
+  enum ProgramTokenKind kind;
+  const char *token;
+  size_t token_length;
+  uint32_t number;
+  uint32_t token_line, token_column;
+
+  bool failed; // An error was printed
+  uint32_t nesting;
+
+  struct ProgramInstruction *code;
+  uint32_t code_count, code_capacity;
+  uint32_t expression_start; // Start of the code of the current expression
+  uint32_t depth, max_depth; // Of the stack while the code runs
+  bool in_view;              // Whether the index can be used
+  bool uses_index;           // By the expression being compiled
+  uint32_t parameters;       // LAYOUT_USES_* flags
+
+  // Names of the lets, not terminated
+  const char *let_names[PROGRAM_MAX_VARIABLES];
+  size_t let_lengths[PROGRAM_MAX_VARIABLES];
+
+  struct LayoutProgram *program; // The program, without its code yet
+};
+
+static void delta_program_error(struct ProgramCompiler *compiler,
+                                const char *message) {
+  if (compiler->failed)
+    return;
+  compiler->failed = true;
+  if (compiler->kind == TOKEN_END)
+    fprintf(stderr, "ERROR: %s:%u:%u: %s at the end\n", compiler->source,
+            compiler->token_line, compiler->token_column, message);
+  else
+    fprintf(stderr, "ERROR: %s:%u:%u: %s: '%.*s'\n", compiler->source,
+            compiler->token_line, compiler->token_column, message,
+            (int)compiler->token_length, compiler->token);
+}
+
+static bool is_name_start(char c) {
+  return isalpha((unsigned char)c) || c == '_';
+}
+
+static bool is_name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/* Skip whitespace and comments, keeping track of the line */
+static void delta_program_skip(struct ProgramCompiler *compiler) {
+  const char *c = compiler->position;
+  while (c < compiler->end) {
+    if (*c == '#') {
+      while (c < compiler->end && *c != '\n')
+        c++;
+    } else if (*c == '\n') {
+      compiler->line++;
+      compiler->line_start = ++c;
+    } else if (isspace((unsigned char)*c)) {
+      c++;
+    } else {
+      break;
+    }
+  }
+  compiler->position = c;
+  compiler->token = c;
+  compiler->token_line = compiler->line;
+  compiler->token_column = c - compiler->line_start + 1;
+}
+
+/* Scan a number, with at most six decimals, which make it a ratio */
+static void delta_program_number(struct ProgramCompiler *compiler) {
+  const char *c = compiler->position;
+  uint64_t whole = 0, fraction = 0;
+  uint32_t scale = 1;
+  bool point = false;
+  compiler->kind = TOKEN_NUMBER;
+  for (; c < compiler->end && (is_digit(*c) || (*c == '.' && !point)); c++) {
+    if (*c == '.') {
+      point = true;
+      scale = LAYOUT_RATIO_ONE;
+    } else if (!point) {
+      whole = whole * 10 + (*c - '0');
+      if (whole > UINT32_MAX)
+        compiler->kind = TOKEN_INVALID;
+    } else {
+      scale /= 10;
+      if (scale == 0)
+        compiler->kind = TOKEN_INVALID;
+      fraction += (*c - '0') * scale;
+    }
+  }
+  uint64_t number = point ? whole * LAYOUT_RATIO_ONE + fraction : whole;
+  if (number > UINT32_MAX)
+    compiler->kind = TOKEN_INVALID;
+  compiler->number = (uint32_t)number;
+  compiler->position = c;
+}
+
+/* Move on to the next token */
+static void delta_program_next(struct ProgramCompiler *compiler) {
+  static const char *const two_char_operators[] = {"<=", ">=", "==",
+                                                    "!=", "&&", "||"};
+  delta_program_skip(compiler);
+  const char *c = compiler->position;
+  if (c == compiler->end) {
+    compiler->kind = TOKEN_END;
+  } else if (is_digit(*c)) {
+    delta_program_number(compiler);
+  } else if (is_name_start(*c)) {
+    compiler->kind = TOKEN_NAME;
+    while (c < compiler->end && is_name_char(*c))
+      c++;
+    compiler->position = c;
+  } else if (strchr("+-*/%<>!?:(),=&|", *c) != NULL) {
+    compiler->kind = TOKEN_OPERATOR;
+    compiler->position = c + 1;
+    for (size_t i = 0; i < ARRAY_LENGTH(two_char_operators); i++) {
+      if (c + 1 < compiler->end && c[0] == two_char_operators[i][0] &&
+          c[1] == two_char_operators[i][1])
+        compiler->position = c + 2;
+    }
+  } else {
+    compiler->kind = TOKEN_INVALID;
+    compiler->position = c + 1;
+  }
+  compiler->token_length = compiler->position - compiler->token;
+}
+
+/* Whether the current token is the given operator or name */
+static bool delta_program_is(const struct ProgramCompiler *compiler,
+                             const char *text) {
+  return (compiler->kind == TOKEN_OPERATOR || compiler->kind == TOKEN_NAME) &&
+         strncmp(compiler->token, text, compiler->token_length) == 0 &&
+         text[compiler->token_length] == '\0';
+}
+
+/* Skip the current token if it is the given one */
+static bool delta_program_accept(struct ProgramCompiler *compiler,
+                                 const char *text) {
+  if (!delta_program_is(compiler, text))
+    return false;
+  delta_program_next(compiler);
+  return true;
+}
+
+static bool delta_program_expect(struct ProgramCompiler *compiler,
+                                 const char *text, const char *message) {
+  if (delta_program_accept(compiler, text))
+    return true;
+  delta_program_error(compiler, message);
+  return false;
+}
+
+/**
+ * Read a word of any characters but whitespace, for names and symbols
+ *
+ * @param compiler the compiler, at the first token of the word
+ * @param word set to the word, terminated
+ * @return false if the word is empty, too long, or has a ';'
+ * */
+static bool delta_program_word(struct ProgramCompiler *compiler, char *word) {
+  const char *c = compiler->token;
+  while (c < compiler->end && !isspace((unsigned char)*c) && *c != '#')
+    c++;
+  compiler->token_length = c - compiler->token;
+  if (compiler->token_length == 0) {
+    delta_program_error(compiler, "Expected a word");
+    return false;
+  }
+  if (compiler->token_length >= PROGRAM_NAME_LENGTH) {
+    delta_program_error(compiler, "Word too long");
+    return false;
+  }
+  if (memchr(compiler->token, ';', compiler->token_length) != NULL) {
+    delta_program_error(compiler, "Words can't contain ';'");
+    return false;
+  }
+  memcpy(word, compiler->token, compiler->token_length);
+  word[compiler->token_length] = '\0';
+  compiler->position = c;
+  delta_program_next(compiler);
+  return true;
+}
+
+/**
+ * Append an instruction to the code
+ *
+ * @param compiler the compiler
+ * @param op the instruction
+ * @param operand where its operand comes from
+ * @param argument its argument
+ * @param effect how many values it adds to the stack, negative if it takes
+ * more than it pushes
+ * */
+static void delta_program_emit(struct ProgramCompiler *compiler,
+                               enum ProgramOp op, enum ProgramOperand operand,
+                               uint32_t argument, int32_t effect) {
+  if (compiler->failed)
+    return;
+  if (compiler->code_count == compiler->code_capacity) {
+    if (compiler->code_capacity == PROGRAM_MAX_INSTRUCTIONS) {
+      delta_program_error(compiler, "Program too long");
+      return;
+    }
+    uint32_t capacity = MAX(compiler->code_capacity * 2, 64);
+    struct ProgramInstruction *code =
+        realloc(compiler->code, capacity * sizeof(*code));
+    if (code == NULL) {
+      delta_program_error(compiler, "Out of memory");
+      return;
+    }
+    compiler->code = code;
+    compiler->code_capacity = capacity;
+  }
+  compiler->code[compiler->code_count++] =
+      (struct ProgramInstruction){op, operand, argument};
+  compiler->depth += effect;
+  compiler->max_depth = MAX(compiler->max_depth, compiler->depth);
+  if (compiler->max_depth > PROGRAM_MAX_STACK)
+    delta_program_error(compiler, "Expression too complex");
+}
+
+/* Append an operator taking two values. When the second one is a constant or
+ * a variable, the instruction pushing it is turned into the operator, with
+ * it as operand. */
+static void delta_program_emit_binary(struct ProgramCompiler *compiler,
+                                      enum ProgramOp op) {
+  if (!compiler->failed && compiler->code_count > compiler->expression_start &&
+      compiler->code[compiler->code_count - 1].op == OP_PUSH) {
+    compiler->code[compiler->code_count - 1].op = op;
+    compiler->depth--;
+    return;
+  }
+  delta_program_emit(compiler, op, OPERAND_STACK, 0, -1);
+}
+
+/* Number of the variable named by the current token, false if none is */
+static bool delta_program_variable(const struct ProgramCompiler *compiler,
+                                   uint32_t *variable) {
+  for (uint32_t i = 0; i < VARIABLE_BUILTIN_COUNT; i++) {
+    if (delta_program_is(compiler, builtin_variables[i])) {
+      *variable = i;
+      return true;
+    }
+  }
+  for (uint32_t i = 0; i < compiler->program->let_count; i++) {
+    if (compiler->let_lengths[i] == compiler->token_length &&
+        memcmp(compiler->let_names[i], compiler->token,
+               compiler->token_length) == 0) {
+      *variable = VARIABLE_BUILTIN_COUNT + i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool delta_program_expression(struct ProgramCompiler *compiler);
+
+static bool delta_program_call(struct ProgramCompiler *compiler,
+                               const struct ProgramFunction *function) {
+  delta_program_next(compiler);
+  if (!delta_program_expect(compiler, "(", "Expected '('"))
+    return false;
+  for (uint32_t i = 0; i < function->arity; i++) {
+    if (i > 0 && !delta_program_expect(compiler, ",", "Expected ','"))
+      return false;
+    if (!delta_program_expression(compiler))
+      return false;
+  }
+  if (!delta_program_expect(compiler, ")", "Expected ')'"))
+    return false;
+  if (function->op >= OP_ADD)
+    delta_program_emit_binary(compiler, function->op);
+  else
+    delta_program_emit(compiler, function->op, OPERAND_STACK, 0,
+                       1 - (int32_t)function->arity);
+  return !compiler->failed;
+}
+
+static bool delta_program_primary(struct ProgramCompiler *compiler) {
+  if (compiler->kind == TOKEN_NUMBER) {
+    delta_program_emit(compiler, OP_PUSH, OPERAND_CONSTANT, compiler->number,
+                       1);
+    delta_program_next(compiler);
+    return !compiler->failed;
+  }
+  if (delta_program_accept(compiler, "(")) {
+    return delta_program_expression(compiler) &&
+           delta_program_expect(compiler, ")", "Expected ')'");
+  }
+  if (compiler->kind == TOKEN_NAME) {
+    for (size_t i = 0; i < ARRAY_LENGTH(functions); i++) {
+      if (delta_program_is(compiler, functions[i].name))
+        return delta_program_call(compiler, &functions[i]);
+    }
+    uint32_t variable;
+    if (!delta_program_variable(compiler, &variable)) {
+      delta_program_error(compiler, "Unknown variable");
+      return false;
+    }
+    if (variable == VARIABLE_INDEX && !compiler->in_view) {
+      delta_program_error(compiler,
+                          "The index is only known in view statements");
+      return false;
+    }
+    if (variable == VARIABLE_INDEX)
+      compiler->uses_index = true;
+    else if (variable == VARIABLE_MAIN_COUNT)
+      compiler->parameters |= LAYOUT_USES_MAIN_COUNT;
+    else if (variable == VARIABLE_MAIN_RATIO)
+      compiler->parameters |= LAYOUT_USES_MAIN_RATIO;
+    delta_program_emit(compiler, OP_PUSH, OPERAND_VARIABLE, variable, 1);
+    delta_program_next(compiler);
+    return !compiler->failed;
+  }
+  delta_program_error(compiler, compiler->kind == TOKEN_INVALID
+                                    ? "Invalid token"
+                                    : "Expected a value");
+  return false;
+}
+
+static bool delta_program_unary(struct ProgramCompiler *compiler) {
+  enum ProgramOp op;
+  if (delta_program_is(compiler, "-"))
+    op = OP_NEGATE;
+  else if (delta_program_is(compiler, "!"))
+    op = OP_NOT;
+  else
+    return delta_program_primary(compiler);
+
+  if (++compiler->nesting > PROGRAM_MAX_NESTING) {
+    delta_program_error(compiler, "Expression nested too deeply");
+    return false;
+  }
+  delta_program_next(compiler);
+  if (!delta_program_unary(compiler))
+    return false;
+  compiler->nesting--;
+  delta_program_emit(compiler, op, OPERAND_STACK, 0, 0);
+  return !compiler->failed;
+}
+
+/* Binary operators, by precedence from lowest to highest */
+struct ProgramOperator {
+  const char *text;
+  enum ProgramOp op;
+};
+
+static const struct ProgramOperator operators[][4] = {
+    {{"||", OP_OR}},
+    {{"&&", OP_AND}},
+    {{"==", OP_EQUAL}, {"!=", OP_NOT_EQUAL}},
+    {{"<", OP_LESS},
+     {"<=", OP_LESS_EQUAL},
+     {">", OP_GREATER},
+     {">=", OP_GREATER_EQUAL}},
+    {{"+", OP_ADD}, {"-", OP_SUBTRACT}},
+    {{"*", OP_MULTIPLY}, {"/", OP_DIVIDE}, {"%", OP_MODULO}},
+};
+
+/* Parse the operators of a precedence level and everything binding tighter,
+ * all of them are left associative */
+static bool delta_program_binary(struct ProgramCompiler *compiler,
+                                 uint32_t level) {
+  if (level == ARRAY_LENGTH(operators))
+    return delta_program_unary(compiler);
+  if (!delta_program_binary(compiler, level + 1))
+    return false;
+  for (;;) {
+    const struct ProgramOperator *match = NULL;
+    for (uint32_t i = 0; i < 4 && operators[level][i].text != NULL; i++) {
+      if (delta_program_is(compiler, operators[level][i].text))
+        match = &operators[level][i];
+    }
+    if (match == NULL)
+      return true;
+    delta_program_next(compiler);
+    if (!delta_program_binary(compiler, level + 1))
+      return false;
+    delta_program_emit_binary(compiler, match->op);
+    if (compiler->failed)
+      return false;
+  }
+}
+
+/* Parse an expression, down to the conditional operator */
+static bool delta_program_expression(struct ProgramCompiler *compiler) {
+  if (++compiler->nesting > PROGRAM_MAX_NESTING) {
+    delta_program_error(compiler, "Expression nested too deeply");
+    return false;
+  }
+  if (!delta_program_binary(compiler, 0))
+    return false;
+  // Both sides are evaluated, there are no side effects to skip
+  if (delta_program_accept(compiler, "?")) {
+    if (!delta_program_expression(compiler) ||
+        !delta_program_expect(compiler, ":", "Expected ':'") ||
+        !delta_program_expression(compiler))
+      return false;
+    delta_program_emit(compiler, OP_SELECT, OPERAND_STACK, 0, -2);
+  }
+  compiler->nesting--;
+  return !compiler->failed;
+}
+
+/**
+ * Compile a whole expression, ending with OP_RETURN
+ *
+ * @param compiler the compiler
+ * @param start set to the start of the code of the expression
+ * @param uses_index set to whether the expression depends on the index
+ * @return false on error
+ * */
+static bool delta_program_compile_expression(struct ProgramCompiler *compiler,
+                                             uint32_t *start,
+                                             bool *uses_index) {
+  *start = compiler->code_count;
+  compiler->expression_start = compiler->code_count;
+  compiler->uses_index = false;
+  compiler->depth = 0;
+  if (!delta_program_expression(compiler))
+    return false;
+  delta_program_emit(compiler, OP_RETURN, OPERAND_STACK, 0, 0);
+  *uses_index = compiler->uses_index;
+  return !compiler->failed;
+}
+
+static bool delta_program_reserved(const struct ProgramCompiler *compiler) {
+  static const char *const keywords[] = {"name", "symbol", "let", "view",
+                                         "if"};
+  uint32_t variable;
+  for (size_t i = 0; i < ARRAY_LENGTH(keywords); i++) {
+    if (delta_program_is(compiler, keywords[i]))
+      return true;
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(functions); i++) {
+    if (delta_program_is(compiler, functions[i].name))
+      return true;
+  }
+  return delta_program_variable(compiler, &variable);
+}
+
+static bool delta_program_let(struct ProgramCompiler *compiler) {
+  struct LayoutProgram *program = compiler->program;
+  if (compiler->kind != TOKEN_NAME) {
+    delta_program_error(compiler, "Expected the name of the variable");
+    return false;
+  }
+  if (delta_program_reserved(compiler)) {
+    delta_program_error(compiler, "Name already taken");
+    return false;
+  }
+  if (VARIABLE_BUILTIN_COUNT + program->let_count == PROGRAM_MAX_VARIABLES) {
+    delta_program_error(compiler, "Too many variables");
+    return false;
+  }
+  const char *name = compiler->token;
+  size_t length = compiler->token_length;
+  delta_program_next(compiler);
+  if (!delta_program_expect(compiler, "=", "Expected '='"))
+    return false;
+
+  bool uses_index;
+  compiler->in_view = false;
+  if (!delta_program_compile_expression(
+          compiler, &program->lets[program->let_count], &uses_index))
+    return false;
+  // Only visible after its own expression
+  compiler->let_names[program->let_count] = name;
+  compiler->let_lengths[program->let_count] = length;
+  program->let_count++;
+  return true;
+}
+
+static bool delta_program_view(struct ProgramCompiler *compiler) {
+  struct LayoutProgram *program = compiler->program;
+  if (program->rule_count == PROGRAM_MAX_RULES) {
+    delta_program_error(compiler, "Too many view statements");
+    return false;
+  }
+  struct ProgramRule *rule = &program->rules[program->rule_count];
+  bool uses_index = false;
+  rule->varying = 0;
+  compiler->in_view = true;
+
+  if (delta_program_accept(compiler, "if")) {
+    if (!delta_program_compile_expression(
+            compiler, &rule->parts[PART_CONDITION], &uses_index))
+      return false;
+  } else {
+    rule->parts[PART_CONDITION] = compiler->code_count;
+    delta_program_emit(compiler, OP_PUSH, OPERAND_CONSTANT, 1, 1);
+    delta_program_emit(compiler, OP_RETURN, OPERAND_STACK, 0, 0);
+  }
+  if (uses_index)
+    rule->varying |= 1u << PART_CONDITION;
+  if (!delta_program_expect(compiler, ":", "Expected ':'"))
+    return false;
+
+  for (uint32_t part = PART_X; part < PART_COUNT; part++) {
+    if (part > PART_X && !delta_program_expect(compiler, ",", "Expected ','"))
+      return false;
+    if (!delta_program_compile_expression(compiler, &rule->parts[part],
+                                          &uses_index))
+      return false;
+    if (uses_index)
+      rule->varying |= 1u << part;
+  }
+  program->rule_count++;
+  return true;
+}
+
+static bool delta_program_statement(struct ProgramCompiler *compiler) {
+  struct LayoutProgram *program = compiler->program;
+  if (delta_program_is(compiler, "name") ||
+      delta_program_is(compiler, "symbol")) {
+    char *word =
+        delta_program_is(compiler, "name") ? program->name : program->symbol;
+    if (word[0] != '\0') {
+      delta_program_error(compiler, "Given twice");
+      return false;
+    }
+    // The word starts right after the keyword, whatever it is made of
+    compiler->position = compiler->token + compiler->token_length;
+    delta_program_skip(compiler);
+    return delta_program_word(compiler, word);
+  }
+  if (delta_program_accept(compiler, "let"))
+    return delta_program_let(compiler);
+  if (delta_program_accept(compiler, "view"))
+    return delta_program_view(compiler);
+  delta_program_error(compiler, "Expected name, symbol, let or view");
+  return false;
+}
+
+/**
+ * Compile a layout program
+ *
+ * @param source where the program comes from, for errors
+ * @param text the program, not necessarily terminated
+ * @param length length of the program
+ * @return the program, NULL on error (which has been printed)
+ * */
+static struct LayoutProgram *delta_program_compile(const char *source,
+                                                   const char *text,
+                                                   size_t length) {
+  struct ProgramCompiler compiler = {
+      .source = source,
+      .text = text,
+      .end = text + length,
+      .position = text,
+      .line = 1,
+      .line_start = text,
+  };
+  compiler.program = calloc(1, sizeof(struct LayoutProgram));
+  if (compiler.program == NULL) {
+    fprintf(stderr, "ERROR: Out of memory compiling %s\n", source);
+    return NULL;
+  }
+  delta_program_next(&compiler);
+  while (compiler.kind != TOKEN_END && delta_program_statement(&compiler))
+    ;
+  if (!compiler.failed && (compiler.program->name[0] == '\0' ||
+                           compiler.program->rule_count == 0)) {
+    fprintf(stderr, "ERROR: %s: The program has no %s\n", source,
+            compiler.program->name[0] == '\0' ? "name" : "view statement");
+    compiler.failed = true;
+  }
+  struct LayoutProgram *program = NULL;
+  if (!compiler.failed) {
+    program = realloc(compiler.program,
+                      sizeof(struct LayoutProgram) +
+                          compiler.code_count * sizeof(*compiler.code));
+    if (program == NULL)
+      fprintf(stderr, "ERROR: Out of memory compiling %s\n", source);
+  }
+  if (program == NULL) {
+    free(compiler.program);
+    free(compiler.code);
+    return NULL;
+  }
+  memcpy(program->code, compiler.code,
+         compiler.code_count * sizeof(struct ProgramInstruction));
+  program->instruction_count = compiler.code_count;
+  free(compiler.code);
+
+  if (program->symbol[0] == '\0')
+    strcpy(program->symbol, program->name);
+  program->descriptor = (struct LayoutDescriptor){
+      .name = program->name,
+      .symbol = program->symbol,
+      .description = "layout program",
+      .parameters = compiler.parameters,
+      .compute = delta_program_compute,
+  };
+  return program;
+}
+
+bool delta_program_load(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "ERROR: Could not open layout program %s: %s\n", path,
+            strerror(errno));
+    return false;
+  }
+  char *text = malloc(PROGRAM_MAX_SOURCE + 1);
+  if (text == NULL) {
+    fclose(file);
+    return false;
+  }
+  size_t length = fread(text, 1, PROGRAM_MAX_SOURCE + 1, file);
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed || length > PROGRAM_MAX_SOURCE) {
+    fprintf(stderr, "ERROR: Could not read layout program %s%s\n", path,
+            failed ? "" : ", it is too long");
+    free(text);
+    return false;
+  }
+
+  struct LayoutProgram *program = delta_program_compile(path, text, length);
+  free(text);
+  if (program == NULL)
+    return false;
+  uint32_t style;
+  if (!delta_layout_register(&program->descriptor, &style)) {
+    fprintf(stderr,
+            "ERROR: Could not add layout %s of %s, the name is taken or "
+            "there are too many layouts\n",
+            program->name, path);
+    free(program);
+    return false;
+  }
+  return true;
+}
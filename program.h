@@ -0,0 +1,86 @@
+/*
+ * Layouts written as programs in a small description language
+ *
+ * A layout program gives the position and size of every view as integer
+ * expressions of the demand and of the parameters of the output, so that new
+ * arrangements don't need any C. For example, a layout with the main views
+ * on the left and the other views in a grid on the right:
+ *
+ *   name main-grid
+ *   symbol [#]
+ *   let mains = min(main_count, count)
+ *   let others = count - mains
+ *   let main_width = others == 0 ? width : mains == 0 ? 0 :
+ *                    scale(width, main_ratio)
+ *   let grid_width = width - main_width
+ *   let columns = sqrt(others) + (sqrt(others) * sqrt(others) < others)
+ *   let rows = (others + columns - 1) / max(columns, 1)
+ *   view if index < mains:
+ *     0, offset(height, mains, index), main_width, part(height, mains, index)
+ *   view:
+ *     main_width + offset(grid_width, columns, (index - mains) % columns),
+ *     offset(height, rows, (index - mains) / columns),
+ *     part(grid_width, columns, (index - mains) % columns),
+ *     part(height, rows, (index - mains) / columns)
+ *
+ * Statements (line breaks are only whitespace, # starts a comment):
+ *
+ *   name <word>        Name used by set_layout, required
+ *   symbol <word>      Shown by river, the name by default
+ *   let <var> = <e>    Computed once per demand, from the variables below
+ *                      and the lets before it
+ *   view [if <e>]: <x>, <y>, <width>, <height>
+ *                      Placement of a view, the first view statement whose
+ *                      condition holds is used. A view no statement applies
+ *                      to takes up the whole area.
+ *
+ * Variables: count (number of views), index (of the view being placed, only
+ * in view statements), width and height (of the usable area), main_count and
+ * main_ratio (in millionths, as are numbers with decimals like 0.5).
+ *
+ * Expressions are evaluated with 64 bit integers and the operators of C:
+ * ?:, ||, &&, ==, !=, <, <=, >, >=, +, -, *, /, % and unary - and !.
+ * Dividing by 0 gives 0. Functions: min(a, b), max(a, b), sqrt(a) (rounded
+ * down), scale(size, ratio) (size times a ratio in millionths),
+ * offset(size, count, k) and part(size, count, k) (start and size of part k
+ * of size split into count parts, the first ones getting the remainder, as
+ * the built-in layouts do). Placements are clamped to the usable area.
+ *
+ * Programs are compiled once into bytecode for a small stack machine, which
+ * runs every instruction for a chunk of views at once. Parts of a view
+ * statement not using the index are only evaluated once per demand, and
+ * evaluating a program allocates nothing.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_PROGRAM_H
+#define DELTA_PROGRAM_H
+
+#include <stdbool.h>
+
+/**
+ * Compile a layout program from a file and register it as a layout
+ *
+ * Programs are never unloaded.
+ *
+ * @param path path of the program
+ * @return false if the program could not be read, compiled or registered,
+ * problems are printed
+ * */
+bool delta_program_load(const char *path);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Timeline of the startup, and notifying whoever started delta that it is
+ * ready
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "startup.h"
+#include "trace.h"
+
+/* Most steps kept, later ones are only counted */
+#define STARTUP_MAX_RECORDS 64
+
+struct StartupRecord {
+  uint64_t timestamp_ns; // Time since delta_startup_begin
+  enum StartupEvent event;
+  uint32_t output;
+};
+
+static uint64_t start_ns = 0;
+static struct StartupRecord records[STARTUP_MAX_RECORDS];
+static uint32_t record_count = 0;
+static uint32_t dropped_count = 0;
+static bool ready = false;
+static bool committed = false;
+
+static FILE *print_file = NULL;
+static bool printed = false;
+
+static int ready_fd = -1;
+static const char *ready_path = NULL;
+static bool ready_file_created = false;
+
+static const char *const event_names[] = {
+    [STARTUP_CONNECT] = "connect",
+    [STARTUP_REGISTRY] = "registry",
+    [STARTUP_CONFIGURE] = "configure output",
+    [STARTUP_READY] = "ready",
+    [STARTUP_FIRST_COMMIT] = "first commit",
+};
+
+void delta_startup_begin(void) { start_ns = delta_trace_now_ns(); }
+
+static void delta_startup_print(void) {
+  if (print_file == NULL || printed)
+    return;
+  printed = true;
+  fputs("Startup (ms since delta started):\n", print_file);
+  for (uint32_t i = 0; i < record_count; i++) {
+    const struct StartupRecord *record = &records[i];
+    if (record->event == STARTUP_CONFIGURE)
+      fprintf(print_file, "  %9.3f %s %u\n", record->timestamp_ns / 1e6,
+              event_names[record->event], record->output);
+    else
+      fprintf(print_file, "  %9.3f %s\n", record->timestamp_ns / 1e6,
+              event_names[record->event]);
+  }
+  if (dropped_count > 0)
+    fprintf(print_file, "  (%u later steps not kept)\n", dropped_count);
+  fflush(print_file);
+}
+
+static void delta_startup_write_ready_file(void) {
+  // The file is written under another name and renamed into place, so it
+  // never shows up empty
+  char temporary[PATH_MAX];
+  if (snprintf(temporary, sizeof(temporary), "%s.tmp", ready_path) >=
+      (int)sizeof(temporary)) {
+    fprintf(stderr, "ERROR: Readiness file path too long: %s\n", ready_path);
+    return;
+  }
+  int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    fprintf(stderr, "ERROR: Could not create readiness file %s: %s\n",
+            temporary, strerror(errno));
+    return;
+  }
+  // The pid lets the init file find delta again
+  char line[32];
+  int length = snprintf(line, sizeof(line), "%ld\n", (long)getpid());
+  bool written = write(fd, line, length) == length;
+  if (close(fd) != 0)
+    written = false;
+  if (!written || rename(temporary, ready_path) == -1) {
+    fprintf(stderr, "ERROR: Could not write readiness file %s: %s\n",
+            ready_path, strerror(errno));
+    unlink(temporary);
+    return;
+  }
+  ready_file_created = true;
+}
+
+static void delta_startup_notify(void) {
+  if (ready_fd != -1) {
+    ssize_t written;
+    while ((written = write(ready_fd, "\n", 1)) == -1 && errno == EINTR)
+      ;
+    if (written != 1)
+      fprintf(stderr, "ERROR: Could not write to readiness fd %d: %s\n",
+              ready_fd, strerror(errno));
+    close(ready_fd);
+    ready_fd = -1;
+  }
+  if (ready_path != NULL)
+    delta_startup_write_ready_file();
+}
+
+void delta_startup_record(enum StartupEvent event, uint32_t output) {
+  if (event == STARTUP_FIRST_COMMIT) {
+    if (committed)
+      return;
+    committed = true;
+  }
+  if (event == STARTUP_READY) {
+    if (ready)
+      return;
+    ready = true;
+  }
+  // Outputs plugged in later aren't part of the startup
+  if (event == STARTUP_CONFIGURE && ready)
+    return;
+
+  if (record_count < STARTUP_MAX_RECORDS)
+    records[record_count++] = (struct StartupRecord){
+        .timestamp_ns = delta_trace_now_ns() - start_ns,
+        .event = event,
+        .output = output,
+    };
+  else
+    dropped_count++;
+
+  if (event == STARTUP_READY)
+    delta_startup_notify();
+  if (ready && committed)
+    delta_startup_print();
+}
+
+void delta_startup_print_to(FILE *file) { print_file = file; }
+
+bool delta_startup_notify_fd(int fd) {
+  if (fd < 0 || fcntl(fd, F_GETFD) == -1)
+    return false;
+  // Nothing delta might start should inherit it
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  ready_fd = fd;
+  return true;
+}
+
+void delta_startup_notify_file(const char *path) {
+  ready_path = path;
+  // A file left over from an earlier run must not look like readiness
+  unlink(path);
+}
+
+void delta_startup_finish(void) {
+  delta_startup_print();
+  if (ready_fd != -1) {
+    // Never got ready, the reader sees the end of the file instead
+    close(ready_fd);
+    ready_fd = -1;
+  }
+  if (ready_file_created)
+    unlink(ready_path);
+}
@@ -0,0 +1,77 @@
+/*
+ * Timeline of the startup, and notifying whoever started delta that it is
+ * ready
+ *
+ * River gives windows opened before delta has a layout object on their
+ * output a fallback layout, so an init file starting delta in the
+ * background races it. delta can instead tell the init file when the
+ * compositor knows all of its layout objects, by writing a line to an
+ * inherited file descriptor (the readiness protocol of s6 and dinit) or by
+ * creating a file, so the init file waits exactly as long as needed.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_STARTUP_H
+#define DELTA_STARTUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum StartupEvent {
+  STARTUP_CONNECT,      // Connected to the compositor
+  STARTUP_REGISTRY,     // The registry advertised every global
+  STARTUP_CONFIGURE,    // Asked for the layout object of an output
+  STARTUP_READY,        // The compositor has every layout object
+  STARTUP_FIRST_COMMIT, // Committed the first layout
+};
+
+/* Start the timeline, everything is timed from here */
+void delta_startup_begin(void);
+
+/**
+ * Record a step of the startup
+ *
+ * STARTUP_READY and STARTUP_FIRST_COMMIT are only kept the first time, so
+ * they can be recorded every time they happen. Outputs configured once ready
+ * aren't recorded.
+ *
+ * @param event what happened
+ * @param output id of the output, for STARTUP_CONFIGURE
+ * */
+void delta_startup_record(enum StartupEvent event, uint32_t output);
+
+/**
+ * Print the timeline once it is complete
+ *
+ * It is printed as soon as delta is ready and committed its first layout,
+ * or at the latest by delta_startup_finish.
+ *
+ * @param file where to print, NULL to not print it
+ * */
+void delta_startup_print_to(FILE *file);
+
+/* Write a line to an inherited fd when ready, returns false if fd is bad */
+bool delta_startup_notify_fd(int fd);
+
+/* Create a file when ready, it is removed again when delta exits */
+void delta_startup_notify_file(const char *path);
+
+/* Print the timeline if it wasn't yet, and remove the readiness file */
+void delta_startup_finish(void);
+
+#endif
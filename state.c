@@ -0,0 +1,332 @@
+/*
+ * Layout parameters of every output, kept across restarts of delta
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "layout.h"
+#include "state.h"
+
+#define STATE_MAGIC "DLTASTA1"
+
+/* Bumped whenever the layout of the file changes, older files are reset */
+#define STATE_VERSION 3
+
+/* Number of outputs remembered */
+#define STATE_SLOT_COUNT 16
+
+/* Longest output name remembered, including the terminator */
+#define STATE_NAME_LENGTH 64
+
+/* Longest layout name stored, including the terminator */
+#define STATE_LAYOUT_LENGTH 64
+
+/* The parameters of a tag as stored, this has no padding
+ *
+ * The layout is stored by name, since the index of a layout of a plugin or
+ * program depends on what was loaded, and in which order.
+ */
+struct StateParams {
+  char layout[STATE_LAYOUT_LENGTH]; // Empty if the name was too long
+  uint32_t main_count;
+  uint32_t main_ratio;
+  uint32_t view_padding;
+  uint32_t outer_padding;
+};
+
+struct StateSlot {
+  char name[STATE_NAME_LENGTH]; // Empty for an unused slot
+  uint64_t last_seen;           // Value of the file clock on last use
+  uint32_t saved;               // Whether params holds saved parameters
+  uint32_t reserved;
+  struct StateParams params[TAG_COUNT];
+};
+
+struct StateFile {
+  char magic[sizeof(STATE_MAGIC) - 1];
+  uint32_t version;
+  uint32_t slot_count;
+  uint64_t clock;
+  struct StateSlot slots[STATE_SLOT_COUNT];
+};
+
+static struct StateFile *state = NULL;
+
+/* Kept open for the lock on the state file, held as long as it is mapped */
+static int state_fd = -1;
+
+/* Create every missing directory leading up to a file */
+static void delta_state_make_directories(char *path) {
+  for (char *slash = strchr(path + 1, '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(path, 0700);
+    *slash = '/';
+  }
+}
+
+static char *delta_state_default_path(void) {
+  const char *state_home = getenv("XDG_STATE_HOME");
+  const char *home = getenv("HOME");
+  const char *base, *suffix;
+  if (state_home != NULL && state_home[0] == '/') {
+    base = state_home;
+    suffix = "/delta/state";
+  } else if (home != NULL) {
+    base = home;
+    suffix = "/.local/state/delta/state";
+  } else {
+    return NULL;
+  }
+  char *path = malloc(strlen(base) + strlen(suffix) + 1);
+  if (path == NULL)
+    return NULL;
+  strcpy(path, base);
+  strcat(path, suffix);
+  return path;
+}
+
+static bool delta_state_valid(const struct StateFile *file) {
+  return memcmp(file->magic, STATE_MAGIC, sizeof(file->magic)) == 0 &&
+         file->version == STATE_VERSION &&
+         file->slot_count == STATE_SLOT_COUNT;
+}
+
+/**
+ * Take the lock on the state file
+ *
+ * Every delta maps the file shared, so two of them would overwrite each
+ * other's slots. Only the first one keeps its state.
+ *
+ * @return false if another delta holds it, or on error, which is printed
+ * */
+static bool delta_state_lock(int fd, const char *path) {
+  struct stat locked, current;
+  if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+    // The file may have been replaced by the delta holding it since it was
+    // opened, see delta_state_create
+    if (fstat(fd, &locked) == 0 && stat(path, &current) == 0 &&
+        locked.st_dev == current.st_dev && locked.st_ino == current.st_ino)
+      return true;
+    errno = EWOULDBLOCK;
+  }
+  if (errno == EWOULDBLOCK)
+    fprintf(stderr,
+            "WARNING: State file %s is used by another delta, running "
+            "without saving state\n",
+            path);
+  else
+    fprintf(stderr, "ERROR: Could not lock state file %s: %s\n", path,
+            strerror(errno));
+  return false;
+}
+
+/**
+ * Replace the state file with an empty one
+ *
+ * The file is written next to it and renamed over it: the old file may
+ * still be mapped by a delta of another version, which truncating it would
+ * crash.
+ *
+ * @return the new file, locked, or -1 on error, which is printed
+ * */
+static int delta_state_create(const char *path) {
+  char *temporary = malloc(strlen(path) + sizeof(".new"));
+  struct StateFile *empty = calloc(1, sizeof(struct StateFile));
+  if (temporary == NULL || empty == NULL) {
+    fputs("ERROR: Failed to allocate.\n", stderr);
+    free(temporary);
+    free(empty);
+    return -1;
+  }
+  strcpy(temporary, path);
+  strcat(temporary, ".new");
+  memcpy(empty->magic, STATE_MAGIC, sizeof(empty->magic));
+  empty->version = STATE_VERSION;
+  empty->slot_count = STATE_SLOT_COUNT;
+
+  int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  bool created = fd != -1 && flock(fd, LOCK_EX | LOCK_NB) == 0 &&
+                 write(fd, empty, sizeof(struct StateFile)) ==
+                     (ssize_t)sizeof(struct StateFile) &&
+                 rename(temporary, path) == 0;
+  if (!created) {
+    fprintf(stderr, "ERROR: Could not create state file %s: %s\n", path,
+            strerror(errno));
+    if (fd != -1) {
+      close(fd);
+      unlink(temporary);
+      fd = -1;
+    }
+  }
+  free(temporary);
+  free(empty);
+  return fd;
+}
+
+/* Whether the file holds a state of this version */
+static bool delta_state_readable(int fd) {
+  struct stat info;
+  struct StateFile header;
+  return fstat(fd, &info) == 0 &&
+         (size_t)info.st_size == sizeof(struct StateFile) &&
+         pread(fd, &header, offsetof(struct StateFile, slots), 0) ==
+             (ssize_t)offsetof(struct StateFile, slots) &&
+         delta_state_valid(&header);
+}
+
+bool delta_state_open(const char *path) {
+  char *default_path = NULL;
+  if (path == NULL) {
+    default_path = delta_state_default_path();
+    if (default_path == NULL)
+      return false;
+    delta_state_make_directories(default_path);
+    path = default_path;
+  }
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    fprintf(stderr, "ERROR: Could not open state file %s: %s\n", path,
+            strerror(errno));
+    free(default_path);
+    return false;
+  }
+  if (!delta_state_lock(fd, path)) {
+    close(fd);
+    free(default_path);
+    return false;
+  }
+
+  // A file of another version (or a damaged one) is started over
+  if (!delta_state_readable(fd)) {
+    // The lock on the old file is only released once the new one is locked
+    int old_fd = fd;
+    fd = delta_state_create(path);
+    close(old_fd);
+    if (fd == -1) {
+      free(default_path);
+      return false;
+    }
+  }
+
+  void *map = mmap(NULL, sizeof(struct StateFile), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "ERROR: Could not map state file %s: %s\n", path,
+            strerror(errno));
+    close(fd);
+    free(default_path);
+    return false;
+  }
+  free(default_path);
+  state = map;
+  state_fd = fd;
+  return true;
+}
+
+void delta_state_close(void) {
+  if (state == NULL)
+    return;
+  munmap(state, sizeof(struct StateFile));
+  state = NULL;
+  // This releases the lock
+  close(state_fd);
+  state_fd = -1;
+}
+
+struct StateSlot *delta_state_slot(const char *name) {
+  if (state == NULL)
+    return NULL;
+
+  struct StateSlot *slot = NULL;
+  for (uint32_t i = 0; i < STATE_SLOT_COUNT; i++) {
+    if (strncmp(state->slots[i].name, name, STATE_NAME_LENGTH - 1) == 0) {
+      slot = &state->slots[i];
+      break;
+    }
+    // Empty slots have a last_seen of 0, so they are taken first
+    if (slot == NULL || state->slots[i].last_seen < slot->last_seen)
+      slot = &state->slots[i];
+  }
+
+  if (strncmp(slot->name, name, STATE_NAME_LENGTH - 1) != 0) {
+    memset(slot, 0, sizeof(struct StateSlot));
+    strncpy(slot->name, name, STATE_NAME_LENGTH - 1);
+  }
+  slot->last_seen = ++state->clock;
+  return slot;
+}
+
+bool delta_state_load(const struct StateSlot *slot,
+                      struct LayoutParams params[TAG_COUNT]) {
+  if (slot == NULL || !slot->saved)
+    return false;
+
+  // Don't trust the file any further than needed
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++) {
+    const struct StateParams *saved = &slot->params[tag];
+    if (saved->main_ratio > LAYOUT_RATIO_ONE)
+      return false;
+  }
+
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++) {
+    const struct StateParams *saved = &slot->params[tag];
+    // A layout of a plugin that isn't loaded this time falls back to tile
+    uint32_t style;
+    if (!delta_layout_find(saved->layout,
+                           strnlen(saved->layout, STATE_LAYOUT_LENGTH),
+                           &style))
+      style = TILE;
+    params[tag].layout_style = style;
+    params[tag].main_count = saved->main_count;
+    params[tag].main_ratio = saved->main_ratio;
+    params[tag].view_padding = saved->view_padding;
+    params[tag].outer_padding = saved->outer_padding;
+  }
+  return true;
+}
+
+void delta_state_save(struct StateSlot *slot,
+                      const struct LayoutParams params[TAG_COUNT]) {
+  if (slot == NULL)
+    return;
+  for (uint32_t tag = 0; tag < TAG_COUNT; tag++) {
+    struct StateParams *saved = &slot->params[tag];
+    const struct LayoutDescriptor *layout =
+        delta_layout_descriptor(params[tag].layout_style);
+    memset(saved->layout, 0, STATE_LAYOUT_LENGTH);
+    if (layout != NULL && strlen(layout->name) < STATE_LAYOUT_LENGTH)
+      strcpy(saved->layout, layout->name);
+    saved->main_count = params[tag].main_count;
+    saved->main_ratio = params[tag].main_ratio;
+    saved->view_padding = params[tag].view_padding;
+    saved->outer_padding = params[tag].outer_padding;
+  }
+  slot->saved = 1;
+}
@@ -0,0 +1,77 @@
+/*
+ * Layout parameters of every output, kept across restarts of delta
+ *
+ * The parameters are stored in a small file of fixed layout, mapped into
+ * memory and updated in place whenever they change. Outputs are identified
+ * by their name (e.g. "DP-1"), so an output gets its parameters back when
+ * delta starts again, no matter in which order the outputs are announced.
+ * Nothing is synced explicitly, the kernel writes the pages back on its own,
+ * which survives delta crashing but not the whole system going down.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_STATE_H
+#define DELTA_STATE_H
+
+#include <stdbool.h>
+
+#include "layout.h"
+
+struct StateSlot;
+
+/**
+ * Open (creating it if needed), lock and map the state file
+ *
+ * The file is locked until delta_state_close, so a second delta using the
+ * same file runs without it.
+ *
+ * @param path the state file, NULL for the default
+ * ($XDG_STATE_HOME/delta/state, or ~/.local/state/delta/state)
+ * @return false on error or if another delta holds the file, delta then
+ * simply runs without saving its state
+ * */
+bool delta_state_open(const char *path);
+
+/* Unmap and unlock the state file */
+void delta_state_close(void);
+
+/**
+ * Find the slot of an output, or claim one for it
+ *
+ * If every slot is taken, the one of the output seen least recently is
+ * reused.
+ *
+ * @param name name of the output
+ * @return the slot, or NULL if the state file isn't open
+ * */
+struct StateSlot *delta_state_slot(const char *name);
+
+/**
+ * Restore the saved parameters of an output
+ *
+ * @param slot slot of the output
+ * @param params parameters of every tag, only modified if they were saved
+ * @return whether parameters were saved in the slot
+ * */
+bool delta_state_load(const struct StateSlot *slot,
+                      struct LayoutParams params[TAG_COUNT]);
+
+/* Save the parameters of an output, slot may be NULL */
+void delta_state_save(struct StateSlot *slot,
+                      const struct LayoutParams params[TAG_COUNT]);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Recording and replaying traces of layout events
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+/* Size of the stdio buffer of a trace being recorded */
+#define TRACE_BUFFER_SIZE 65536
+
+/* Header of every record, this has no padding */
+struct TraceRecordHeader {
+  uint64_t timestamp_ns;
+  uint32_t output;
+  uint32_t type;
+};
+
+uint64_t delta_trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool delta_trace_writer_open(struct TraceWriter *writer, const char *path) {
+  writer->file = fopen(path, "wb");
+  if (writer->file == NULL)
+    return false;
+  // Records are small, so let stdio collect plenty of them per write
+  setvbuf(writer->file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+  writer->start_ns = delta_trace_now_ns();
+  fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), writer->file);
+  return true;
+}
+
+/* Write the header of a record */
+static void delta_trace_write_header(struct TraceWriter *writer,
+                                     uint32_t output,
+                                     enum TraceEventType type) {
+  uint64_t now = delta_trace_now_ns();
+  struct TraceRecordHeader header = {
+      .timestamp_ns = now - writer->start_ns,
+      .output = output,
+      .type = type,
+  };
+  fwrite(&header, sizeof(header), 1, writer->file);
+}
+
+void delta_trace_write_demand(struct TraceWriter *writer, uint32_t output,
+                              uint32_t view_count, uint32_t width,
+                              uint32_t height, uint32_t tags, uint32_t serial) {
+  if (writer->file == NULL)
+    return;
+  delta_trace_write_header(writer, output, TRACE_LAYOUT_DEMAND);
+  uint32_t payload[5] = {view_count, width, height, tags, serial};
+  fwrite(payload, sizeof(payload), 1, writer->file);
+}
+
+void delta_trace_write_command(struct TraceWriter *writer, uint32_t output,
+                               const char *command) {
+  if (writer->file == NULL)
+    return;
+  delta_trace_write_header(writer, output, TRACE_USER_COMMAND);
+  size_t command_length = strlen(command);
+  uint32_t length = command_length < TRACE_MAX_COMMAND_LENGTH
+                        ? command_length
+                        : TRACE_MAX_COMMAND_LENGTH;
+  fwrite(&length, sizeof(length), 1, writer->file);
+  fwrite(command, 1, length, writer->file);
+}
+
+void delta_trace_write_command_tags(struct TraceWriter *writer, uint32_t output,
+                                    uint32_t tags) {
+  if (writer->file == NULL)
+    return;
+  delta_trace_write_header(writer, output, TRACE_USER_COMMAND_TAGS);
+  fwrite(&tags, sizeof(tags), 1, writer->file);
+}
+
+void delta_trace_writer_flush(struct TraceWriter *writer) {
+  if (writer->file != NULL)
+    fflush(writer->file);
+}
+
+void delta_trace_writer_close(struct TraceWriter *writer) {
+  if (writer->file == NULL)
+    return;
+  fclose(writer->file);
+  writer->file = NULL;
+}
+
+bool delta_trace_reader_open(struct TraceReader *reader, const char *path) {
+  char magic[sizeof(TRACE_MAGIC) - 1];
+  reader->command = NULL;
+  reader->command_capacity = 0;
+  reader->file = fopen(path, "rb");
+  if (reader->file == NULL)
+    return false;
+  if (fread(magic, sizeof(magic), 1, reader->file) != 1 ||
+      memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+    fclose(reader->file);
+    reader->file = NULL;
+    return false;
+  }
+  return true;
+}
+
+int delta_trace_read(struct TraceReader *reader, struct TraceEvent *event) {
+  struct TraceRecordHeader header;
+  size_t read = fread(&header, 1, sizeof(header), reader->file);
+  if (read == 0 && feof(reader->file))
+    return 0;
+  if (read != sizeof(header))
+    return -1;
+
+  event->timestamp_ns = header.timestamp_ns;
+  event->output = header.output;
+  event->type = header.type;
+  event->command = NULL;
+
+  if (header.type == TRACE_LAYOUT_DEMAND) {
+    uint32_t payload[5];
+    if (fread(payload, sizeof(payload), 1, reader->file) != 1)
+      return -1;
+    event->view_count = payload[0];
+    event->width = payload[1];
+    event->height = payload[2];
+    event->tags = payload[3];
+    event->serial = payload[4];
+  } else if (header.type == TRACE_USER_COMMAND) {
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, reader->file) != 1 ||
+        length > TRACE_MAX_COMMAND_LENGTH)
+      return -1;
+    if (length >= reader->command_capacity) {
+      // On failure the previous buffer is still owned by the reader
+      char *command = realloc(reader->command, (size_t)length + 1);
+      if (command == NULL)
+        return -1;
+      reader->command = command;
+      reader->command_capacity = length + 1;
+    }
+    if (length > 0 && fread(reader->command, length, 1, reader->file) != 1)
+      return -1;
+    reader->command[length] = '\0';
+    event->command = reader->command;
+  } else if (header.type == TRACE_USER_COMMAND_TAGS) {
+    if (fread(&event->tags, sizeof(event->tags), 1, reader->file) != 1)
+      return -1;
+  } else {
+    return -1;
+  }
+  return 1;
+}
+
+void delta_trace_reader_close(struct TraceReader *reader) {
+  if (reader->file != NULL)
+    fclose(reader->file);
+  free(reader->command);
+  reader->file = NULL;
+  reader->command = NULL;
+}
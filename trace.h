@@ -0,0 +1,116 @@
+/*
+ * Recording and replaying traces of layout events
+ *
+ * A trace file starts with the 8 byte magic "DLTATRC1", followed by records
+ * in native byte order. Every record starts with a 16 byte header (a 64 bit
+ * timestamp in nanoseconds since recording started, a 32 bit output id and a
+ * 32 bit event type), followed by the payload of the event: five 32 bit
+ * values (view count, usable width, usable height, tags and serial) for a
+ * layout demand, a 32 bit length and the command bytes (without a
+ * terminating NUL) for a user command, or the 32 bit tags for the tags of a
+ * user command.
+ *
+ *  This program is licensed under the GPL-3.0-only
+ *  Copyright (C) 2025  Braden Griebel
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DELTA_TRACE_H
+#define DELTA_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "DLTATRC1"
+
+/* Longest user command recorded, river can't send longer ones anyway, and a
+ * trace with a longer one is malformed */
+#define TRACE_MAX_COMMAND_LENGTH 65536
+
+enum TraceEventType {
+  TRACE_LAYOUT_DEMAND = 1,
+  TRACE_USER_COMMAND = 2,
+  TRACE_USER_COMMAND_TAGS = 3,
+};
+
+struct TraceEvent {
+  uint64_t timestamp_ns; // Time since the recording started
+  uint32_t output;       // Id of the output the event was sent to
+  enum TraceEventType type;
+
+  // Layout demand
+  uint32_t view_count;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tags; // Also set for the tags of a user command
+  uint32_t serial;
+
+  // User command, NUL terminated, owned by the reader
+  const char *command;
+};
+
+struct TraceWriter {
+  FILE *file;
+  uint64_t start_ns;
+};
+
+struct TraceReader {
+  FILE *file;
+  char *command; // Buffer holding the last command read
+  uint32_t command_capacity;
+};
+
+/* Open a trace file for recording, returns false on error */
+bool delta_trace_writer_open(struct TraceWriter *writer, const char *path);
+
+/* Record a layout demand received for an output */
+void delta_trace_write_demand(struct TraceWriter *writer, uint32_t output,
+                              uint32_t view_count, uint32_t width,
+                              uint32_t height, uint32_t tags, uint32_t serial);
+
+/* Record a user command received for an output */
+void delta_trace_write_command(struct TraceWriter *writer, uint32_t output,
+                               const char *command);
+
+/* Record the tags a following user command applies to */
+void delta_trace_write_command_tags(struct TraceWriter *writer, uint32_t output,
+                                    uint32_t tags);
+
+/* Write out the buffered records, the event loop does this periodically */
+void delta_trace_writer_flush(struct TraceWriter *writer);
+
+/* Flush and close the trace file */
+void delta_trace_writer_close(struct TraceWriter *writer);
+
+/* Open a trace file for replaying, returns false on error */
+bool delta_trace_reader_open(struct TraceReader *reader, const char *path);
+
+/**
+ * Read the next event of a trace
+ *
+ * @param reader reader of the trace
+ * @param event filled with the event, a command stays valid until the next
+ * call
+ * @return 1 if an event was read, 0 at the end of the trace, -1 on error or
+ * if the trace is malformed or cut short
+ * */
+int delta_trace_read(struct TraceReader *reader, struct TraceEvent *event);
+
+void delta_trace_reader_close(struct TraceReader *reader);
+
+/* Monotonic time in nanoseconds */
+uint64_t delta_trace_now_ns(void);
+
+#endif